@@ -0,0 +1,104 @@
+# -*- coding: utf-8 -*-
+
+# Load geomandel binary iteration dumps with numpy
+# Copyright © 2016 Christian Rapp
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+"""
+File: geomandel_dump.py
+Author: Christian Rapp
+Email: 0x2a@posteo.org
+Github: https://github.com/crapp
+Description: Memory map a dump created with geomandel --dump. The planes are
+numpy arrays backed by the file, nothing is copied until you modify them.
+
+>>> from geomandel_dump import load_dump
+>>> header, iterations, continuous, samples = load_dump('geomandel.gmd')
+>>> iterations.shape
+(1000, 1000)
+
+"""
+
+import numpy as np
+
+HEADER = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('header_size', '<u4'),
+    ('width', '<u4'),
+    ('height', '<u4'),
+    ('set_type', '<u4'),
+    ('col_algo', '<u4'),
+    ('bailout', '<u4'),
+    ('cores', '<u4'),
+    ('aa_samples', '<u4'),
+    ('reserved', '<u4'),
+    ('xl', '<f8'),
+    ('xh', '<f8'),
+    ('yl', '<f8'),
+    ('yh', '<f8'),
+    ('julia_real', '<f8'),
+    ('julia_ima', '<f8'),
+    ('zoom', '<f8'),
+    ('xcoord', '<f8'),
+    ('ycoord', '<f8'),
+    ('aa_threshold', '<f8'),
+    ('iterations_offset', '<u8'),
+    ('continuous_offset', '<u8'),
+    ('samples_offset', '<u8'),
+    ('samples_count', '<u8'),
+    ('fractal_type', 'S32'),
+])
+
+SAMPLE_RECORD = np.dtype([('pixel', '<u8'), ('count', '<u4'),
+                          ('reserved', '<u4')])
+SAMPLE = np.dtype([('default_index', '<u4'), ('reserved', '<u4'),
+                   ('continous_index', '<f8')])
+
+
+def load_dump(filename):
+    """Map a dump file
+
+    Returns the header as numpy record, the iteration and continuous index
+    planes as (height, width) arrays and a dict mapping pixel index
+    (y * width + x) to the supersampling samples of that pixel.
+    """
+    data = np.memmap(filename, dtype=np.uint8, mode='r')
+    header = data[:HEADER.itemsize].view(HEADER)[0]
+    if header['magic'] != b'GMDUMP':
+        raise ValueError('{} is not a geomandel dump'.format(filename))
+    if header['version'] != 1:
+        raise ValueError('Unsupported dump version {}'.format(
+            header['version']))
+
+    shape = (int(header['height']), int(header['width']))
+    plane = shape[0] * shape[1]
+    its_off = int(header['iterations_offset'])
+    cont_off = int(header['continuous_offset'])
+    iterations = data[its_off:its_off + plane * 4].view('<u4').reshape(shape)
+    continuous = data[cont_off:cont_off + plane * 8].view('<f8').reshape(shape)
+
+    samples = {}
+    pos = int(header['samples_offset'])
+    for _ in range(int(header['samples_count'])):
+        rec = data[pos:pos + SAMPLE_RECORD.itemsize].view(SAMPLE_RECORD)[0]
+        pos += SAMPLE_RECORD.itemsize
+        count = int(rec['count'])
+        samples[int(rec['pixel'])] = data[
+            pos:pos + count * SAMPLE.itemsize].view(SAMPLE)
+        pos += count * SAMPLE.itemsize
+
+    return header, iterations, continuous, samples
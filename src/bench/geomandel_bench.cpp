@@ -0,0 +1,599 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "cxxopts.hpp"
+#include "ctpl_stl.h"
+#include "geomandel.h"
+#include "global.h"
+#include "formula.h"
+#include "fractalparams.h"
+#include "newton.h"
+#include "printer.h"
+
+#include "fractalcrunchmulti.h"
+#include "fractalcrunchprogressive.h"
+#include "fractalcrunchboundary.h"
+#include "fractalcrunchsingle.h"
+#include "tilecache.h"
+
+#include "csvwriter.h"
+#include "dumpwriter.h"
+#include "image_pnm_col.h"
+#include "image_rgb.h"
+#ifdef HAVE_ZLIB
+#include "image_png.h"
+#endif
+#ifdef HAVE_SFML
+#include "image_sfml.h"
+#endif
+
+/**
+ * @brief A fixed view of a fractal
+ *
+ * @details
+ * Scenes must never change once they were released, otherwise results of
+ * different versions can not be compared any more. Add new scenes instead.
+ */
+struct Scene {
+    std::string name;
+    constants::FRACTAL set_type;
+    double xl;
+    double xh;
+    double yl;
+    double yh;
+    unsigned int bailout;
+};
+
+/**
+ * @brief Result of one benchmark
+ */
+struct Result {
+    std::string group;
+    std::string scene;
+    std::string name;
+    unsigned long long pixels;
+    // 0 for writers, they do not iterate
+    unsigned long long iterations;
+    std::vector<double> seconds;
+};
+
+static const double deep_zoom_x = -0.743643887037151;
+static const double deep_zoom_y = 0.131825904205330;
+static const double deep_zoom_width = 1e-9;
+
+static const std::vector<Scene> scenes = {
+    {"mandelbrot", constants::FRACTAL::MANDELBROT, -2.0, 1.0, -1.5, 1.5, 1000},
+    {"mandelbrot_bailout_250", constants::FRACTAL::MANDELBROT, -2.0, 1.0, -1.5,
+     1.5, 250},
+    {"mandelbrot_bailout_5000", constants::FRACTAL::MANDELBROT, -2.0, 1.0, -1.5,
+     1.5, 5000},
+    // almost every pixel is inside the main cardioid and runs to the bailout
+    {"mandelbrot_interior", constants::FRACTAL::MANDELBROT, -0.6, 0.2, -0.4,
+     0.4, 1000},
+    // outside of the set next to the cusp, pixels escape at different speeds
+    {"mandelbrot_exterior", constants::FRACTAL::MANDELBROT, 0.26, 0.66, -0.2,
+     0.2, 1000},
+    {"mandelbrot_deep_zoom", constants::FRACTAL::MANDELBROT,
+     deep_zoom_x - deep_zoom_width / 2, deep_zoom_x + deep_zoom_width / 2,
+     deep_zoom_y - deep_zoom_width / 2, deep_zoom_y + deep_zoom_width / 2,
+     5000},
+    {"tricorn", constants::FRACTAL::TRICORN, -2.0, 2.0, -2.0, 2.0, 1000},
+    {"julia", constants::FRACTAL::JULIA, -1.5, 1.5, -1.5, 1.5, 1000},
+    {"burning_ship", constants::FRACTAL::BURNING_SHIP, -2.5, 1.5, -2.0, 1.0,
+     1000},
+};
+
+std::shared_ptr<FractalParameters> scene_parameters(const Scene &scene,
+                                                    unsigned int width,
+                                                    unsigned int height,
+                                                    unsigned int cores)
+{
+    return std::make_shared<FractalParameters>(
+        scene.set_type, width, scene.xl, scene.xh, height, scene.yl, scene.yh,
+        -0.8, 0.156, scene.bailout, 0, 0, 0, "geomandel_bench_tmp", scene.name,
+        cores, constants::COL_ALGO::CONTINUOUS_SINE);
+}
+
+/**
+ * @brief Sum of all iterations that were executed to compute the buffer
+ *
+ * @details
+ * This is the cost of every sample, so pixels that were filled without being
+ * computed are not counted.
+ */
+unsigned long long count_iterations(const constants::fracbuff &buff,
+                                    const constants::samplebuff &samples)
+{
+    unsigned long long its = 0;
+    for (const auto &row : buff)
+        for (const auto &px : row)
+            its += px.cost;
+    for (const auto &s : samples)
+        for (const auto &px : s.second)
+            its += px.cost;
+    return its;
+}
+
+/**
+ * @brief Wall clock time of a function call in seconds
+ */
+double measure(const std::function<void()> &func)
+{
+    auto tbegin = std::chrono::steady_clock::now();
+    func();
+    auto tend = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(tend - tbegin).count();
+}
+
+double best(const std::vector<double> &seconds)
+{
+    return *std::min_element(seconds.begin(), seconds.end());
+}
+
+double median(std::vector<double> seconds)
+{
+    std::sort(seconds.begin(), seconds.end());
+    size_t mid = seconds.size() / 2;
+    if (seconds.size() % 2 == 0)
+        return (seconds[mid - 1] + seconds[mid]) / 2;
+    return seconds[mid];
+}
+
+std::string json_string(const std::string &str)
+{
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string compiler()
+{
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+void write_json(std::ostream &out, const std::vector<Result> &results,
+                unsigned int width, unsigned int height, unsigned int cores,
+                unsigned int repeat)
+{
+    out.precision(9);
+    out << "{\n";
+    out << "  \"version\": " << json_string(geomandel::version()) << ",\n";
+    out << "  \"compiler\": " << json_string(compiler()) << ",\n";
+    out << "  \"build_type\": " << json_string(GEOMANDEL_BUILD_TYPE) << ",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency()
+        << ",\n";
+    out << "  \"cores\": " << cores << ",\n";
+    out << "  \"width\": " << width << ",\n";
+    out << "  \"height\": " << height << ",\n";
+    out << "  \"repeat\": " << repeat << ",\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        double t = best(r.seconds);
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"group\": " << json_string(r.group)
+            << ", \"scene\": " << json_string(r.scene)
+            << ", \"name\": " << json_string(r.name) << ",\n";
+        out << "     \"pixels\": " << r.pixels
+            << ", \"iterations\": " << r.iterations << ",\n";
+        out << "     \"seconds_best\": " << t
+            << ", \"seconds_median\": " << median(r.seconds) << ",\n";
+        out << "     \"pixels_per_second\": " << r.pixels / t
+            << ", \"iterations_per_second\": " << r.iterations / t << ",\n";
+        out << "     \"seconds\": [";
+        for (size_t j = 0; j < r.seconds.size(); j++)
+            out << (j == 0 ? "" : ", ") << r.seconds[j];
+        out << "]}";
+    }
+    out << "\n  ]\n}" << std::endl;
+}
+
+class Benchmark
+{
+public:
+    Benchmark(unsigned int width, unsigned int height, unsigned int cores,
+              unsigned int repeat, std::string filter)
+        : width(width),
+          height(height),
+          cores(cores),
+          repeat(repeat),
+          filter(std::move(filter))
+    {
+    }
+
+    void run_engines()
+    {
+        for (const auto &scene : scenes) {
+            this->run_engine(scene, "single", [](
+                constants::fracbuff &buff,
+                const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchsingle crunchi(buff, params);
+                crunchi.fill_buffer();
+            });
+            this->run_engine(scene, "multi", [](
+                constants::fracbuff &buff,
+                const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchmulti crunchi(buff, params);
+                crunchi.fill_buffer();
+            });
+            // the pre-pass is part of the measured time
+            this->run_engine(scene, "multi_cost_schedule", [](
+                constants::fracbuff &buff,
+                const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchmulti crunchi(buff, params);
+                crunchi.prepass_costmap(8);
+                crunchi.fill_buffer();
+            });
+            // boundary tracing can not fill the continuous index
+            this->run_engine(
+                scene, "boundary",
+                [](constants::fracbuff &buff,
+                   const std::shared_ptr<FractalParameters> &params) {
+                    Fractalcrunchboundary crunchi(buff, params);
+                    crunchi.fill_buffer();
+                },
+                [](const std::shared_ptr<FractalParameters> &params) {
+                    params->col_algo = constants::COL_ALGO::ESCAPE_TIME;
+                    params->boundary = 64;
+                });
+        }
+
+        // engines for special purposes only run on the default scene
+        const Scene &scene = scenes.front();
+        this->run_engine(
+            scene, "progressive",
+            [](constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchprogressive crunchi(buff, params,
+                                                 [](unsigned int) {});
+                crunchi.fill_buffer();
+            },
+            [](const std::shared_ptr<FractalParameters> &params) {
+                params->progressive = 16;
+            });
+        this->run_engine(
+            scene, "multi_supersample_4",
+            [](constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchmulti crunchi(buff, params);
+                crunchi.fill_buffer();
+                constants::samplebuff samples;
+                crunchi.supersample_buffer(samples);
+            },
+            [](const std::shared_ptr<FractalParameters> &params) {
+                params->aa_samples = 4;
+            });
+
+        // formulas of built in fractals, compare with their native engine.
+        // The bytecode runs on the burning ship, which is the last scene.
+        this->run_engine(
+            scene, "multi_formula_kernel",
+            [](constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchmulti crunchi(buff, params);
+                crunchi.fill_buffer();
+            },
+            [](const std::shared_ptr<FractalParameters> &params) {
+                params->set_type = constants::FRACTAL::FORMULA;
+                params->formula = std::make_shared<const Formula>("z^2 + c");
+            });
+        this->run_engine(
+            scenes.back(), "multi_formula_bytecode",
+            [](constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchmulti crunchi(buff, params);
+                crunchi.fill_buffer();
+            },
+            [](const std::shared_ptr<FractalParameters> &params) {
+                params->set_type = constants::FRACTAL::FORMULA;
+                params->formula =
+                    std::make_shared<const Formula>("fold(z)^2 + c");
+            });
+
+        // z^3 - 1 on the plane of the default scene
+        auto newton = [](const std::shared_ptr<FractalParameters> &params) {
+            params->set_type = constants::FRACTAL::NEWTON;
+            params->newton = std::make_shared<const Newton>("1,0,0,-1");
+        };
+        this->run_engine(
+            scene, "single_newton",
+            [](constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchsingle crunchi(buff, params);
+                crunchi.fill_buffer();
+            },
+            newton);
+        this->run_engine(
+            scene, "multi_newton",
+            [](constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params) {
+                Fractalcrunchmulti crunchi(buff, params);
+                crunchi.fill_buffer();
+            },
+            newton);
+
+        ctpl::thread_pool tpl(static_cast<int>(this->cores));
+        std::unique_ptr<Tilecache> cache;
+        this->run_engine(
+            scene, "tilecache_cold",
+            [&tpl, &cache](constants::fracbuff &buff,
+                           const std::shared_ptr<FractalParameters> &params) {
+                cache->render(buff, params, tpl);
+            },
+            [&cache](const std::shared_ptr<FractalParameters> &params) {
+                (void)params;
+                cache = std::unique_ptr<Tilecache>(new Tilecache(64, 4096));
+            });
+        // pan by one and a half tiles, most tiles are taken from the warm
+        // cache but one column has to be computed
+        this->run_engine(
+            scene, "tilecache_pan",
+            [&tpl, &cache](constants::fracbuff &buff,
+                           const std::shared_ptr<FractalParameters> &params) {
+                auto panned = std::make_shared<FractalParameters>(*params);
+                double dx = params->xdelta * 96;
+                panned->set_complex_plane(params->xrange, params->xl + dx,
+                                          params->xh + dx, params->yrange,
+                                          params->yl, params->yh);
+                cache->render(buff, panned, tpl);
+            },
+            [&tpl, &cache](const std::shared_ptr<FractalParameters> &params) {
+                cache = std::unique_ptr<Tilecache>(new Tilecache(64, 4096));
+                constants::fracbuff warm = geomandel::create_buffer(*params);
+                cache->render(warm, params, tpl);
+            },
+            false);
+    }
+
+    void run_writers()
+    {
+        const Scene &scene = scenes.front();
+        auto params = scene_parameters(scene, this->width, this->height,
+                                       this->cores);
+        constants::fracbuff buff = geomandel::create_buffer(*params);
+        Fractalcrunchmulti crunchi(buff, params);
+        crunchi.fill_buffer();
+        auto prnt = std::make_shared<Printer>(true);
+        geomandel::ColorParameters c;
+
+        this->run_writer(scene, "rgb", params, {}, [&]() {
+            ImageRGB img(buff, params, prnt, c.rgb_base, c.rgb_set_base,
+                         c.rgb_freq, c.rgb_phase, c.rgb_amp);
+            img.write_buffer();
+        });
+        this->run_writer(scene, "ppm", params, {".ppm"}, [&]() {
+            Imagecol img(buff, params, prnt, c.rgb_base, c.rgb_set_base,
+                         c.rgb_freq, c.rgb_phase, c.rgb_amp);
+            img.write_buffer();
+        });
+#ifdef HAVE_ZLIB
+        this->run_writer(scene, "png", params, {".png"}, [&]() {
+            ImagePNG img(buff, params, prnt, c.rgb_base, c.rgb_set_base,
+                         c.rgb_freq, c.rgb_phase, c.rgb_amp);
+            img.write_buffer();
+        });
+#endif
+#ifdef HAVE_SFML
+        this->run_writer(scene, "jpg", params, {".jpg"}, [&]() {
+            ImageSFML img(buff, params, prnt, c.rgb_base, c.rgb_set_base,
+                          c.rgb_freq, c.rgb_phase, c.rgb_amp,
+                          static_cast<uint8_t>(
+                              constants::OUT_FORMAT::IMAGE_JPG));
+            img.write_buffer();
+        });
+#endif
+        this->run_writer(scene, "csv", params,
+                         {"_iterindex.csv", "_contindex.csv"}, [&]() {
+                             CSVWriter csv(buff, params);
+                             csv.write_buffer();
+                         });
+        this->run_writer(scene, "dump", params, {".gmd"}, [&]() {
+            Dumpwriter dump(buff, params);
+            dump.write_buffer();
+        });
+    }
+
+    const std::vector<Result> &get_results() const { return this->results; }
+
+private:
+    unsigned int width;
+    unsigned int height;
+    unsigned int cores;
+    unsigned int repeat;
+    std::string filter;
+
+    std::vector<Result> results;
+
+    typedef std::function<void(
+        constants::fracbuff &, const std::shared_ptr<FractalParameters> &)>
+        enginefunc;
+    // runs before every measurement and is not part of it
+    typedef std::function<void(const std::shared_ptr<FractalParameters> &)>
+        preparefunc;
+
+    bool selected(const std::string &id) const
+    {
+        return this->filter.empty() ||
+               id.find(this->filter) != std::string::npos;
+    }
+
+    /**
+     * @brief Measure an engine
+     *
+     * @param counted False for engines that take part of the result from a
+     * cache. The cost of cached pixels was paid by an earlier run, so their
+     * iterations are reported as 0.
+     */
+    void run_engine(const Scene &scene, const std::string &name,
+                    const enginefunc &engine,
+                    const preparefunc &prepare = nullptr, bool counted = true)
+    {
+        std::string id = "engine/" + scene.name + "/" + name;
+        if (!this->selected(id))
+            return;
+        std::cerr << id << std::endl;
+        auto params = scene_parameters(scene, this->width, this->height,
+                                       this->cores);
+        constants::fracbuff buff = geomandel::create_buffer(*params);
+
+        Result r;
+        r.group = "engine";
+        r.scene = scene.name;
+        r.name = name;
+        r.pixels = static_cast<unsigned long long>(params->xrange) *
+                   params->yrange;
+        for (unsigned int i = 0; i < this->repeat; i++) {
+            if (prepare)
+                prepare(params);
+            r.seconds.push_back(measure([&engine, &buff, &params]() {
+                engine(buff, params);
+            }));
+        }
+
+        // supersampling is deterministic, repeat it once to count its
+        // iterations outside of the measurement
+        constants::samplebuff samples;
+        if (params->aa_samples > 0) {
+            Fractalcrunchsingle crunchi(buff, params);
+            crunchi.supersample_buffer(samples);
+            r.pixels += samples.size() * params->aa_samples;
+        }
+        r.iterations = counted ? count_iterations(buff, samples) : 0;
+        this->results.push_back(r);
+    }
+
+    void run_writer(const Scene &scene, const std::string &name,
+                    const std::shared_ptr<FractalParameters> &params,
+                    const std::vector<std::string> &suffixes,
+                    const std::function<void()> &writer)
+    {
+        std::string id = "writer/" + scene.name + "/" + name;
+        if (!this->selected(id))
+            return;
+        std::cerr << id << std::endl;
+        Result r;
+        r.group = "writer";
+        r.scene = scene.name;
+        r.name = name;
+        r.pixels = static_cast<unsigned long long>(params->xrange) *
+                   params->yrange;
+        r.iterations = 0;
+        for (unsigned int i = 0; i < this->repeat; i++)
+            r.seconds.push_back(measure(writer));
+        for (const auto &suffix : suffixes)
+            std::remove((params->image_base + suffix).c_str());
+        this->results.push_back(r);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    cxxopts::Options parser("geomandel_bench", " - benchmark suite");
+    // clang-format off
+    parser.add_options()
+        ("help", "Show this help")
+        ("w,width", "Image width of every scene",
+         cxxopts::value<unsigned int>()->default_value("400"))
+        ("h,height", "Image height of every scene",
+         cxxopts::value<unsigned int>()->default_value("400"))
+        ("c,cores", "Threads of the multicore engines, 0 uses all cores",
+         cxxopts::value<unsigned int>()->default_value("0"))
+        ("r,repeat", "Runs of every benchmark, the best one is reported",
+         cxxopts::value<unsigned int>()->default_value("3"))
+        ("filter", "Only run benchmarks whose id (group/scene/name) contains "
+         "this string", cxxopts::value<std::string>())
+        ("o,output", "Write the json report to this file instead of stdout",
+         cxxopts::value<std::string>());
+    // clang-format on
+    try {
+        parser.parse(argc, argv);
+    } catch (const cxxopts::OptionParseException &ex) {
+        std::cerr << parser.help() << std::endl;
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    if (parser.count("help")) {
+        std::cout << parser.help() << std::endl;
+        return 0;
+    }
+
+    unsigned int width = parser["width"].as<unsigned int>();
+    unsigned int height = parser["height"].as<unsigned int>();
+    unsigned int cores = parser["cores"].as<unsigned int>();
+    unsigned int repeat = parser["repeat"].as<unsigned int>();
+    if (width == 0 || height == 0 || repeat == 0) {
+        std::cerr << "Width, height and repeat must be greater than 0"
+                  << std::endl;
+        return 1;
+    }
+    if (cores == 0)
+        cores = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string filter;
+    if (parser.count("filter"))
+        filter = parser["filter"].as<std::string>();
+
+    Benchmark bench(width, height, cores, repeat, filter);
+    bench.run_engines();
+    bench.run_writers();
+
+    if (parser.count("output")) {
+        std::string file = parser["output"].as<std::string>();
+        std::ofstream out(file);
+        if (!out.is_open()) {
+            std::cerr << "Could not open " << file << std::endl;
+            return 1;
+        }
+        write_json(out, bench.get_results(), width, height, cores, repeat);
+    } else {
+        write_json(std::cout, bench.get_results(), width, height, cores,
+                   repeat);
+    }
+    return 0;
+}
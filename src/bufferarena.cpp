@@ -0,0 +1,215 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bufferarena.h"
+
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+// new chunks are big enough for several rows of a large frame
+const size_t chunk_size = 16 * Bufferarena::huge_page_size;
+const size_t block_alignment = 64;
+
+size_t round_up(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+}
+
+const size_t Bufferarena::huge_page_size;
+const size_t Bufferarena::min_block;
+
+Bufferarena &Bufferarena::instance()
+{
+    static Bufferarena arena;
+    return arena;
+}
+
+Bufferarena::Bufferarena()
+    : active(false),
+      pages(NORMAL),
+      chunk_used(0),
+      live_blocks(0),
+      allocations(0),
+      reused(0),
+      mapped_bytes(0)
+{
+}
+
+Bufferarena::~Bufferarena()
+{
+    // blocks that are still alive at exit are simply not returned
+    this->trim();
+}
+
+void Bufferarena::enable(PAGES pages)
+{
+    std::lock_guard<std::mutex> lock(this->mtx);
+    this->pages = pages;
+    this->active = true;
+}
+
+bool Bufferarena::enabled() const { return this->active; }
+void *Bufferarena::allocate(size_t bytes)
+{
+    this->allocations++;
+    if (!this->active || bytes < min_block)
+        return ::operator new(bytes);
+
+    std::lock_guard<std::mutex> lock(this->mtx);
+    this->live_blocks++;
+    auto it = this->free_blocks.find(bytes);
+    if (it != this->free_blocks.end() && !it->second.empty()) {
+        void *p = it->second.back();
+        it->second.pop_back();
+        this->reused++;
+        return p;
+    }
+    return this->carve(bytes);
+}
+
+void Bufferarena::release(void *p, size_t bytes)
+{
+    if (p == nullptr)
+        return;
+    if (this->active && bytes >= min_block) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        // blocks allocated before the arena was enabled are not ours
+        if (this->owns(p)) {
+            this->free_blocks[bytes].push_back(p);
+            this->live_blocks--;
+            return;
+        }
+    }
+    ::operator delete(p);
+}
+
+Bufferarena::Counters Bufferarena::counters() const
+{
+    Counters c;
+    c.allocations = this->allocations;
+    c.reused = this->reused;
+    c.mapped_bytes = this->mapped_bytes;
+    return c;
+}
+
+bool Bufferarena::trim()
+{
+    std::lock_guard<std::mutex> lock(this->mtx);
+    if (this->live_blocks > 0)
+        return false;
+    for (const auto &chunk : this->chunks)
+        this->unmap_chunk(chunk);
+    this->chunks.clear();
+    this->free_blocks.clear();
+    this->chunk_used = 0;
+    return true;
+}
+
+bool Bufferarena::owns(const void *p) const
+{
+    const char *c = static_cast<const char *>(p);
+    return std::any_of(this->chunks.begin(), this->chunks.end(),
+                       [c](const Chunk &chunk) {
+                           return c >= chunk.data &&
+                                  c < chunk.data + chunk.size;
+                       });
+}
+
+void *Bufferarena::carve(size_t bytes)
+{
+    size_t size = round_up(bytes, block_alignment);
+    if (this->chunks.empty() ||
+        this->chunk_used + size > this->chunks.back().size) {
+        // the rest of the current chunk is wasted, frames of one batch have
+        // the same row size so this is rare
+        this->chunks.push_back(this->map_chunk(
+            round_up(std::max(size, chunk_size), huge_page_size)));
+        this->chunk_used = 0;
+    }
+    void *p = this->chunks.back().data + this->chunk_used;
+    this->chunk_used += size;
+    return p;
+}
+
+Bufferarena::Chunk Bufferarena::map_chunk(size_t bytes)
+{
+    Chunk chunk;
+    chunk.size = bytes;
+    chunk.mapped = true;
+#if defined(__unix__) || defined(__APPLE__)
+    const int prot = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (this->pages == EXPLICIT)
+        p = mmap(nullptr, bytes, prot, flags | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        chunk.data = static_cast<char *>(p);
+        this->mapped_bytes += bytes;
+        return chunk;
+    }
+#endif
+    if (this->pages == NORMAL) {
+        p = mmap(nullptr, bytes, prot, flags, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        chunk.data = static_cast<char *>(p);
+    } else {
+        // transparent huge pages need a range aligned to the huge page size,
+        // map more than needed and cut off the unaligned ends
+        size_t span = bytes + huge_page_size;
+        p = mmap(nullptr, span, prot, flags, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        char *begin = static_cast<char *>(p);
+        char *aligned = reinterpret_cast<char *>(
+            round_up(reinterpret_cast<size_t>(begin), huge_page_size));
+        if (aligned > begin)
+            munmap(begin, static_cast<size_t>(aligned - begin));
+        size_t tail = static_cast<size_t>(begin + span - (aligned + bytes));
+        if (tail > 0)
+            munmap(aligned + bytes, tail);
+        chunk.data = aligned;
+#ifdef MADV_HUGEPAGE
+        madvise(chunk.data, bytes, MADV_HUGEPAGE);
+#endif
+    }
+#else
+    chunk.data = static_cast<char *>(::operator new(bytes));
+    chunk.mapped = false;
+#endif
+    this->mapped_bytes += bytes;
+    return chunk;
+}
+
+void Bufferarena::unmap_chunk(const Chunk &chunk)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (chunk.mapped) {
+        munmap(chunk.data, chunk.size);
+        return;
+    }
+#endif
+    ::operator delete(chunk.data);
+}
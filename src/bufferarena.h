@@ -0,0 +1,156 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUFFERARENA_H
+#define BUFFERARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Process wide cache for frame buffer memory
+ *
+ * @details
+ * Batch renders like tile pyramids allocate buffers of the same size for
+ * every frame. Freshly mapped memory page faults on its first touch, which
+ * adds up to millions of faults for large frames. Once enabled, the arena
+ * keeps released blocks and hands them out again for allocations of the same
+ * size. New blocks are carved from large chunks that can be backed by
+ * transparent or explicit huge pages.
+ *
+ * The arena is disabled by default and then forwards to operator new. The
+ * counters are maintained in both modes.
+ */
+class Bufferarena
+{
+public:
+    enum PAGES {
+        NORMAL,       // regular pages
+        TRANSPARENT,  // ask the kernel for transparent huge pages
+        EXPLICIT      // reserved huge pages, transparent ones if none are left
+    };
+
+    struct Counters {
+        // allocations that were requested
+        unsigned long long allocations = 0;
+        // allocations that were served with a released block
+        unsigned long long reused = 0;
+        // bytes of chunks that were mapped
+        unsigned long long mapped_bytes = 0;
+    };
+
+    static Bufferarena &instance();
+
+    /**
+     * @brief Start caching blocks
+     *
+     * @param pages Page type of new chunks
+     */
+    void enable(PAGES pages);
+    bool enabled() const;
+
+    void *allocate(size_t bytes);
+    void release(void *p, size_t bytes);
+
+    Counters counters() const;
+
+    /**
+     * @brief Return all chunks to the system if no block is in use
+     *
+     * @return True if the chunks were released
+     */
+    bool trim();
+
+    static const size_t huge_page_size = 2 * 1024 * 1024;
+    // smaller allocations are not worth caching and always use operator new
+    static const size_t min_block = 4096;
+
+private:
+    Bufferarena();
+    ~Bufferarena();
+    Bufferarena(const Bufferarena &) = delete;
+    Bufferarena &operator=(const Bufferarena &) = delete;
+
+    struct Chunk {
+        char *data;
+        size_t size;
+        bool mapped;
+    };
+
+    mutable std::mutex mtx;
+    std::atomic<bool> active;
+    PAGES pages;
+
+    std::unordered_map<size_t, std::vector<void *>> free_blocks;
+    std::vector<Chunk> chunks;
+    // bytes of the newest chunk that were handed out
+    size_t chunk_used;
+    unsigned long long live_blocks;
+
+    std::atomic<unsigned long long> allocations;
+    std::atomic<unsigned long long> reused;
+    std::atomic<unsigned long long> mapped_bytes;
+
+    bool owns(const void *p) const;
+    void *carve(size_t bytes);
+    Chunk map_chunk(size_t bytes);
+    void unmap_chunk(const Chunk &chunk);
+};
+
+/**
+ * @brief Standard allocator that gets its memory from the Bufferarena
+ */
+template <typename T>
+struct Framealloc {
+    typedef T value_type;
+
+    Framealloc() {}
+    template <typename U>
+    Framealloc(const Framealloc<U> &)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(
+            Bufferarena::instance().allocate(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t n)
+    {
+        Bufferarena::instance().release(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const Framealloc<T> &, const Framealloc<U> &)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const Framealloc<T> &, const Framealloc<U> &)
+{
+    return false;
+}
+
+#endif /* ifndef BUFFERARENA_H */
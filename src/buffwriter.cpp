@@ -18,37 +18,122 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "buffwriter.h"
 
-Buffwriter::Buffwriter(const constants::fracbuff &buff) : buff(buff) {}
+#include <utility>
+
+Buffwriter::Buffwriter(const constants::fracbuff &buff)
+    : buff(buff), samples(nullptr)
+{
+}
 Buffwriter::~Buffwriter() {}
+void Buffwriter::set_samples(const constants::samplebuff &samples)
+{
+    this->samples = &samples;
+}
 std::string Buffwriter::out_file_name(
     const std::string &string_pattern, const std::string &fractal_type,
     unsigned int bailout, unsigned int xrange, unsigned int yrange,
     double zoom, unsigned int cores, double xcoord, double ycoord,
     double z_real_min, double z_real_max, double z_ima_min, double z_ima_max)
 {
-    // this might represent the classic example of overengineering
-
-    //TODO: This vector initialization should be moved to the constructor
-    std::vector<std::unique_ptr<RegexpatternIface>> regex_patterns;
-    regex_patterns.emplace_back(
-        new Regexpattern<std::string>(fractal_type, "%f"));
-    regex_patterns.emplace_back(new Regexpattern<unsigned int>(bailout, "%b"));
-    regex_patterns.emplace_back(new Regexpattern<unsigned int>(xrange, "%w"));
-    regex_patterns.emplace_back(new Regexpattern<unsigned int>(yrange, "%h"));
-    regex_patterns.emplace_back(new Regexpattern<double>(zoom, "%z"));
-    regex_patterns.emplace_back(new Regexpattern<unsigned int>(cores, "%c"));
-    regex_patterns.emplace_back(new Regexpattern<double>(xcoord, "%x"));
-    regex_patterns.emplace_back(new Regexpattern<double>(ycoord, "%y"));
-    regex_patterns.emplace_back(new Regexpattern<double>(z_real_min, "%Zr"));
-    regex_patterns.emplace_back(new Regexpattern<double>(z_real_max, "%ZR"));
-    regex_patterns.emplace_back(new Regexpattern<double>(z_ima_min, "%Zi"));
-    regex_patterns.emplace_back(new Regexpattern<double>(z_ima_max, "%ZI"));
-
-    std::string filename = string_pattern;
-
-    for (const auto &p : regex_patterns) {
-        p->parse_filename(filename);
+    if (this->compiled_pattern.pattern() != string_pattern)
+        this->compiled_pattern = Filenamepattern(string_pattern);
+
+    return this->compiled_pattern.expand(
+        fractal_type, bailout, xrange, yrange, zoom, cores, xcoord, ycoord,
+        z_real_min, z_real_max, z_ima_min, z_ima_max);
+}
+
+Filenamepattern::Filenamepattern() {}
+Filenamepattern::Filenamepattern(const std::string &pattern)
+    : pattern_string(pattern)
+{
+    // longer placeholders first so %Zr is not taken for something shorter
+    static const std::vector<std::pair<std::string, PLACEHOLDER>> names = {
+        {"%Zr", Z_REAL_MIN}, {"%ZR", Z_REAL_MAX}, {"%Zi", Z_IMA_MIN},
+        {"%ZI", Z_IMA_MAX},  {"%f", FRACTAL_TYPE}, {"%b", BAILOUT},
+        {"%w", XRANGE},      {"%h", YRANGE},       {"%z", ZOOM},
+        {"%c", CORES},       {"%x", XCOORD},       {"%y", YCOORD}};
+
+    std::string literal;
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        bool matched = false;
+        if (pattern[pos] == '%') {
+            for (const auto &name : names) {
+                if (pattern.compare(pos, name.first.size(), name.first) == 0) {
+                    if (!literal.empty()) {
+                        this->tokens.push_back({LITERAL, literal});
+                        literal.clear();
+                    }
+                    this->tokens.push_back({name.second, ""});
+                    pos += name.first.size();
+                    matched = true;
+                    break;
+                }
+            }
+        }
+        if (!matched)
+            literal.push_back(pattern[pos++]);
     }
+    if (!literal.empty())
+        this->tokens.push_back({LITERAL, literal});
+}
+
+const std::string &Filenamepattern::pattern() const
+{
+    return this->pattern_string;
+}
 
+std::string Filenamepattern::expand(
+    const std::string &fractal_type, unsigned int bailout,
+    unsigned int xrange, unsigned int yrange, double zoom, unsigned int cores,
+    double xcoord, double ycoord, double z_real_min, double z_real_max,
+    double z_ima_min, double z_ima_max) const
+{
+    std::string filename;
+    filename.reserve(this->pattern_string.size() + 32);
+    for (const auto &t : this->tokens) {
+        switch (t.placeholder) {
+        case LITERAL:
+            filename += t.text;
+            break;
+        case FRACTAL_TYPE:
+            filename += fractal_type;
+            break;
+        case BAILOUT:
+            filename += utility::primitive_to_string(bailout);
+            break;
+        case XRANGE:
+            filename += utility::primitive_to_string(xrange);
+            break;
+        case YRANGE:
+            filename += utility::primitive_to_string(yrange);
+            break;
+        case ZOOM:
+            filename += utility::primitive_to_string(zoom);
+            break;
+        case CORES:
+            filename += utility::primitive_to_string(cores);
+            break;
+        case XCOORD:
+            filename += utility::primitive_to_string(xcoord);
+            break;
+        case YCOORD:
+            filename += utility::primitive_to_string(ycoord);
+            break;
+        case Z_REAL_MIN:
+            filename += utility::primitive_to_string(z_real_min);
+            break;
+        case Z_REAL_MAX:
+            filename += utility::primitive_to_string(z_real_max);
+            break;
+        case Z_IMA_MIN:
+            filename += utility::primitive_to_string(z_ima_min);
+            break;
+        case Z_IMA_MAX:
+            filename += utility::primitive_to_string(z_ima_max);
+            break;
+        }
+    }
     return filename;
 }
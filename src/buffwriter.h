@@ -24,74 +24,54 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "fractalparams.h"
 
 #include <string>
-#include <regex>
 #include <memory>
-#include <type_traits>
+#include <vector>
 
 /**
- * @brief Simple interface to be able to use objects with different
- * specializations of type Regexpattern in a std::vector
- */
-struct RegexpatternIface {
-    RegexpatternIface(){};
-    virtual ~RegexpatternIface(){};
-
-    virtual void parse_filename(std::string &filename) = 0;
-};
-
-/**
- * @brief Regexpattern implementing interface for vector support
+ * @brief File name pattern compiled into a list of tokens
  *
- * @tparam T
+ * @details
+ * The pattern is parsed once. Expanding it for a file is a single pass over
+ * the tokens that appends literal text and the value of every placeholder.
+ * Unknown '%' sequences are kept as literal text.
  */
-template <typename T>
-struct Regexpattern : public RegexpatternIface {
-    Regexpattern(T value, std::string pattern)
-        : RegexpatternIface(), value(value), regpattern(std::move(pattern)){};
-    virtual ~Regexpattern(){};
-
-    /**
-     * @brief Parse the filename string and replace every occurence of regpattern
-     * with value
-     *
-     * @param filename
-     */
-    void parse_filename(std::string &filename)
-    {
-        std::regex re(this->regpattern);
-        std::string val_string = utility::primitive_to_string(this->value);
-        filename = std::regex_replace(filename, re, val_string);
-    }
-
-private:
-    T value;
-    std::string regpattern;
-};
+class Filenamepattern
+{
+public:
+    Filenamepattern();
+    Filenamepattern(const std::string &pattern);
 
-/**
- * @brief Specialized form of the Regexpattern struct for strings
- */
-template <>
-struct Regexpattern<std::string> : public RegexpatternIface {
-    Regexpattern(std::string value, std::string pattern)
-        : RegexpatternIface(), value(value), regpattern(std::move(pattern)){};
-    virtual ~Regexpattern(){};
+    const std::string &pattern() const;
 
-    /**
-     * @brief Parse the filename string and replace every occurence of regpattern
-     * with value
-     *
-     * @param filename
-     */
-    void parse_filename(std::string &filename)
-    {
-        std::regex re(this->regpattern);
-        filename = std::regex_replace(filename, re, this->value);
-    }
+    std::string expand(const std::string &fractal_type, unsigned int bailout,
+                       unsigned int xrange, unsigned int yrange, double zoom,
+                       unsigned int cores, double xcoord, double ycoord,
+                       double z_real_min, double z_real_max, double z_ima_min,
+                       double z_ima_max) const;
 
 private:
-    std::string value;
-    std::string regpattern;
+    enum PLACEHOLDER {
+        LITERAL,
+        FRACTAL_TYPE,  // %f
+        BAILOUT,       // %b
+        XRANGE,        // %w
+        YRANGE,        // %h
+        ZOOM,          // %z
+        CORES,         // %c
+        XCOORD,        // %x
+        YCOORD,        // %y
+        Z_REAL_MIN,    // %Zr
+        Z_REAL_MAX,    // %ZR
+        Z_IMA_MIN,     // %Zi
+        Z_IMA_MAX      // %ZI
+    };
+    struct Token {
+        PLACEHOLDER placeholder;
+        std::string text;
+    };
+
+    std::string pattern_string;
+    std::vector<Token> tokens;
 };
 
 /**
@@ -106,8 +86,18 @@ public:
 
     virtual void write_buffer() = 0;
 
+    /**
+     * @brief Provide the additional samples of the supersampling pass
+     *
+     * @param samples Sparse sample buffer, must outlive the writer
+     */
+    void set_samples(const constants::samplebuff &samples);
+
 protected:
     const constants::fracbuff &buff;
+    const constants::samplebuff *samples;
+    // the last pattern that was used, compiled again only if it changes
+    Filenamepattern compiled_pattern;
 
     std::string out_file_name(const std::string &string_pattern,
                               const std::string &fractal_type,
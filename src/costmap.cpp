@@ -0,0 +1,95 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "costmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "costwriter.h"
+
+Costmap::Costmap()
+    : set_type(constants::FRACTAL::MANDELBROT),
+      bailout(0),
+      xl(0),
+      xh(0),
+      yl(0),
+      yh(0),
+      cells_x(0),
+      cells_y(0),
+      mean(0)
+{
+}
+
+Costmap Costmap::from_buffer(const constants::fracbuff &buff,
+                             const constants::samplebuff *samples,
+                             const FractalParameters &params,
+                             unsigned int cell_size)
+{
+    Costmap map;
+    if (buff.empty() || buff.front().empty())
+        return map;
+    cell_size = std::max(cell_size, 1u);
+    auto tiles = Costwriter::tile_costs(buff, samples, cell_size);
+
+    map.set_type = params.set_type;
+    map.bailout = params.bailout;
+    map.xl = params.xl;
+    map.xh = params.xh;
+    map.yl = params.yl;
+    map.yh = params.yh;
+    map.cells_y = static_cast<unsigned int>(tiles.size());
+    map.cells_x = static_cast<unsigned int>(tiles.front().size());
+    map.cells.reserve(static_cast<size_t>(map.cells_x) * map.cells_y);
+
+    size_t width = buff.front().size();
+    unsigned long long total = 0;
+    for (unsigned int cy = 0; cy < map.cells_y; cy++) {
+        // cells at the right and bottom border may be smaller
+        size_t h = std::min<size_t>(cell_size, buff.size() - cy * cell_size);
+        for (unsigned int cx = 0; cx < map.cells_x; cx++) {
+            size_t w = std::min<size_t>(cell_size, width - cx * cell_size);
+            map.cells.push_back(static_cast<double>(tiles[cy][cx]) / (w * h));
+            total += tiles[cy][cx];
+        }
+    }
+    map.mean = static_cast<double>(total) / (width * buff.size());
+    return map;
+}
+
+bool Costmap::empty() const { return this->cells.empty(); }
+bool Costmap::matches(const FractalParameters &params) const
+{
+    return !this->empty() && this->set_type == params.set_type &&
+           this->bailout == params.bailout;
+}
+
+double Costmap::density(double re, double im) const
+{
+    if (this->empty())
+        return 0;
+    double fx = (re - this->xl) / (this->xh - this->xl);
+    double fy = (im - this->yl) / (this->yh - this->yl);
+    if (!(fx >= 0 && fx < 1 && fy >= 0 && fy < 1))
+        return this->mean;
+    auto cx = static_cast<unsigned int>(fx * this->cells_x);
+    auto cy = static_cast<unsigned int>(fy * this->cells_y);
+    return this->cells[static_cast<size_t>(std::min(cy, this->cells_y - 1)) *
+                           this->cells_x +
+                       std::min(cx, this->cells_x - 1)];
+}
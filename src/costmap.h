@@ -0,0 +1,98 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COSTMAP_H
+#define COSTMAP_H
+
+#include <vector>
+
+#include "global.h"
+#include "fractalparams.h"
+
+/**
+ * @brief Coarse prediction of the iteration cost in a part of the complex plane
+ *
+ * @details
+ * The map divides the complex plane of a finished render into cells and
+ * stores the average number of iterations per pixel of every cell. As the cost
+ * is stored per pixel and addressed by complex coordinates, a map can predict
+ * the cost of a render with a different resolution or a slightly different
+ * view, like the next frame of a zoom or a pan.
+ */
+class Costmap
+{
+public:
+    Costmap();
+
+    /**
+     * @brief Create a map from the cost of a rendered buffer
+     *
+     * @param buff Rendered buffer
+     * @param samples Supersampling samples or nullptr
+     * @param params Parameters the buffer was rendered with
+     * @param cell_size Width and height of a cell in pixels
+     *
+     * @return Cost map covering the complex plane of params
+     */
+    static Costmap from_buffer(const constants::fracbuff &buff,
+                               const constants::samplebuff *samples,
+                               const FractalParameters &params,
+                               unsigned int cell_size);
+
+    bool empty() const;
+
+    /**
+     * @brief Check if the map was made for the same fractal
+     *
+     * @param params
+     *
+     * @return True if fractal type and bailout match
+     *
+     * @details
+     * A map of another fractal or bailout predicts nothing useful.
+     */
+    bool matches(const FractalParameters &params) const;
+
+    /**
+     * @brief Predicted iterations per pixel at a point of the complex plane
+     *
+     * @param re Real part
+     * @param im Imaginary part
+     *
+     * @return Cost of the cell containing the point, the average cost of the
+     * map for points outside of it
+     */
+    double density(double re, double im) const;
+
+private:
+    constants::FRACTAL set_type;
+    unsigned int bailout;
+
+    double xl;
+    double xh;
+    double yl;
+    double yh;
+
+    unsigned int cells_x;
+    unsigned int cells_y;
+    // row major iterations per pixel of every cell
+    std::vector<double> cells;
+    double mean;
+};
+
+#endif /* ifndef COSTMAP_H */
@@ -0,0 +1,143 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "costwriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+Costwriter::Costwriter(const constants::fracbuff &buff,
+                       const std::shared_ptr<FractalParameters> &params,
+                       unsigned int tile_size)
+    : Buffwriter(buff), params(params), tile_size(std::max(tile_size, 1u))
+{
+}
+
+Costwriter::~Costwriter() {}
+void Costwriter::write_buffer()
+{
+    std::string filename = this->out_file_name(
+        this->params->image_base, this->params->fractal_type,
+        this->params->bailout, this->params->xrange, this->params->yrange,
+        this->params->zoom, this->params->cores, this->params->xcoord,
+        this->params->ycoord, this->params->xl, this->params->xh,
+        this->params->yl, this->params->yh);
+    try {
+        this->write_image(filename + "_cost.pgm");
+        this->write_tiles(filename + "_cost.csv");
+    } catch (const std::exception &ex) {
+        std::cerr << "Error writing cost map" << std::endl;
+        std::cerr << ex.what() << std::endl;
+    }
+}
+
+unsigned long long Costwriter::pixel_cost(const constants::fracbuff &buff,
+                                          const constants::samplebuff *samples,
+                                          unsigned int ix, unsigned int iy)
+{
+    unsigned long long cost = buff[iy][ix].cost;
+    if (samples == nullptr || samples->empty())
+        return cost;
+    auto sample_it =
+        samples->find(static_cast<unsigned long>(iy) * buff[iy].size() + ix);
+    if (sample_it != samples->end()) {
+        for (const auto &s : sample_it->second)
+            cost += s.cost;
+    }
+    return cost;
+}
+
+std::vector<std::vector<unsigned long long>> Costwriter::tile_costs(
+    const constants::fracbuff &buff, const constants::samplebuff *samples,
+    unsigned int tile_size)
+{
+    std::vector<std::vector<unsigned long long>> tiles;
+    if (buff.empty() || tile_size == 0)
+        return tiles;
+    size_t width = buff.front().size();
+    tiles.assign((buff.size() + tile_size - 1) / tile_size,
+                 std::vector<unsigned long long>(
+                     (width + tile_size - 1) / tile_size, 0));
+    for (unsigned int iy = 0; iy < buff.size(); iy++) {
+        auto &row = tiles[iy / tile_size];
+        for (unsigned int ix = 0; ix < width; ix++)
+            row[ix / tile_size] += pixel_cost(buff, samples, ix, iy);
+    }
+    return tiles;
+}
+
+void Costwriter::write_image(const std::string &filename)
+{
+    unsigned int width = this->params->xrange;
+    unsigned int height = this->params->yrange;
+    std::vector<unsigned long long> costs;
+    costs.reserve(static_cast<size_t>(width) * height);
+    unsigned long long max_cost = 0;
+    for (unsigned int iy = 0; iy < height; iy++) {
+        for (unsigned int ix = 0; ix < width; ix++) {
+            costs.push_back(pixel_cost(this->buff, this->samples, ix, iy));
+            max_cost = std::max(max_cost, costs.back());
+        }
+    }
+
+    // costs span several orders of magnitude, a linear scale would only show
+    // the inside of the set
+    std::vector<unsigned char> grey(costs.size(), 0);
+    if (max_cost > 0) {
+        double scale = 255.0 / std::log1p(static_cast<double>(max_cost));
+        for (size_t i = 0; i < costs.size(); i++)
+            grey[i] = static_cast<unsigned char>(
+                std::lround(std::log1p(static_cast<double>(costs[i])) * scale));
+    }
+
+    std::ofstream img(filename, std::ofstream::out | std::ofstream::binary);
+    if (!img.is_open())
+        throw std::runtime_error("Could not open " + filename);
+    img << "P5\n# geomandel iteration cost, log scale, maximum " << max_cost
+        << "\n" << width << " " << height << "\n255\n";
+    img.write(reinterpret_cast<const char *>(grey.data()),
+              static_cast<std::streamsize>(grey.size()));
+    if (!img.good())
+        throw std::runtime_error("Could not write " + filename);
+}
+
+void Costwriter::write_tiles(const std::string &filename)
+{
+    auto tiles = tile_costs(this->buff, this->samples, this->tile_size);
+    std::ofstream csv(filename, std::ofstream::out);
+    if (!csv.is_open())
+        throw std::runtime_error("Could not open " + filename);
+    // one line per tile, pixel coordinates of the top left corner make it
+    // easy to map the tile back into the image
+    csv << "tile_x,tile_y,x,y,width,height,iterations\n";
+    for (size_t ty = 0; ty < tiles.size(); ty++) {
+        for (size_t tx = 0; tx < tiles[ty].size(); tx++) {
+            unsigned int x = static_cast<unsigned int>(tx) * this->tile_size;
+            unsigned int y = static_cast<unsigned int>(ty) * this->tile_size;
+            csv << tx << "," << ty << "," << x << "," << y << ","
+                << std::min(this->tile_size, this->params->xrange - x) << ","
+                << std::min(this->tile_size, this->params->yrange - y) << ","
+                << tiles[ty][tx] << "\n";
+        }
+    }
+    if (!csv.good())
+        throw std::runtime_error("Could not write " + filename);
+}
@@ -0,0 +1,83 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COSTWRITER_H
+#define COSTWRITER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "buffwriter.h"
+#include "fractalparams.h"
+
+/**
+ * @brief Write the iteration cost of the buffer
+ *
+ * @details
+ * The cost of a pixel is the number of iterations executed for it, including
+ * its supersampling samples. Two files are written: a grey scale PGM image with
+ * a logarithmic scale where bright pixels were expensive, and a csv file with
+ * the summed cost of square tiles.
+ */
+class Costwriter : public Buffwriter
+{
+public:
+    Costwriter(const constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params,
+               unsigned int tile_size);
+    virtual ~Costwriter();
+
+    void write_buffer();
+
+    /**
+     * @brief Iterations executed for one pixel
+     *
+     * @param buff
+     * @param samples Supersampling samples or nullptr
+     * @param ix
+     * @param iy
+     */
+    static unsigned long long pixel_cost(const constants::fracbuff &buff,
+                                         const constants::samplebuff *samples,
+                                         unsigned int ix, unsigned int iy);
+
+    /**
+     * @brief Summed cost of square tiles
+     *
+     * @param buff
+     * @param samples Supersampling samples or nullptr
+     * @param tile_size Width and height of a tile, tiles at the right and
+     * bottom border may be smaller
+     *
+     * @return Tile rows from top to bottom
+     */
+    static std::vector<std::vector<unsigned long long>> tile_costs(
+        const constants::fracbuff &buff, const constants::samplebuff *samples,
+        unsigned int tile_size);
+
+private:
+    const std::shared_ptr<FractalParameters> &params;
+    unsigned int tile_size;
+
+    void write_image(const std::string &filename);
+    void write_tiles(const std::string &filename);
+};
+
+#endif /* ifndef COSTWRITER_H */
@@ -18,6 +18,68 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "csvwriter.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <thread>
+
+#include "ctpl_stl.h"
+
+namespace
+{
+// rows per job, a band of a 4K image is about 2 MiB of csv
+const unsigned int band_rows = 32;
+
+void append_uint(std::string &out, unsigned long long value)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0)
+        out.push_back(digits[--n]);
+}
+
+/**
+ * @brief Append a double formatted like std::to_string (printf %f)
+ *
+ * @details
+ * Values are rounded to six decimals with integer arithmetic. Values that are
+ * too large or too close to a rounding tie to be sure about the result of
+ * printf use snprintf, so the output is always identical.
+ */
+void append_double(std::string &out, double value)
+{
+    double scaled = std::fabs(value) * 1e6;
+    double integral = std::floor(scaled);
+    double frac = scaled - integral;
+    // scaled < 2^40 keeps the error of the multiplication below 1e-3
+    if (!(scaled < 1099511627776.0) || std::fabs(frac - 0.5) < 1e-3) {
+        char buf[512];
+        std::snprintf(buf, sizeof(buf), "%f", value);
+        out.append(buf);
+        return;
+    }
+    unsigned long long rounded =
+        static_cast<unsigned long long>(integral) + (frac > 0.5 ? 1 : 0);
+    if (std::signbit(value))
+        out.push_back('-');
+    append_uint(out, rounded / 1000000);
+    out.push_back('.');
+    unsigned long long decimals = rounded % 1000000;
+    char digits[6];
+    for (int i = 5; i >= 0; i--) {
+        digits[i] = static_cast<char>('0' + decimals % 10);
+        decimals /= 10;
+    }
+    out.append(digits, sizeof(digits));
+}
+}
+
 CSVWriter::CSVWriter(const constants::fracbuff &buff,
                      const std::shared_ptr<FractalParameters> &params)
     : Buffwriter(buff), params(params)
@@ -36,33 +98,52 @@ void CSVWriter::write_buffer()
         this->params->yl, this->params->yh);
     std::ofstream csv_stream_iter(filename + "_iterindex.csv",
                                   std::ofstream::out);
-    std::ofstream csv_stream_modulus(filename + "_contindex.csv",
-                                     std::ofstream::out);
+    // the continuous index shares its memory with the distance estimate and
+    // the root basins of Newton fractals, the file is named after what it has
+    std::string second = "_contindex.csv";
+    if (this->params->set_type == constants::FRACTAL::NEWTON)
+        second = "_basin.csv";
+    else if (this->params->col_algo == constants::COL_ALGO::DISTANCE)
+        second = "_distance.csv";
+    std::ofstream csv_stream_modulus(filename + second, std::ofstream::out);
     csv_stream_iter.exceptions(std::ofstream::failbit | std::ofstream::badbit);
     csv_stream_modulus.exceptions(std::ofstream::failbit |
                                   std::ofstream::badbit);
     try {
         if (csv_stream_iter.is_open() && csv_stream_modulus.is_open()) {
-            // use a stringstream as buffer for each new row
-            std::stringstream ss_iter;
-            std::stringstream ss_modulus;
-            for (auto &v : this->buff) {
-                for (auto &itobj : v) {
-                    ss_iter << std::to_string(itobj.default_index) << ";";
-                    ss_modulus << std::to_string(itobj.continous_index) << ";";
-                }
-                // write the buffers into the file streams and make sure the last
-                // colon gets deleted.
-                std::string iter_line = ss_iter.str();
-                iter_line.erase(--(iter_line.end()));
-                csv_stream_iter << iter_line << std::endl;
-                ss_iter.str(std::string());
-
-                std::string modulus_line = ss_modulus.str();
-                modulus_line.erase(--(modulus_line.end()));
-                csv_stream_modulus << modulus_line << std::endl;
-                ss_modulus.str(std::string());
+            // bands of rows are formatted in parallel and written in order
+            // as soon as they are ready
+            unsigned int threads =
+                this->params->cores > 0
+                    ? this->params->cores
+                    : std::max(std::thread::hardware_concurrency(), 1u);
+            ctpl::thread_pool tpl(static_cast<int>(threads));
+            std::deque<std::future<std::pair<std::string, std::string>>>
+                bands;
+            const size_t max_queued = threads * 2;
+            auto write_band = [&bands, &csv_stream_iter,
+                               &csv_stream_modulus]() {
+                std::pair<std::string, std::string> band = bands.front().get();
+                bands.pop_front();
+                csv_stream_iter.write(
+                    band.first.data(),
+                    static_cast<std::streamsize>(band.first.size()));
+                csv_stream_modulus.write(
+                    band.second.data(),
+                    static_cast<std::streamsize>(band.second.size()));
+            };
+            size_t rows = this->buff.size();
+            for (size_t row = 0; row < rows; row += band_rows) {
+                if (bands.size() >= max_queued)
+                    write_band();
+                size_t row_end = std::min(rows, row + band_rows);
+                bands.push_back(tpl.push([this, row, row_end](int id) {
+                    (void)id;
+                    return this->format_rows(row, row_end);
+                }));
             }
+            while (!bands.empty())
+                write_band();
         } else {
             std::cerr << "CSV Files not open" << std::endl;
         }
@@ -71,3 +152,31 @@ void CSVWriter::write_buffer()
         std::cerr << e.what() << std::endl;
     }
 }
+
+std::pair<std::string, std::string> CSVWriter::format_rows(
+    size_t row_begin, size_t row_end) const
+{
+    std::pair<std::string, std::string> band;
+    size_t width = row_begin < row_end ? this->buff[row_begin].size() : 0;
+    bool newton = this->params->set_type == constants::FRACTAL::NEWTON;
+    band.first.reserve((row_end - row_begin) * width * 5);
+    band.second.reserve((row_end - row_begin) * width * 12);
+    for (size_t row = row_begin; row < row_end; row++) {
+        bool first = true;
+        for (const auto &itobj : this->buff[row]) {
+            if (!first) {
+                band.first.push_back(';');
+                band.second.push_back(';');
+            }
+            first = false;
+            append_uint(band.first, itobj.default_index);
+            if (newton)
+                append_uint(band.second, itobj.basin);
+            else
+                append_double(band.second, itobj.continous_index);
+        }
+        band.first.push_back('\n');
+        band.second.push_back('\n');
+    }
+    return band;
+}
@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <string>
+#include <utility>
 
 #include "global.h"
 #include "buffwriter.h"
@@ -38,6 +40,17 @@ public:
 private:
     /* data */
     const std::shared_ptr<FractalParameters> &params;
+
+    /**
+     * @brief Format rows of the buffer as csv
+     *
+     * @param row_begin First row
+     * @param row_end Row after the last one
+     *
+     * @return csv lines of the iteration and continuous index file
+     */
+    std::pair<std::string, std::string> format_rows(size_t row_begin,
+                                                    size_t row_end) const;
 };
 
 #endif /* ifndef CSVWRITER_H */
@@ -0,0 +1,97 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DUMPFORMAT_H
+#define DUMPFORMAT_H
+
+#include <cstdint>
+
+/**
+ * @brief Binary iteration dump format
+ *
+ * @details
+ * A dump file starts with a Header followed by the data planes. All values are
+ * stored in host byte order (little endian on all supported platforms), plane
+ * offsets are aligned to 64 bytes so the planes can be mapped directly as
+ * arrays:
+ *
+ * * iterations: uint32 [height][width], escape time of every pixel
+ * * continuous: float64 [height][width], continuous index of every pixel
+ * * samples: samples_count records of supersampled pixels. Every record is a
+ *   Samplerecord followed by count Sample entries.
+ *
+ * resources/geomandel_dump.py shows how to load a dump with numpy.
+ */
+namespace dumpformat
+{
+const char magic[8] = {'G', 'M', 'D', 'U', 'M', 'P', '\0', '\0'};
+const uint32_t version = 1;
+const uint64_t alignment = 64;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t set_type;
+    uint32_t col_algo;
+    uint32_t bailout;
+    uint32_t cores;
+    uint32_t aa_samples;
+    uint32_t reserved;
+    double xl;
+    double xh;
+    double yl;
+    double yh;
+    double julia_real;
+    double julia_ima;
+    double zoom;
+    double xcoord;
+    double ycoord;
+    double aa_threshold;
+    uint64_t iterations_offset;
+    uint64_t continuous_offset;
+    uint64_t samples_offset;
+    uint64_t samples_count;
+    char fractal_type[32];
+};
+
+struct Samplerecord {
+    uint64_t pixel;  // y * width + x
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct Sample {
+    uint32_t default_index;
+    uint32_t reserved;
+    double continous_index;
+};
+
+static_assert(sizeof(Header) == 192, "Unexpected dump header size");
+static_assert(sizeof(Samplerecord) == 16, "Unexpected sample record size");
+static_assert(sizeof(Sample) == 16, "Unexpected sample size");
+
+inline uint64_t align(uint64_t offset)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+}
+
+#endif /* ifndef DUMPFORMAT_H */
@@ -0,0 +1,164 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dumpreader.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Dumpreader::Dumpreader(const std::string &filename)
+    : data(nullptr), size(0), mapped(false)
+{
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Can not open dump " + filename);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *m = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            this->data = static_cast<const char *>(m);
+            this->size = static_cast<uint64_t>(st.st_size);
+            this->mapped = true;
+        }
+    }
+    close(fd);
+#endif
+    if (!this->mapped) {
+        std::ifstream in(filename, std::ifstream::binary | std::ifstream::ate);
+        if (!in.is_open())
+            throw std::runtime_error("Can not open dump " + filename);
+        this->fallback.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(this->fallback.data(),
+                static_cast<std::streamsize>(this->fallback.size()));
+        this->data = this->fallback.data();
+        this->size = this->fallback.size();
+    }
+
+    if (this->size < sizeof(dumpformat::Header))
+        throw std::runtime_error(filename + " is not a geomandel dump");
+    const dumpformat::Header &h = this->header();
+    if (std::memcmp(h.magic, dumpformat::magic, sizeof(h.magic)) != 0)
+        throw std::runtime_error(filename + " is not a geomandel dump");
+    if (h.version != dumpformat::version ||
+        h.header_size != sizeof(dumpformat::Header))
+        throw std::runtime_error("Unsupported dump version in " + filename);
+    uint64_t plane = static_cast<uint64_t>(h.width) * h.height;
+    if (h.width == 0 || h.height == 0 ||
+        h.iterations_offset + plane * sizeof(uint32_t) > this->size ||
+        h.continuous_offset + plane * sizeof(double) > this->size ||
+        h.samples_offset > this->size)
+        throw std::runtime_error("Dump " + filename + " is truncated");
+}
+
+Dumpreader::~Dumpreader()
+{
+#ifndef _WIN32
+    if (this->mapped)
+        munmap(const_cast<char *>(this->data),
+               static_cast<size_t>(this->size));
+#endif
+}
+
+const dumpformat::Header &Dumpreader::header() const
+{
+    return *reinterpret_cast<const dumpformat::Header *>(this->data);
+}
+
+unsigned int Dumpreader::width() const { return this->header().width; }
+unsigned int Dumpreader::height() const { return this->header().height; }
+const uint32_t *Dumpreader::iterations() const
+{
+    return reinterpret_cast<const uint32_t *>(
+        this->data + this->header().iterations_offset);
+}
+
+const double *Dumpreader::continuous() const
+{
+    return reinterpret_cast<const double *>(
+        this->data + this->header().continuous_offset);
+}
+
+std::shared_ptr<FractalParameters> Dumpreader::parameters(
+    const std::string &image_base) const
+{
+    const dumpformat::Header &h = this->header();
+    std::string fractal_type(
+        h.fractal_type, strnlen(h.fractal_type, sizeof(h.fractal_type)));
+    auto params = std::make_shared<FractalParameters>(
+        static_cast<constants::FRACTAL>(h.set_type), h.width, h.xl, h.xh,
+        h.height, h.yl, h.yh, h.julia_real, h.julia_ima, h.bailout, h.zoom,
+        h.xcoord, h.ycoord, image_base, fractal_type, h.cores,
+        static_cast<constants::COL_ALGO>(h.col_algo));
+    params->aa_samples = h.aa_samples;
+    params->aa_threshold = h.aa_threshold;
+    return params;
+}
+
+void Dumpreader::to_buffer(constants::fracbuff &buff,
+                           constants::samplebuff &samples) const
+{
+    const dumpformat::Header &h = this->header();
+    const uint32_t *its = this->iterations();
+    const double *cont = this->continuous();
+    buff.resize(h.height);
+    for (unsigned int iy = 0; iy < h.height; iy++) {
+        buff[iy].resize(h.width);
+        for (unsigned int ix = 0; ix < h.width; ix++) {
+            size_t idx = static_cast<size_t>(iy) * h.width + ix;
+            buff[iy][ix].default_index = its[idx];
+            // dumps do not store the cost. The escape time is only a rough
+            // guess, the distance estimation and boundary tracing change it,
+            // which is why --cost can not be used with --from-dump
+            buff[iy][ix].cost = its[idx];
+            buff[iy][ix].continous_index = cont[idx];
+        }
+    }
+
+    samples.clear();
+    uint64_t pos = h.samples_offset;
+    for (uint64_t i = 0; i < h.samples_count; i++) {
+        dumpformat::Samplerecord rec;
+        if (pos + sizeof(rec) > this->size)
+            throw std::runtime_error("Dump sample data is truncated");
+        std::memcpy(&rec, this->data + pos, sizeof(rec));
+        pos += sizeof(rec);
+        if (pos + rec.count * sizeof(dumpformat::Sample) > this->size)
+            throw std::runtime_error("Dump sample data is truncated");
+        std::vector<constants::Iterations> v(rec.count);
+        for (auto &it : v) {
+            dumpformat::Sample s;
+            std::memcpy(&s, this->data + pos, sizeof(s));
+            pos += sizeof(s);
+            it.default_index = s.default_index;
+            it.cost = s.default_index;
+            it.continous_index = s.continous_index;
+        }
+        samples.emplace(static_cast<unsigned long>(rec.pixel), std::move(v));
+    }
+}
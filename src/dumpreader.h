@@ -0,0 +1,96 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DUMPREADER_H
+#define DUMPREADER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "fractalparams.h"
+#include "dumpformat.h"
+
+/**
+ * @brief Zero copy reader of binary iteration dumps
+ *
+ * @details
+ * The dump file is mapped into memory, iterations() and continuous() point
+ * directly into the mapping. On platforms without mmap the file is read into
+ * memory instead.
+ */
+class Dumpreader
+{
+public:
+    /**
+     * @brief Open a dump file
+     *
+     * @param filename
+     *
+     * @throw std::runtime_error if the file is not a valid dump
+     */
+    Dumpreader(const std::string &filename);
+    virtual ~Dumpreader();
+
+    Dumpreader(const Dumpreader &) = delete;
+    Dumpreader &operator=(const Dumpreader &) = delete;
+
+    const dumpformat::Header &header() const;
+
+    unsigned int width() const;
+    unsigned int height() const;
+
+    /**
+     * @brief Iteration plane, height rows of width values
+     */
+    const uint32_t *iterations() const;
+    /**
+     * @brief Continuous index plane, height rows of width values
+     */
+    const double *continuous() const;
+
+    /**
+     * @brief Fractal parameters the dump was created with
+     *
+     * @param image_base File name pattern of the new parameter object
+     *
+     * @return
+     */
+    std::shared_ptr<FractalParameters> parameters(
+        const std::string &image_base) const;
+
+    /**
+     * @brief Copy the dump into a fractal and a sample buffer
+     *
+     * @param buff Buffer, will be resized to the dump size
+     * @param samples Sample buffer, will contain the supersampling data
+     */
+    void to_buffer(constants::fracbuff &buff,
+                   constants::samplebuff &samples) const;
+
+private:
+    const char *data;
+    uint64_t size;
+    // only used when the file could not be mapped
+    std::vector<char> fallback;
+    bool mapped;
+};
+
+#endif /* ifndef DUMPREADER_H */
@@ -0,0 +1,141 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dumpwriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "dumpformat.h"
+
+Dumpwriter::Dumpwriter(const constants::fracbuff &buff,
+                       const std::shared_ptr<FractalParameters> &params)
+    : Buffwriter(buff), params(params)
+{
+}
+
+Dumpwriter::~Dumpwriter() {}
+void Dumpwriter::write_buffer()
+{
+    std::string filename = this->out_file_name(
+        this->params->image_base, this->params->fractal_type,
+        this->params->bailout, this->params->xrange, this->params->yrange,
+        this->params->zoom, this->params->cores, this->params->xcoord,
+        this->params->ycoord, this->params->xl, this->params->xh,
+        this->params->yl, this->params->yh);
+    try {
+        this->write_file(filename + ".gmd");
+    } catch (const std::exception &ex) {
+        std::cerr << "Error writing binary dump" << std::endl;
+        std::cerr << ex.what() << std::endl;
+    }
+}
+
+void Dumpwriter::write_file(const std::string &filename)
+{
+    const FractalParameters &p = *this->params;
+    uint64_t plane = static_cast<uint64_t>(p.xrange) * p.yrange;
+
+    dumpformat::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, dumpformat::magic, sizeof(header.magic));
+    header.version = dumpformat::version;
+    header.header_size = sizeof(dumpformat::Header);
+    header.width = p.xrange;
+    header.height = p.yrange;
+    header.set_type = static_cast<uint32_t>(p.set_type);
+    header.col_algo = static_cast<uint32_t>(p.col_algo);
+    header.bailout = p.bailout;
+    header.cores = p.cores;
+    header.aa_samples = p.aa_samples;
+    header.xl = p.xl;
+    header.xh = p.xh;
+    header.yl = p.yl;
+    header.yh = p.yh;
+    header.julia_real = p.julia_real;
+    header.julia_ima = p.julia_ima;
+    header.zoom = p.zoom;
+    header.xcoord = p.xcoord;
+    header.ycoord = p.ycoord;
+    header.aa_threshold = p.aa_threshold;
+    std::strncpy(header.fractal_type, p.fractal_type.c_str(),
+                 sizeof(header.fractal_type) - 1);
+    header.iterations_offset = dumpformat::align(sizeof(dumpformat::Header));
+    header.continuous_offset =
+        dumpformat::align(header.iterations_offset + plane * sizeof(uint32_t));
+    header.samples_offset =
+        dumpformat::align(header.continuous_offset + plane * sizeof(double));
+    header.samples_count = this->samples != nullptr ? this->samples->size() : 0;
+
+    std::ofstream out(filename, std::ofstream::out | std::ofstream::binary |
+                                    std::ofstream::trunc);
+    if (!out.is_open())
+        throw std::runtime_error("Can not open " + filename);
+
+    const char zeros[dumpformat::alignment] = {};
+    auto pad_to = [&out, &zeros](uint64_t offset) {
+        uint64_t pos = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<std::streamsize>(offset - pos));
+    };
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // planes are written row by row through a small conversion buffer
+    pad_to(header.iterations_offset);
+    std::vector<uint32_t> its_row(p.xrange);
+    for (const auto &row : this->buff) {
+        std::transform(row.begin(), row.end(), its_row.begin(),
+                       [](const constants::Iterations &it) {
+                           return static_cast<uint32_t>(it.default_index);
+                       });
+        out.write(reinterpret_cast<const char *>(its_row.data()),
+                  static_cast<std::streamsize>(its_row.size() *
+                                               sizeof(uint32_t)));
+    }
+    pad_to(header.continuous_offset);
+    std::vector<double> cont_row(p.xrange);
+    for (const auto &row : this->buff) {
+        std::transform(
+            row.begin(), row.end(), cont_row.begin(),
+            [](const constants::Iterations &it) { return it.continous_index; });
+        out.write(reinterpret_cast<const char *>(cont_row.data()),
+                  static_cast<std::streamsize>(cont_row.size() *
+                                               sizeof(double)));
+    }
+    pad_to(header.samples_offset);
+    if (this->samples != nullptr) {
+        for (const auto &kv : *this->samples) {
+            dumpformat::Samplerecord rec = {kv.first,
+                                            static_cast<uint32_t>(
+                                                kv.second.size()),
+                                            0};
+            out.write(reinterpret_cast<const char *>(&rec), sizeof(rec));
+            for (const auto &it : kv.second) {
+                dumpformat::Sample s = {it.default_index, 0,
+                                        it.continous_index};
+                out.write(reinterpret_cast<const char *>(&s), sizeof(s));
+            }
+        }
+    }
+    if (!out)
+        throw std::runtime_error("Could not write " + filename);
+}
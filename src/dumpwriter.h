@@ -0,0 +1,58 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DUMPWRITER_H
+#define DUMPWRITER_H
+
+#include <memory>
+
+#include "global.h"
+#include "buffwriter.h"
+#include "fractalparams.h"
+
+/**
+ * @brief Write the buffer to a binary iteration dump (.gmd)
+ *
+ * @details
+ * The dump contains all fractal parameters and the raw iteration data, see
+ * dumpformat.h. It is much smaller and faster than the csv export and can be
+ * loaded again with Dumpreader.
+ */
+class Dumpwriter : public Buffwriter
+{
+public:
+    Dumpwriter(const constants::fracbuff &buff,
+               const std::shared_ptr<FractalParameters> &params);
+    virtual ~Dumpwriter();
+
+    void write_buffer();
+
+    /**
+     * @brief Write the dump to a specific file
+     *
+     * @param filename
+     *
+     * @throw std::runtime_error if the file can not be written
+     */
+    void write_file(const std::string &filename);
+
+private:
+    const std::shared_ptr<FractalParameters> &params;
+};
+
+#endif /* ifndef DUMPWRITER_H */
@@ -0,0 +1,586 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "formula.h"
+
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+/**
+ * @brief Integer power by repeated squaring
+ *
+ * @details
+ * Squares are computed like the Mandelbrot loop does, so z^2 + c gives
+ * exactly the same results.
+ */
+inline void powi(double x, double y, int n, double &rx, double &ry)
+{
+    unsigned int e = static_cast<unsigned int>(n < 0 ? -n : n);
+    rx = 1;
+    ry = 0;
+    bool first = true;
+    while (e > 0) {
+        if (e & 1) {
+            if (first) {
+                rx = x;
+                ry = y;
+                first = false;
+            } else {
+                double t = rx * x - ry * y;
+                ry = rx * y + ry * x;
+                rx = t;
+            }
+        }
+        e >>= 1;
+        if (e > 0) {
+            double t = x * x - y * y;
+            y = 2 * x * y;
+            x = t;
+        }
+    }
+    if (n < 0) {
+        double d = rx * rx + ry * ry;
+        rx = rx / d;
+        ry = -ry / d;
+    }
+}
+
+// exponents beyond this are computed with the general power
+const int max_integer_exponent = 64;
+}
+
+const unsigned int Formula::reg_z;
+const unsigned int Formula::reg_c;
+const unsigned int Formula::max_registers;
+
+Formula::Formula(const std::string &source)
+    : src(source), kern(BYTECODE), power(0), registers(2), pos(0)
+{
+    int root = this->parse_sum();
+    this->skip_space();
+    if (this->pos < this->src.size())
+        this->fail(std::string("unexpected '") + this->src[this->pos] + "'");
+    this->detect_kernel(root);
+    this->compile(root);
+}
+
+const std::string &Formula::source() const { return this->src; }
+Formula::KERNEL Formula::kernel() const { return this->kern; }
+size_t Formula::instructions() const { return this->body.size(); }
+std::tuple<unsigned int, double, double> Formula::iterate(
+    double x, double y, unsigned int bailout) const
+{
+    switch (this->kern) {
+    // the most common powers get a kernel with a constant exponent
+    case POWER:
+        if (this->power == 2)
+            return this->iterate_power<false, 2>(x, y, bailout);
+        if (this->power == 3)
+            return this->iterate_power<false, 3>(x, y, bailout);
+        return this->iterate_power<false, 0>(x, y, bailout);
+    case CONJ_POWER:
+        if (this->power == 2)
+            return this->iterate_power<true, 2>(x, y, bailout);
+        return this->iterate_power<true, 0>(x, y, bailout);
+    default:
+        return this->iterate_bytecode(x, y, bailout);
+    }
+}
+
+std::complex<double> Formula::evaluate(std::complex<double> z,
+                                       std::complex<double> c) const
+{
+    double re[max_registers];
+    double im[max_registers];
+    re[reg_z] = z.real();
+    im[reg_z] = z.imag();
+    re[reg_c] = c.real();
+    im[reg_c] = c.imag();
+    for (const auto &k : this->constants) {
+        re[k.first] = k.second.real();
+        im[k.first] = k.second.imag();
+    }
+    Formula::run(this->prologue, re, im);
+    Formula::run(this->body, re, im);
+    return std::complex<double>(re[reg_z], im[reg_z]);
+}
+
+template <bool CONJ_Z, int N>
+std::tuple<unsigned int, double, double> Formula::iterate_power(
+    double x, double y, unsigned int bailout) const
+{
+    // 0^n + c is c, so the first iteration is skipped like in the
+    // Mandelbrot loop
+    unsigned int iterations = 0;
+    double x0 = x;
+    double y0 = y;
+    // N is 0 if the exponent is only known at runtime
+    int n = N > 0 ? N : this->power;
+    while (x * x + y * y <= 4.0 && iterations < bailout) {
+        if (CONJ_Z)
+            y = -y;
+        double px, py;
+        powi(x, y, n, px, py);
+        x = px + x0;
+        y = py + y0;
+        iterations++;
+    }
+    return std::make_tuple(iterations, x, y);
+}
+
+std::tuple<unsigned int, double, double> Formula::iterate_bytecode(
+    double x, double y, unsigned int bailout) const
+{
+    double re[max_registers];
+    double im[max_registers];
+    re[reg_z] = 0;
+    im[reg_z] = 0;
+    re[reg_c] = x;
+    im[reg_c] = y;
+    for (const auto &k : this->constants) {
+        re[k.first] = k.second.real();
+        im[k.first] = k.second.imag();
+    }
+    Formula::run(this->prologue, re, im);
+    // z1 = f(0, c) is not counted, like z1 = c of the Mandelbrot loop
+    Formula::run(this->body, re, im);
+    unsigned int iterations = 0;
+    while (re[reg_z] * re[reg_z] + im[reg_z] * im[reg_z] <= 4.0 &&
+           iterations < bailout) {
+        Formula::run(this->body, re, im);
+        iterations++;
+    }
+    return std::make_tuple(iterations, re[reg_z], im[reg_z]);
+}
+
+void Formula::run(const std::vector<Instruction> &code, double *re, double *im)
+{
+    // operands are read before the destination is written, the destination
+    // may be an operand
+    for (const Instruction &in : code) {
+        double ar = re[in.a];
+        double ai = im[in.a];
+        if (in.mod == CONJUGATE) {
+            ai = -ai;
+        } else if (in.mod == FOLDED) {
+            ar = std::fabs(ar);
+            ai = std::fabs(ai);
+        }
+        double r = 0;
+        double i = 0;
+        switch (in.op) {
+        case COPY:
+            r = ar;
+            i = ai;
+            break;
+        case ADD:
+            r = ar + re[in.b];
+            i = ai + im[in.b];
+            break;
+        case SUB:
+            r = ar - re[in.b];
+            i = ai - im[in.b];
+            break;
+        case MUL:
+            r = ar * re[in.b] - ai * im[in.b];
+            i = ar * im[in.b] + ai * re[in.b];
+            break;
+        case DIV: {
+            double br = re[in.b];
+            double bi = im[in.b];
+            double d = br * br + bi * bi;
+            r = (ar * br + ai * bi) / d;
+            i = (ai * br - ar * bi) / d;
+            break;
+        }
+        case NEG:
+            r = -ar;
+            i = -ai;
+            break;
+        case SQR:
+            r = ar * ar - ai * ai;
+            i = 2 * ar * ai;
+            break;
+        case POWI:
+            powi(ar, ai, in.n, r, i);
+            break;
+        case POW: {
+            std::complex<double> a(ar, ai);
+            std::complex<double> b(re[in.b], im[in.b]);
+            std::complex<double> p =
+                a == 0.0 ? std::complex<double>(0) : std::exp(b * std::log(a));
+            r = p.real();
+            i = p.imag();
+            break;
+        }
+        case CONJ:
+            r = ar;
+            i = -ai;
+            break;
+        case FOLD:
+            r = std::fabs(ar);
+            i = std::fabs(ai);
+            break;
+        case RE:
+            r = ar;
+            break;
+        case IM:
+            r = ai;
+            break;
+        case ABS:
+            r = std::sqrt(ar * ar + ai * ai);
+            break;
+        case EXP: {
+            double e = std::exp(ar);
+            r = e * std::cos(ai);
+            i = e * std::sin(ai);
+            break;
+        }
+        case LOG:
+            r = 0.5 * std::log(ar * ar + ai * ai);
+            i = std::atan2(ai, ar);
+            break;
+        case SIN:
+            r = std::sin(ar) * std::cosh(ai);
+            i = std::cos(ar) * std::sinh(ai);
+            break;
+        case COS:
+            r = std::cos(ar) * std::cosh(ai);
+            i = -std::sin(ar) * std::sinh(ai);
+            break;
+        case POWIADD:
+            powi(ar, ai, in.n, r, i);
+            r += re[in.b];
+            i += im[in.b];
+            break;
+        case SQRADD:
+            r = ar * ar - ai * ai + re[in.b];
+            i = 2 * ar * ai + im[in.b];
+            break;
+        case MULADD:
+            r = ar * re[in.b] - ai * im[in.b] + re[in.n];
+            i = ar * im[in.b] + ai * re[in.b] + im[in.n];
+            break;
+        }
+        re[in.dst] = r;
+        im[in.dst] = i;
+    }
+}
+
+void Formula::skip_space()
+{
+    while (this->pos < this->src.size() &&
+           std::isspace(static_cast<unsigned char>(this->src[this->pos])))
+        this->pos++;
+}
+
+void Formula::fail(const std::string &msg) const
+{
+    throw std::invalid_argument("Invalid formula \"" + this->src +
+                                "\" at position " +
+                                std::to_string(this->pos + 1) + ": " + msg);
+}
+
+int Formula::parse_sum()
+{
+    int lhs = this->parse_product();
+    while (true) {
+        this->skip_space();
+        if (this->pos >= this->src.size())
+            return lhs;
+        char op = this->src[this->pos];
+        if (op != '+' && op != '-')
+            return lhs;
+        this->pos++;
+        int rhs = this->parse_product();
+        lhs = this->add_node(op == '+' ? ADD : SUB, lhs, rhs);
+    }
+}
+
+int Formula::parse_product()
+{
+    int lhs = this->parse_unary();
+    while (true) {
+        this->skip_space();
+        if (this->pos >= this->src.size())
+            return lhs;
+        char op = this->src[this->pos];
+        if (op != '*' && op != '/')
+            return lhs;
+        this->pos++;
+        int rhs = this->parse_unary();
+        lhs = this->add_node(op == '*' ? MUL : DIV, lhs, rhs);
+    }
+}
+
+int Formula::parse_unary()
+{
+    this->skip_space();
+    if (this->pos < this->src.size() && this->src[this->pos] == '-') {
+        this->pos++;
+        return this->add_node(NEG, this->parse_unary());
+    }
+    if (this->pos < this->src.size() && this->src[this->pos] == '+') {
+        this->pos++;
+        return this->parse_unary();
+    }
+    return this->parse_power();
+}
+
+int Formula::parse_power()
+{
+    int base = this->parse_primary();
+    this->skip_space();
+    if (this->pos >= this->src.size() || this->src[this->pos] != '^')
+        return base;
+    this->pos++;
+    // right associative, z^-2 is allowed
+    int exponent = this->parse_unary();
+    int n = this->integer_exponent(exponent);
+    if (n == 2)
+        return this->add_node(SQR, base);
+    if (n != INT_MIN)
+        return this->add_node(POWI, base, -1, n);
+    return this->add_node(POW, base, exponent);
+}
+
+int Formula::parse_primary()
+{
+    this->skip_space();
+    if (this->pos >= this->src.size())
+        this->fail("unexpected end of formula");
+    char ch = this->src[this->pos];
+    if (ch == '(') {
+        this->pos++;
+        int inner = this->parse_sum();
+        this->skip_space();
+        if (this->pos >= this->src.size() || this->src[this->pos] != ')')
+            this->fail("missing ')'");
+        this->pos++;
+        return inner;
+    }
+    if (std::isdigit(static_cast<unsigned char>(ch)) || ch == '.') {
+        const char *begin = this->src.c_str() + this->pos;
+        char *end = nullptr;
+        double value = std::strtod(begin, &end);
+        if (end == begin)
+            this->fail("invalid number");
+        this->pos += static_cast<size_t>(end - begin);
+        // imaginary literals like 2i
+        if (this->pos < this->src.size() && this->src[this->pos] == 'i' &&
+            (this->pos + 1 >= this->src.size() ||
+             !std::isalpha(
+                 static_cast<unsigned char>(this->src[this->pos + 1])))) {
+            this->pos++;
+            return this->constant_node(std::complex<double>(0, value));
+        }
+        return this->constant_node(value);
+    }
+    if (!std::isalpha(static_cast<unsigned char>(ch)))
+        this->fail(std::string("unexpected '") + ch + "'");
+
+    size_t start = this->pos;
+    while (this->pos < this->src.size() &&
+           std::isalpha(static_cast<unsigned char>(this->src[this->pos])))
+        this->pos++;
+    std::string name = this->src.substr(start, this->pos - start);
+    if (name == "z" || name == "c") {
+        Node var = {COPY, -1, -1, 0, 0, false, name == "z",
+                    static_cast<int>(name == "z" ? reg_z : reg_c)};
+        this->nodes.push_back(var);
+        return static_cast<int>(this->nodes.size() - 1);
+    }
+    if (name == "i")
+        return this->constant_node(std::complex<double>(0, 1));
+    if (name == "pi")
+        return this->constant_node(std::acos(-1.0));
+
+    static const std::vector<std::pair<std::string, OP>> functions = {
+        {"conj", CONJ}, {"fold", FOLD}, {"re", RE},   {"im", IM},
+        {"abs", ABS},   {"exp", EXP},   {"log", LOG}, {"sin", SIN},
+        {"cos", COS}};
+    for (const auto &f : functions) {
+        if (f.first != name)
+            continue;
+        this->skip_space();
+        if (this->pos >= this->src.size() || this->src[this->pos] != '(')
+            this->fail("missing '(' after " + name);
+        this->pos++;
+        int arg = this->parse_sum();
+        this->skip_space();
+        if (this->pos >= this->src.size() || this->src[this->pos] != ')')
+            this->fail("missing ')'");
+        this->pos++;
+        return this->add_node(f.second, arg);
+    }
+    this->pos = start;
+    this->fail("unknown name '" + name + "'");
+}
+
+int Formula::add_node(OP op, int a, int b, int n)
+{
+    const Node &na = this->nodes[a];
+    bool b_constant = b < 0 || this->nodes[b].constant;
+    if (na.constant && b_constant) {
+        // fold with the same code that runs the bytecode
+        std::complex<double> vb = b < 0 ? 0 : this->nodes[b].value;
+        double re[3] = {0, na.value.real(), vb.real()};
+        double im[3] = {0, na.value.imag(), vb.imag()};
+        Instruction in = {op, 0, 1, 2, n, NONE};
+        Formula::run(std::vector<Instruction>(1, in), re, im);
+        return this->constant_node(std::complex<double>(re[0], im[0]));
+    }
+    if (op == MUL && na.variable >= 0 && na.variable == this->nodes[b].variable)
+        return this->add_node(SQR, a);
+    Node node = {op, a, b, n, 0, false,
+                 na.varying || (b >= 0 && this->nodes[b].varying), -1};
+    this->nodes.push_back(node);
+    return static_cast<int>(this->nodes.size() - 1);
+}
+
+int Formula::constant_node(std::complex<double> value)
+{
+    Node node = {COPY, -1, -1, 0, value, true, false, -1};
+    this->nodes.push_back(node);
+    return static_cast<int>(this->nodes.size() - 1);
+}
+
+int Formula::integer_exponent(int node) const
+{
+    const Node &n = this->nodes[node];
+    if (!n.constant || n.value.imag() != 0)
+        return INT_MIN;
+    double r = n.value.real();
+    if (r != std::floor(r) || std::fabs(r) > max_integer_exponent)
+        return INT_MIN;
+    return static_cast<int>(r);
+}
+
+void Formula::detect_kernel(int root)
+{
+    const Node &sum = this->nodes[root];
+    if (sum.op != ADD || sum.constant || sum.variable >= 0)
+        return;
+    for (int k = 0; k < 2; k++) {
+        const Node &pw = this->nodes[k == 0 ? sum.a : sum.b];
+        const Node &other = this->nodes[k == 0 ? sum.b : sum.a];
+        if (other.variable != static_cast<int>(reg_c))
+            continue;
+        if (pw.constant || pw.variable >= 0)
+            continue;
+        int n = pw.op == SQR ? 2 : pw.op == POWI ? pw.n : 0;
+        if (n < 2)
+            continue;
+        const Node &base = this->nodes[pw.a];
+        if (base.variable == static_cast<int>(reg_z)) {
+            this->kern = POWER;
+        } else if (base.op == CONJ && !base.constant && base.variable < 0 &&
+                   this->nodes[base.a].variable == static_cast<int>(reg_z)) {
+            this->kern = CONJ_POWER;
+        } else {
+            continue;
+        }
+        this->power = n;
+        return;
+    }
+}
+
+void Formula::compile(int root)
+{
+    uint8_t result = this->emit(root);
+    if (!this->body.empty() && this->body.back().dst == result) {
+        // the last instruction reads its operands first, so it can write z
+        this->body.back().dst = reg_z;
+    } else if (result != reg_z) {
+        Instruction copy = {COPY, reg_z, result, 0, 0, NONE};
+        this->body.push_back(copy);
+    }
+}
+
+uint8_t Formula::allocate()
+{
+    if (this->registers >= max_registers)
+        this->fail("formula is too long");
+    return static_cast<uint8_t>(this->registers++);
+}
+
+uint8_t Formula::emit(int index)
+{
+    const Node node = this->nodes[index];
+    if (node.variable >= 0)
+        return static_cast<uint8_t>(node.variable);
+    if (node.constant) {
+        uint8_t reg = this->allocate();
+        this->constants.emplace_back(reg, node.value);
+        return reg;
+    }
+    // everything that does not depend on z is computed once per point
+    std::vector<Instruction> &code =
+        node.varying ? this->body : this->prologue;
+
+    if (node.op == ADD && node.varying) {
+        for (int k = 0; k < 2; k++) {
+            const Node term = this->nodes[k == 0 ? node.a : node.b];
+            int other = k == 0 ? node.b : node.a;
+            if (!term.varying || term.variable >= 0)
+                continue;
+            MODIFIER mod = NONE;
+            if (term.op == SQR || term.op == POWI) {
+                uint8_t a = this->emit_operand(term.a, mod);
+                uint8_t b = this->emit(other);
+                Instruction in = {term.op == SQR ? SQRADD : POWIADD,
+                                  this->allocate(), a, b, term.n, mod};
+                code.push_back(in);
+                return in.dst;
+            }
+            if (term.op == MUL) {
+                uint8_t a = this->emit_operand(term.a, mod);
+                uint8_t b = this->emit(term.b);
+                uint8_t addend = this->emit(other);
+                uint8_t dst = this->allocate();
+                Instruction in = {MULADD, dst, a, b, addend, mod};
+                code.push_back(in);
+                return in.dst;
+            }
+        }
+    }
+
+    MODIFIER mod = NONE;
+    uint8_t a = this->emit_operand(node.a, mod);
+    uint8_t b = node.b >= 0 ? this->emit(node.b) : 0;
+    Instruction in = {node.op, this->allocate(), a, b, node.n, mod};
+    code.push_back(in);
+    return in.dst;
+}
+
+uint8_t Formula::emit_operand(int index, MODIFIER &mod)
+{
+    const Node &node = this->nodes[index];
+    if (node.varying && node.variable < 0 &&
+        (node.op == CONJ || node.op == FOLD)) {
+        mod = node.op == CONJ ? CONJUGATE : FOLDED;
+        return this->emit(node.a);
+    }
+    mod = NONE;
+    return this->emit(index);
+}
@@ -0,0 +1,195 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FORMULA_H
+#define FORMULA_H
+
+#include <complex>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * @brief Iteration formula given by the user, e.g. "z^3 + c"
+ *
+ * @details
+ * The expression is parsed once and compiled to a register bytecode. Constant
+ * subexpressions are folded, subexpressions that do not depend on z are
+ * computed once per point instead of once per iteration, and common patterns
+ * like a^n + b or a * b + c are fused into single instructions. Formulas of
+ * the form z^n + c and conj(z)^n + c do not use the bytecode at all, they run
+ * on a native kernel.
+ *
+ * Variables are z and c, i is the imaginary unit and numbers like 2i are
+ * imaginary. Operators are + - * / and
+ * ^, functions are conj, fold (|re| + i|im|, the fold of the Burning Ship),
+ * re, im, abs, exp, log, sin and cos. The iteration starts with z = f(0, c),
+ * so "z^2 + c" computes exactly the same escape times as the Mandelbrot set.
+ */
+class Formula
+{
+public:
+    /**
+     * @brief How a formula is evaluated
+     */
+    enum KERNEL { POWER, CONJ_POWER, BYTECODE };
+
+    /**
+     * @brief Parse and compile a formula
+     *
+     * @param source
+     *
+     * @throws std::invalid_argument If the expression can not be parsed, the
+     * message contains the position of the error
+     */
+    explicit Formula(const std::string &source);
+
+    const std::string &source() const;
+    KERNEL kernel() const;
+
+    /**
+     * @brief Number of bytecode instructions executed per iteration
+     */
+    size_t instructions() const;
+
+    /**
+     * @brief Escape time algorithm with this formula
+     *
+     * @param x Real part of c
+     * @param y Imaginary part of c
+     * @param bailout
+     *
+     * @return Number of iterations, real and imaginary part of the last z
+     */
+    std::tuple<unsigned int, double, double> iterate(
+        double x, double y, unsigned int bailout) const;
+
+    /**
+     * @brief Apply the formula once
+     */
+    std::complex<double> evaluate(std::complex<double> z,
+                                  std::complex<double> c) const;
+
+private:
+    enum OP {
+        COPY,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        NEG,
+        SQR,
+        POWI,
+        POW,
+        CONJ,
+        FOLD,
+        RE,
+        IM,
+        ABS,
+        EXP,
+        LOG,
+        SIN,
+        COS,
+        // fused operations, dst = a^n + b, a^2 + b and a * b + n. Conjugates
+        // and folds of operand a are fused into every operation with a
+        // modifier.
+        POWIADD,
+        SQRADD,
+        MULADD
+    };
+
+    /**
+     * @brief Conjugate or fold applied to operand a before the operation
+     */
+    enum MODIFIER { NONE, CONJUGATE, FOLDED };
+
+    struct Instruction {
+        OP op;
+        uint8_t dst;
+        uint8_t a;
+        uint8_t b;
+        int n;
+        MODIFIER mod;
+    };
+
+    /**
+     * @brief Node of the syntax tree
+     *
+     * @details
+     * Nodes of constant values and variables have no operands. varying is
+     * true for every node that depends on z.
+     */
+    struct Node {
+        OP op;
+        int a;
+        int b;
+        int n;
+        std::complex<double> value;
+        bool constant;
+        bool varying;
+        int variable;  // register of z or c, -1 for all other nodes
+    };
+
+    // registers for z and c, the other ones hold constants and temporaries
+    static const unsigned int reg_z = 0;
+    static const unsigned int reg_c = 1;
+    static const unsigned int max_registers = 64;
+
+    std::string src;
+    KERNEL kern;
+    int power;
+
+    std::vector<Node> nodes;
+    std::vector<std::pair<uint8_t, std::complex<double>>> constants;
+    // runs once per point
+    std::vector<Instruction> prologue;
+    // runs once per iteration, the result is written to reg_z
+    std::vector<Instruction> body;
+    unsigned int registers;
+
+    // recursive descent parser, every function returns the index of a node
+    size_t pos;
+    int parse_sum();
+    int parse_product();
+    int parse_unary();
+    int parse_power();
+    int parse_primary();
+    void skip_space();
+    [[noreturn]] void fail(const std::string &msg) const;
+
+    int add_node(OP op, int a, int b = -1, int n = 0);
+    int constant_node(std::complex<double> value);
+    int integer_exponent(int node) const;
+
+    void compile(int root);
+    uint8_t emit(int node);
+    uint8_t emit_operand(int node, MODIFIER &mod);
+    uint8_t allocate();
+    void detect_kernel(int root);
+
+    static void run(const std::vector<Instruction> &code, double *re,
+                    double *im);
+    template <bool CONJ_Z, int N>
+    std::tuple<unsigned int, double, double> iterate_power(
+        double x, double y, unsigned int bailout) const;
+    std::tuple<unsigned int, double, double> iterate_bytecode(
+        double x, double y, unsigned int bailout) const;
+};
+
+#endif /* ifndef FORMULA_H */
@@ -0,0 +1,162 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fractalcrunchboundary.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+const uint8_t computed_flag = 1;
+const uint8_t queued_flag = 2;
+}
+
+Fractalcrunchboundary::Fractalcrunchboundary(
+    constants::fracbuff &buff, const std::shared_ptr<FractalParameters> &params)
+    : Fractalcruncher(buff, params), computed(0)
+{
+    if (!Fractalcrunchboundary::supports(params->col_algo))
+        throw std::invalid_argument(
+            "Boundary tracing needs a coloring algorithm based on the escape "
+            "time only");
+}
+
+Fractalcrunchboundary::~Fractalcrunchboundary() {}
+bool Fractalcrunchboundary::supports(constants::COL_ALGO col_algo)
+{
+    return col_algo == constants::COL_ALGO::ESCAPE_TIME ||
+           col_algo == constants::COL_ALGO::CONTINUOUS_BERN;
+}
+
+unsigned long long Fractalcrunchboundary::computed_pixels() const
+{
+    return this->computed.load();
+}
+
+void Fractalcrunchboundary::fill_buffer()
+{
+    this->computed = 0;
+    unsigned int size = std::max(this->params->boundary, 2u);
+    // regions are independent, so every one of them is a job
+    ctpl::thread_pool tpl(
+        static_cast<int>(std::max(this->params->cores, 1u)));
+    std::vector<std::future<void>> futures;
+    for (unsigned int y0 = 0; y0 < this->params->yrange; y0 += size) {
+        unsigned int y1 = std::min(y0 + size, this->params->yrange);
+        for (unsigned int x0 = 0; x0 < this->params->xrange; x0 += size) {
+            unsigned int x1 = std::min(x0 + size, this->params->xrange);
+            futures.push_back(tpl.push([this, x0, y0, x1, y1](int id) {
+                auto begin = Workerclock::clock::now();
+                this->trace_region(x0, y0, x1, y1);
+                if (this->workerclock != nullptr)
+                    this->workerclock->add(id, begin);
+            }));
+        }
+    }
+    for (const std::future<void> &f : futures) {
+        f.wait();
+    }
+}
+
+void Fractalcrunchboundary::trace_region(unsigned int x0, unsigned int y0,
+                                         unsigned int x1, unsigned int y1)
+{
+    unsigned int w = x1 - x0;
+    unsigned int h = y1 - y0;
+    std::vector<uint8_t> state(static_cast<size_t>(w) * h, 0);
+    std::vector<unsigned int> queue;
+    queue.reserve(static_cast<size_t>(w + h) * 2);
+    unsigned long long region_computed = 0;
+    const bool newton = this->params->set_type == constants::FRACTAL::NEWTON;
+
+    // band of a pixel of this region, computed on first use. Bands of Newton
+    // fractals are also separated by the root the pixel converged to
+    auto load = [&](unsigned int p) -> uint64_t {
+        unsigned int ix = x0 + p % w;
+        unsigned int iy = y0 + p / w;
+        if (!(state[p] & computed_flag)) {
+            this->buff[iy][ix] =
+                this->crunch_pixel(this->params->x + this->params->xdelta * ix,
+                                   this->params->y + this->params->ydelta * iy);
+            state[p] |= computed_flag;
+            region_computed++;
+        }
+        const constants::Iterations &it = this->buff[iy][ix];
+        if (newton)
+            return (static_cast<uint64_t>(it.basin) << 32) | it.default_index;
+        return it.default_index;
+    };
+    auto enqueue = [&](unsigned int p) {
+        if (!(state[p] & queued_flag)) {
+            state[p] |= queued_flag;
+            queue.push_back(p);
+        }
+    };
+
+    // the edge of the region is where the tracing starts
+    for (unsigned int lx = 0; lx < w; lx++) {
+        enqueue(lx);
+        enqueue((h - 1) * w + lx);
+    }
+    for (unsigned int ly = 1; ly + 1 < h; ly++) {
+        enqueue(ly * w);
+        enqueue(ly * w + w - 1);
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        unsigned int p = queue[head];
+        unsigned int lx = p % w;
+        unsigned int ly = p / w;
+        uint64_t center = load(p);
+        bool left = lx > 0 && load(p - 1) != center;
+        bool right = lx + 1 < w && load(p + 1) != center;
+        bool up = ly > 0 && load(p - w) != center;
+        bool down = ly + 1 < h && load(p + w) != center;
+        if (left)
+            enqueue(p - 1);
+        if (right)
+            enqueue(p + 1);
+        if (up)
+            enqueue(p - w);
+        if (down)
+            enqueue(p + w);
+        // the boundary may continue diagonally where it turns a corner
+        if (lx > 0 && ly > 0 && (left || up))
+            enqueue(p - w - 1);
+        if (lx + 1 < w && ly > 0 && (right || up))
+            enqueue(p - w + 1);
+        if (lx > 0 && ly + 1 < h && (left || down))
+            enqueue(p + w - 1);
+        if (lx + 1 < w && ly + 1 < h && (right || down))
+            enqueue(p + w + 1);
+    }
+
+    // pixels that were never computed are enclosed by one band. The first
+    // column of the region was computed, so the left neighbour is always known
+    for (unsigned int ly = 0; ly < h; ly++) {
+        auto &row = this->buff[y0 + ly];
+        for (unsigned int lx = 1; lx < w; lx++) {
+            if (state[ly * w + lx] & computed_flag)
+                continue;
+            row[x0 + lx] = row[x0 + lx - 1];
+            row[x0 + lx].cost = 0;
+        }
+    }
+    this->computed += region_computed;
+}
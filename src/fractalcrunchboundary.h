@@ -0,0 +1,82 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRACTALCRUNCHBOUNDARY_H
+#define FRACTALCRUNCHBOUNDARY_H
+
+#include <atomic>
+#include <vector>
+
+#include "ctpl_stl.h"
+
+#include "global.h"
+#include "fractalcruncher.h"
+
+/**
+ * @brief Cruncher that only computes the borders between escape time bands
+ *
+ * @details
+ * The image is split into square regions that are traced in parallel. The
+ * pixels on the edge of a region are computed first. Whenever a computed
+ * pixel has a neighbour with a different escape time, both are on the
+ * boundary of a band and their neighbours are examined too. Once there are no
+ * boundary pixels left, the pixels that were never computed are enclosed by
+ * pixels with the same escape time and are filled from their left
+ * neighbour. This is the boundary tracing of Fractint.
+ *
+ * Bands must have the same escape time across all their pixels, so the
+ * continuous index and the distance estimate can not be filled this way.
+ * Details completely enclosed by one band, like a minibrot smaller than a
+ * pixel, are lost.
+ */
+class Fractalcrunchboundary : public Fractalcruncher
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param buff
+     * @param params The region size is taken from boundary
+     *
+     * @throws std::invalid_argument If the coloring algorithm needs a value
+     * that changes inside a band
+     */
+    Fractalcrunchboundary(constants::fracbuff &buff,
+                          const std::shared_ptr<FractalParameters> &params);
+    virtual ~Fractalcrunchboundary();
+
+    void fill_buffer();
+
+    /**
+     * @brief Whether the coloring algorithm can be used with boundary tracing
+     */
+    static bool supports(constants::COL_ALGO col_algo);
+
+    /**
+     * @brief Number of pixels the last fill_buffer call actually computed
+     */
+    unsigned long long computed_pixels() const;
+
+private:
+    std::atomic<unsigned long long> computed;
+
+    void trace_region(unsigned int x0, unsigned int y0, unsigned int x1,
+                      unsigned int y1);
+};
+
+#endif /* ifndef FRACTALCRUNCHBOUNDARY_H */
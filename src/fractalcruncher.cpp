@@ -18,18 +18,42 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "fractalcruncher.h"
 
+#include <algorithm>
+#include <random>
+
+#include "formula.h"
+#include "newton.h"
+
 Fractalcruncher::Fractalcruncher(
     constants::fracbuff &buff, const std::shared_ptr<FractalParameters> &params)
-    : buff(buff), params(params)
+    : buff(buff), params(params), workerclock(nullptr)
 {
 }
 Fractalcruncher::~Fractalcruncher() {}
+void Fractalcruncher::set_workerclock(Workerclock *clock)
+{
+    this->workerclock = clock;
+}
+
+void Fractalcruncher::supersample_buffer(constants::samplebuff &samples)
+{
+    for (unsigned int iy = 0; iy < this->params->yrange; iy++) {
+        for (unsigned int ix = 0; ix < this->params->xrange; ix++) {
+            if (this->is_edge_pixel(ix, iy)) {
+                samples[static_cast<unsigned long>(iy) * this->params->xrange +
+                        ix] = this->supersample_pixel(ix, iy);
+            }
+        }
+    }
+}
 std::tuple<unsigned int, double, double> Fractalcruncher::crunch_complex(
     double x, double y, unsigned int bailout) const
 {
     // The Fractal algorithm derived from pseudo code
     // TODO: This code gets more and more ugly dependening on how much fractals
     // I try to support.
+    if (params->set_type == constants::FRACTAL::FORMULA)
+        return params->formula->iterate(x, y, bailout);
     unsigned int iterations = 0;
     double x0 = x;
     double y0 = y;
@@ -58,12 +82,118 @@ std::tuple<unsigned int, double, double> Fractalcruncher::crunch_complex(
     return std::make_tuple(iterations, x, y);
 }
 
+constants::Iterations Fractalcruncher::crunch_distance(
+    double x, double y, unsigned int bailout) const
+{
+    unsigned int iterations = 0;
+    double x0 = x;
+    double y0 = y;
+    // z starts at c (z0 for Julia sets) so the derivative with respect to c
+    // (z0) starts at 1
+    double dx = 1;
+    double dy = 0;
+    bool julia = params->set_type == constants::FRACTAL::JULIA;
+    if (julia) {
+        x0 = params->julia_real;
+        y0 = params->julia_ima;
+    }
+    bool tricorn = params->set_type == constants::FRACTAL::TRICORN;
+    bool burning_ship = params->set_type == constants::FRACTAL::BURNING_SHIP;
+    // escape radius for the distance estimate, the escape time still uses 2
+    const double de_radius = 1e8;
+    const unsigned int de_extra = 8;
+    unsigned int extra = 0;
+    while (iterations < bailout || extra > 0) {
+        double r2 = x * x + y * y;
+        if (extra == 0 && r2 > 4.0)
+            extra = 1;
+        if (extra > 0 && (r2 > de_radius || extra > de_extra))
+            break;
+        if (burning_ship) {
+            // the fold mirrors the derivative as well
+            if (x < 0) {
+                x = -x;
+                dx = -dx;
+            }
+            if (y < 0) {
+                y = -y;
+                dy = -dy;
+            }
+        }
+        // dz' = 2 * z * dz (+ 1), the tricorn conjugates z and dz
+        double sy = tricorn ? -y : y;
+        double sdy = tricorn ? -dy : dy;
+        double dx_old = dx;
+        dx = 2 * (x * dx - sy * sdy) + (julia ? 0 : 1);
+        dy = 2 * (x * sdy + sy * dx_old);
+        double x_old = x;
+        x = x * x - y * y + x0;
+        if (tricorn) {
+            y = -2 * x_old * y + y0;
+        } else {
+            y = 2 * x_old * y + y0;
+        }
+        if (extra > 0)
+            extra++;
+        else
+            iterations++;
+    }
+
+    constants::Iterations it;
+    it.default_index = iterations;
+    it.cost = iterations + (extra > 0 ? extra - 1 : 0);
+    if (iterations < bailout) {
+        double r = std::sqrt(x * x + y * y);
+        double dr = std::sqrt(dx * dx + dy * dy);
+        it.distance = dr > 0 ? 0.5 * r * std::log(r) / dr : 0;
+    }
+    return it;
+}
+
+constants::Iterations Fractalcruncher::crunch_pixel(double x, double y) const
+{
+    if (this->params->set_type == constants::FRACTAL::NEWTON)
+        return this->params->newton->iterate(x, y, this->params->bailout);
+    // formulas have no derivative, they get no distance estimate
+    if (this->params->col_algo == constants::COL_ALGO::DISTANCE &&
+        this->params->set_type != constants::FRACTAL::FORMULA)
+        return this->crunch_distance(x, y, this->params->bailout);
+    auto crunched_mandel = this->crunch_complex(x, y, this->params->bailout);
+    return this->iterations_factory(std::get<0>(crunched_mandel),
+                                    std::get<1>(crunched_mandel),
+                                    std::get<2>(crunched_mandel));
+}
+
+void Fractalcruncher::crunch_span(unsigned int iy, unsigned int x0,
+                                  unsigned int x1)
+{
+    auto &row = this->buff[iy];
+    double y = this->params->y + this->params->ydelta * iy;
+    if (this->params->set_type == constants::FRACTAL::NEWTON) {
+        // the Newton kernel computes several pixels at once
+        double xs[Newton::lanes * 16];
+        const unsigned int chunk = Newton::lanes * 16;
+        for (unsigned int ix = x0; ix < x1; ix += chunk) {
+            unsigned int n = std::min(chunk, x1 - ix);
+            for (unsigned int k = 0; k < n; k++)
+                xs[k] = this->params->x + this->params->xdelta * (ix + k);
+            this->params->newton->iterate_span(xs, y, n, this->params->bailout,
+                                               &row[ix]);
+        }
+        return;
+    }
+    for (unsigned int ix = x0; ix < x1; ix++)
+        row[ix] = this->crunch_pixel(this->params->x + this->params->xdelta * ix,
+                                     y);
+}
+
 constants::Iterations Fractalcruncher::iterations_factory(unsigned int its,
                                                           double Zx,
                                                           double Zy) const
 {
     constants::Iterations it;
     it.default_index = its;
+    it.cost = its;
     if (this->params->col_algo == constants::COL_ALGO::CONTINUOUS_SINE) {
         double cont_index =
             its + 1 -
@@ -74,3 +204,52 @@ constants::Iterations Fractalcruncher::iterations_factory(unsigned int its,
     }
     return it;
 }
+
+bool Fractalcruncher::is_edge_pixel(unsigned int ix, unsigned int iy) const
+{
+    // continuous index is only available for the sine coloring algorithm,
+    // Newton fractals store the root basin in its place
+    bool newton = this->params->set_type == constants::FRACTAL::NEWTON;
+    auto index = [this, newton](const constants::Iterations &it) {
+        if (!newton &&
+            this->params->col_algo == constants::COL_ALGO::CONTINUOUS_SINE)
+            return it.continous_index;
+        return static_cast<double>(it.default_index);
+    };
+    const constants::Iterations &center_it = this->buff[iy][ix];
+    double center = index(center_it);
+    unsigned int ymin = iy == 0 ? 0 : iy - 1;
+    unsigned int xmin = ix == 0 ? 0 : ix - 1;
+    unsigned int ymax = std::min(iy + 1, this->params->yrange - 1);
+    unsigned int xmax = std::min(ix + 1, this->params->xrange - 1);
+    for (unsigned int ny = ymin; ny <= ymax; ny++) {
+        for (unsigned int nx = xmin; nx <= xmax; nx++) {
+            const constants::Iterations &it = this->buff[ny][nx];
+            // basin borders are edges even if the iteration counts match,
+            // like the bands of Fractalcrunchboundary
+            if (newton && it.basin != center_it.basin)
+                return true;
+            if (std::fabs(index(it) - center) > this->params->aa_threshold)
+                return true;
+        }
+    }
+    return false;
+}
+
+std::vector<constants::Iterations> Fractalcruncher::supersample_pixel(
+    unsigned int ix, unsigned int iy) const
+{
+    std::vector<constants::Iterations> samples;
+    samples.reserve(this->params->aa_samples);
+    std::minstd_rand gen(static_cast<unsigned long>(iy) * this->params->xrange +
+                         ix + 1);
+    std::uniform_real_distribution<double> jitter(-0.5, 0.5);
+    double x = this->params->x + ix * this->params->xdelta;
+    double y = this->params->y + iy * this->params->ydelta;
+    for (unsigned int i = 0; i < this->params->aa_samples; i++) {
+        samples.push_back(
+            this->crunch_pixel(x + jitter(gen) * this->params->xdelta,
+                               y + jitter(gen) * this->params->ydelta));
+    }
+    return samples;
+}
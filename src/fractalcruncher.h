@@ -21,9 +21,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <tuple>
 #include <cmath>
+#include <vector>
 
 #include "global.h"
 #include "fractalparams.h"
+#include "stats.h"
 
 class Fractalcruncher
 {
@@ -33,10 +35,32 @@ public:
     virtual ~Fractalcruncher();
 
     virtual void fill_buffer() = 0;
+    /**
+     * @brief Compute additional samples for pixels on high frequency edges
+     *
+     * @param samples Sparse buffer that receives the extra samples
+     *
+     * @details
+     * Must be called after fill_buffer. Every pixel whose index differs from
+     * one of its eight neighbors by more than aa_threshold gets aa_samples
+     * additional jittered samples. All other pixels keep their single sample.
+     */
+    virtual void supersample_buffer(constants::samplebuff &samples);
+
+    /**
+     * @brief Record the busy time of the worker threads
+     *
+     * @param clock Clock with a slot for every worker thread or nullptr
+     *
+     * @details
+     * Only engines with a thread pool use the clock.
+     */
+    void set_workerclock(Workerclock *clock);
 
 protected:
     constants::fracbuff &buff;
     const std::shared_ptr<FractalParameters> &params;
+    Workerclock *workerclock;
 
     /**
      * @brief Mandelbrot algorithm
@@ -57,6 +81,42 @@ protected:
      */
     std::tuple<unsigned int, double, double> crunch_complex(
         double x, double y, unsigned int bailout) const;
+    /**
+     * @brief Escape time algorithm that also tracks the derivative
+     *
+     * @param x
+     * @param y
+     * @param bailout
+     *
+     * @return Iterations object with the escape time and the estimated
+     * distance to the set
+     *
+     * @details
+     * Alongside z the derivative dz/dc is iterated (dz/dz0 for Julia sets).
+     * Once z escaped, the iteration continues for a few steps to get a large
+     * |z|. The distance estimate 0.5 * |z| * log|z| / |dz| is only accurate
+     * for large |z|. These extra steps are counted in the cost but not in
+     * the escape time. Tricorn and Burning Ship are not holomorphic, so their
+     * derivative and distance are approximations.
+     */
+    constants::Iterations crunch_distance(double x, double y,
+                                          unsigned int bailout) const;
+    /**
+     * @brief Compute the Iterations object of a point with the algorithm the
+     * coloring needs
+     *
+     * @param x Real part
+     * @param y Imaginary part
+     */
+    constants::Iterations crunch_pixel(double x, double y) const;
+    /**
+     * @brief Compute the pixels x0 to x1 (exclusive) of row iy
+     *
+     * @details
+     * Gives the same results as crunch_pixel for every pixel, but fractals
+     * with a vectorized kernel compute several pixels at once.
+     */
+    void crunch_span(unsigned int iy, unsigned int x0, unsigned int x1);
     /**
      * @brief Returns an Iterations object based on the coloring algorithm
      *
@@ -70,6 +130,31 @@ protected:
     constants::Iterations iterations_factory(unsigned int its, double Zx,
                                              double Zy) const;
 
+    /**
+     * @brief Check if a pixel lies on an edge that needs supersampling
+     *
+     * @param ix X coordinate of the pixel
+     * @param iy Y coordinate of the pixel
+     *
+     * @return True if at least one neighbor exceeds the aa_threshold or
+     * converged to another root of a Newton polynomial
+     */
+    bool is_edge_pixel(unsigned int ix, unsigned int iy) const;
+
+    /**
+     * @brief Compute aa_samples jittered samples inside the area of a pixel
+     *
+     * @param ix X coordinate of the pixel
+     * @param iy Y coordinate of the pixel
+     *
+     * @return Vector with the additional samples
+     *
+     * @details
+     * The jitter is seeded with the pixel index so renders are reproducible.
+     */
+    std::vector<constants::Iterations> supersample_pixel(unsigned int ix,
+                                                         unsigned int iy) const;
+
 private:
 };
 
@@ -18,48 +18,264 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "fractalcrunchmulti.h"
 
+#include <algorithm>
+#include <cmath>
+
 Fractalcrunchmulti::Fractalcrunchmulti(
     constants::fracbuff &buff, const std::shared_ptr<FractalParameters> &params)
-    : Fractalcruncher(buff, params)
+    : Fractalcruncher(buff, params),
+      own_tpl(new ctpl::thread_pool(params->cores)),
+      tpl(own_tpl.get()),
+      jobtrace(nullptr),
+      numa(nullptr)
+{
+}
+
+Fractalcrunchmulti::Fractalcrunchmulti(
+    constants::fracbuff &buff, const std::shared_ptr<FractalParameters> &params,
+    ctpl::thread_pool &tpl)
+    : Fractalcruncher(buff, params),
+      tpl(&tpl),
+      jobtrace(nullptr),
+      numa(nullptr)
 {
 }
 
 Fractalcrunchmulti::~Fractalcrunchmulti() {}
+void Fractalcrunchmulti::set_jobtrace(Jobtrace *trace)
+{
+    this->jobtrace = trace;
+}
+
+void Fractalcrunchmulti::set_costmap(const Costmap &map)
+{
+    this->costmap = map;
+}
+
+void Fractalcrunchmulti::set_numa(const Numatopology *topo)
+{
+    this->numa = topo;
+    if (topo != nullptr)
+        topo->pin(*this->tpl);
+}
+
+void Fractalcrunchmulti::first_touch()
+{
+    if (this->numa == nullptr)
+        return;
+    Nodequeue queue(this->numa->nodes());
+    for (unsigned int iy = 0; iy < this->buff.size(); iy++)
+        queue.push(this->numa->row_node(
+                       iy, static_cast<unsigned int>(this->buff.size())),
+                   iy);
+    unsigned int width = this->params->xrange;
+    this->numa->run(*this->tpl, queue, [this, width](int, size_t iy) {
+        // the old row is freed, the new one is zeroed by this worker
+        constants::fracrow(width).swap(this->buff[iy]);
+    });
+}
+
+const Costmap &Fractalcrunchmulti::prepass_costmap(unsigned int divisor)
+{
+    divisor = std::max(divisor, 1u);
+    auto low = std::make_shared<FractalParameters>(*this->params);
+    low->set_complex_plane(std::max(this->params->xrange / divisor, 1u),
+                           this->params->xl, this->params->xh,
+                           std::max(this->params->yrange / divisor, 1u),
+                           this->params->yl, this->params->yh);
+    constants::fracbuff low_buff(
+        low->yrange, constants::fracrow(low->xrange));
+    // the pre-pass runs on our pool, with one job per row
+    Fractalcrunchmulti prepass(low_buff, low, *this->tpl);
+    prepass.fill_buffer();
+    this->costmap = Costmap::from_buffer(low_buff, nullptr, *low, 1);
+    return this->costmap;
+}
+
+std::vector<Fractalcrunchmulti::Region> Fractalcrunchmulti::schedule(
+    const Costmap &map, const FractalParameters &params, unsigned int jobs)
+{
+    std::vector<Region> regions;
+    if (params.xrange == 0 || params.yrange == 0)
+        return regions;
+
+    // the map is coarse, sampling it for every pixel would be wasted time.
+    // Every row is divided into blocks and the prediction of a block is
+    // sampled in its center. One iteration is added for every pixel as even
+    // pixels that escape immediately are not free.
+    unsigned int blocks = std::min(params.xrange, 256u);
+    std::vector<unsigned int> block_x(blocks + 1);
+    for (unsigned int b = 0; b <= blocks; b++)
+        block_x[b] = static_cast<unsigned int>(
+            static_cast<unsigned long>(b) * params.xrange / blocks);
+
+    std::vector<std::vector<double>> prefix(params.yrange,
+                                            std::vector<double>(blocks + 1, 0));
+    double total = 0;
+    for (unsigned int iy = 0; iy < params.yrange; iy++) {
+        double im = params.y + (iy + 0.5) * params.ydelta;
+        auto &p = prefix[iy];
+        for (unsigned int b = 0; b < blocks; b++) {
+            double center = (block_x[b] + block_x[b + 1]) / 2.0;
+            double re = params.x + center * params.xdelta;
+            p[b + 1] = p[b] + (map.density(re, im) + 1.0) *
+                                  (block_x[b + 1] - block_x[b]);
+        }
+        total += p[blocks];
+    }
+
+    double target = total / std::max(jobs, 1u);
+    unsigned int band_start = 0;
+    double band_cost = 0;
+    for (unsigned int iy = 0; iy < params.yrange; iy++) {
+        const auto &p = prefix[iy];
+        double row_cost = p[blocks];
+        if (row_cost > target) {
+            if (iy > band_start)
+                regions.push_back(
+                    {0, params.xrange, band_start, iy, band_cost});
+            // split an expensive row into spans of about target cost
+            unsigned int spans = std::min(
+                blocks, static_cast<unsigned int>(std::ceil(row_cost / target)));
+            unsigned int b0 = 0;
+            for (unsigned int s = 1; s <= spans; s++) {
+                unsigned int b1 = blocks;
+                if (s < spans) {
+                    double cut = row_cost * s / spans;
+                    b1 = static_cast<unsigned int>(
+                        std::lower_bound(p.begin() + b0 + 1, p.end(), cut) -
+                        p.begin());
+                    b1 = std::min(b1, blocks - (spans - s));
+                }
+                if (b1 > b0) {
+                    regions.push_back({block_x[b0], block_x[b1], iy, iy + 1,
+                                       p[b1] - p[b0]});
+                    b0 = b1;
+                }
+            }
+            band_start = iy + 1;
+            band_cost = 0;
+            continue;
+        }
+        if (band_cost + row_cost > target && iy > band_start) {
+            regions.push_back({0, params.xrange, band_start, iy, band_cost});
+            band_start = iy;
+            band_cost = 0;
+        }
+        band_cost += row_cost;
+    }
+    if (params.yrange > band_start)
+        regions.push_back(
+            {0, params.xrange, band_start, params.yrange, band_cost});
+
+    std::stable_sort(regions.begin(), regions.end(),
+                     [](const Region &a, const Region &b) {
+                         return a.cost > b.cost;
+                     });
+    return regions;
+}
+
 void Fractalcrunchmulti::fill_buffer()
 {
     // a vector filled with futures. We will wait for all of them to be finished.
     std::vector<std::future<void>> futures;
-    ctpl::thread_pool tpl(this->params->cores);
-
-    // calculate the set line by line. Each line will be pushed to the
-    // thread pool as separate job. The id parameter of the lambda function
-    // represents the thread id.
-    double x = this->params->x;
-    double y = this->params->y;
-    int iy = 0; /**< row to calculate*/
-    for (auto &int_vec : buff) {
-        futures.push_back(tpl.push([&int_vec, x, y, iy, this](int id) {
-            double ypass = y;  // y value is constant for each row
-            double xpass = x;
-            if (iy != 0)
-                ypass += this->params->ydelta * iy;
-            for (unsigned int ix = 0; ix < this->params->xrange; ix++) {
-                auto crunched_mandel =
-                    this->crunch_complex(xpass, ypass, this->params->bailout);
 
-                unsigned int its = std::get<0>(crunched_mandel);
-                double Zx = std::get<1>(crunched_mandel);
-                double Zy = std::get<2>(crunched_mandel);
-                int_vec[ix] = this->iterations_factory(its, Zx, Zy);
+    std::vector<Region> regions;
+    if (this->costmap.matches(*this->params)) {
+        // a few jobs per thread leave room to balance prediction errors
+        regions = schedule(this->costmap, *this->params,
+                           static_cast<unsigned int>(this->tpl->size()) * 4);
+    } else {
+        // calculate the set line by line. Each line will be pushed to the
+        // thread pool as separate job.
+        regions.reserve(this->params->yrange);
+        for (unsigned int iy = 0; iy < this->params->yrange; iy++)
+            regions.push_back({0, this->params->xrange, iy, iy + 1, 0});
+    }
 
-                // increment xpass by xdelta
-                xpass += this->params->xdelta;
-            }
+    if (this->numa != nullptr) {
+        // the regions keep their order within every node
+        auto queued = Workerclock::clock::now();
+        Nodequeue queue(this->numa->nodes());
+        for (size_t i = 0; i < regions.size(); i++)
+            queue.push(this->numa->row_node(regions[i].y0,
+                                            this->params->yrange),
+                       i);
+        this->numa->run(*this->tpl, queue,
+                        [this, &regions, queued](int id, size_t i) {
+                            this->fill_region(id, regions[i], queued);
+                        });
+        return;
+    }
+
+    // The id parameter of the lambda function represents the thread id.
+    for (const Region &region : regions) {
+        auto queued = Workerclock::clock::now();
+        futures.push_back(this->tpl->push([region, queued, this](int id) {
+            this->fill_region(id, region, queued);
         }));
-        iy++;
     }
     // make sure all jobs are finished
     for (const std::future<void> &f : futures) {
         f.wait();
     }
 }
+
+void Fractalcrunchmulti::fill_region(int id, const Region &region,
+                                     Workerclock::clock::time_point queued)
+{
+    auto begin = Workerclock::clock::now();
+    unsigned long long region_its = 0;
+    for (unsigned int iy = region.y0; iy < region.y1; iy++) {
+        this->crunch_span(iy, region.x0, region.x1);
+        const auto &int_vec = this->buff[iy];
+        for (unsigned int ix = region.x0; ix < region.x1; ix++)
+            region_its += int_vec[ix].cost;
+    }
+    if (this->workerclock != nullptr)
+        this->workerclock->add(id, begin);
+    if (this->jobtrace != nullptr)
+        this->jobtrace->add(id, "compute", region.y0, queued, begin,
+                            region_its);
+}
+
+void Fractalcrunchmulti::supersample_buffer(constants::samplebuff &samples)
+{
+    // every row job collects the samples of its edge pixels in a local
+    // container. This way no locking is needed and the main thread merges
+    // the results afterwards.
+    typedef std::vector<std::pair<unsigned long, std::vector<constants::Iterations>>>
+        rowsamples;
+    std::vector<std::future<rowsamples>> futures;
+
+    for (unsigned int iy = 0; iy < this->params->yrange; iy++) {
+        auto queued = Workerclock::clock::now();
+        futures.push_back(this->tpl->push([iy, queued, this](int id) {
+            auto begin = Workerclock::clock::now();
+            unsigned long long row_its = 0;
+            rowsamples row;
+            for (unsigned int ix = 0; ix < this->params->xrange; ix++) {
+                if (this->is_edge_pixel(ix, iy)) {
+                    row.emplace_back(
+                        static_cast<unsigned long>(iy) * this->params->xrange +
+                            ix,
+                        this->supersample_pixel(ix, iy));
+                    for (const auto &s : row.back().second)
+                        row_its += s.cost;
+                }
+            }
+            if (this->workerclock != nullptr)
+                this->workerclock->add(id, begin);
+            if (this->jobtrace != nullptr)
+                this->jobtrace->add(id, "supersample", iy, queued, begin,
+                                    row_its);
+            return row;
+        }));
+    }
+
+    for (auto &f : futures) {
+        for (auto &s : f.get()) {
+            samples[s.first] = std::move(s.second);
+        }
+    }
+}
@@ -20,22 +20,128 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define FRACTALCRUNCHMULTI_H
 
 #include <thread>
+#include <memory>
 #include "ctpl_stl.h"
 
 #include "global.h"
+#include "costmap.h"
 #include "fractalcruncher.h"
+#include "numa.h"
 
 class Fractalcrunchmulti : public Fractalcruncher
 {
 public:
+    /**
+     * @brief Rectangular part of the image computed by one job
+     */
+    struct Region {
+        unsigned int x0;
+        unsigned int x1;  // exclusive
+        unsigned int y0;
+        unsigned int y1;  // exclusive
+        double cost;      // predicted iterations
+    };
+
     Fractalcrunchmulti(constants::fracbuff &buff,
                       const std::shared_ptr<FractalParameters> &params);
+    /**
+     * @brief Use an existing thread pool instead of creating a new one
+     *
+     * @param buff
+     * @param params
+     * @param tpl Thread pool that must outlive this object
+     *
+     * @details
+     * Long running processes like the render server keep a warm thread pool
+     * and avoid starting new threads for every fractal.
+     */
+    Fractalcrunchmulti(constants::fracbuff &buff,
+                      const std::shared_ptr<FractalParameters> &params,
+                      ctpl::thread_pool &tpl);
     virtual ~Fractalcrunchmulti();
 
     void fill_buffer();
+    void supersample_buffer(constants::samplebuff &samples);
+
+    /**
+     * @brief Record every row job in a trace
+     *
+     * @param trace Trace with a slot for every worker thread or nullptr
+     */
+    void set_jobtrace(Jobtrace *trace);
+
+    /**
+     * @brief Schedule the jobs of fill_buffer by their predicted cost
+     *
+     * @param map Cost map of a previous frame or a pre-pass. An empty map or
+     * a map of another fractal restores the default of one job per row.
+     */
+    void set_costmap(const Costmap &map);
+
+    /**
+     * @brief Predict the cost with a low resolution render of this view
+     *
+     * @param divisor The pre-pass has 1/divisor of the width and height of
+     * the image, so it costs about 1/divisor^2 of the full render
+     *
+     * @return Cost map of the pre-pass, it is also used by fill_buffer
+     */
+    const Costmap &prepass_costmap(unsigned int divisor);
+
+    /**
+     * @brief Cut the image into regions of roughly equal predicted cost
+     *
+     * @param map Cost map used for the prediction
+     * @param params Parameters of the image
+     * @param jobs Number of regions to aim for
+     *
+     * @return Regions that cover every pixel once, the most expensive first
+     *
+     * @details
+     * Consecutive cheap rows are merged into bands while expensive rows are
+     * split into spans, until every region is close to the average cost.
+     * Dispatching the regions in descending order of their cost (longest
+     * processing time first) makes sure no worker starts an expensive region
+     * at the end while the others are idle.
+     */
+    /**
+     * @brief Keep rows and the workers computing them on the same NUMA node
+     *
+     * @param topo Node topology that must outlive this object, nullptr
+     * disables NUMA awareness
+     *
+     * @details
+     * The workers of the pool are pinned to the nodes. fill_buffer lets
+     * every worker compute the rows of its own node first and only helps
+     * other nodes when its node is finished.
+     */
+    void set_numa(const Numatopology *topo);
+
+    /**
+     * @brief Allocate every row of the buffer again on its NUMA node
+     *
+     * @details
+     * The buffer is usually allocated and zeroed by the main thread, so all
+     * pages are placed on its node. This replaces every row by a fresh one
+     * that a worker of the row's node allocates and touches first. Needs
+     * set_numa and must be called before fill_buffer.
+     */
+    void first_touch();
+
+    static std::vector<Region> schedule(const Costmap &map,
+                                        const FractalParameters &params,
+                                        unsigned int jobs);
 
 private:
     /* data */
+    std::unique_ptr<ctpl::thread_pool> own_tpl;
+    ctpl::thread_pool *tpl;
+    Jobtrace *jobtrace;
+    Costmap costmap;
+    const Numatopology *numa;
+
+    void fill_region(int id, const Region &region,
+                     Workerclock::clock::time_point queued);
 };
 
 #endif /* ifndef FRACTALCRUNCHMULTI_H */
@@ -0,0 +1,103 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fractalcrunchprogressive.h"
+
+Fractalcrunchprogressive::Fractalcrunchprogressive(
+    constants::fracbuff &buff, const std::shared_ptr<FractalParameters> &params,
+    progresscallback callback)
+    : Fractalcruncher(buff, params), callback(std::move(callback))
+{
+}
+
+Fractalcrunchprogressive::~Fractalcrunchprogressive() {}
+void Fractalcrunchprogressive::fill_buffer()
+{
+    // the pool is used for all levels, without multicore option the levels
+    // are computed by one worker thread.
+    ctpl::thread_pool tpl(
+        static_cast<int>(std::max(this->params->cores, 1u)));
+
+    // the coarsest step has to be a power of two so every level reuses all
+    // samples of the previous one
+    unsigned int step = 1;
+    while (step * 2 <= this->params->progressive)
+        step *= 2;
+
+    bool first = true;
+    for (; step >= 1; step /= 2) {
+        this->crunch_level(tpl, step, first);
+        if (step > 1)
+            this->fill_level(tpl, step);
+        if (this->callback)
+            this->callback(step);
+        first = false;
+    }
+}
+
+void Fractalcrunchprogressive::crunch_level(ctpl::thread_pool &tpl,
+                                            unsigned int step, bool first)
+{
+    std::vector<std::future<void>> futures;
+    for (unsigned int iy = 0; iy < this->params->yrange; iy += step) {
+        futures.push_back(tpl.push([iy, step, first, this](int id) {
+            auto begin = Workerclock::clock::now();
+            double y = this->params->y + this->params->ydelta * iy;
+            // on odd rows of this level every pixel is new, on even rows only
+            // every second one. Pixels aligned to step * 2 were computed on
+            // the previous level.
+            bool row_known = !first && iy % (step * 2) == 0;
+            unsigned int xstart = row_known ? step : 0;
+            unsigned int xinc = row_known ? step * 2 : step;
+            for (unsigned int ix = xstart; ix < this->params->xrange;
+                 ix += xinc) {
+                this->buff[iy][ix] = this->crunch_pixel(
+                    this->params->x + this->params->xdelta * ix, y);
+            }
+            if (this->workerclock != nullptr)
+                this->workerclock->add(id, begin);
+        }));
+    }
+    for (const std::future<void> &f : futures) {
+        f.wait();
+    }
+}
+
+void Fractalcrunchprogressive::fill_level(ctpl::thread_pool &tpl,
+                                          unsigned int step)
+{
+    // replicate each computed sample over its step x step block. Only pixels
+    // that are not aligned to the current step are touched.
+    std::vector<std::future<void>> futures;
+    for (unsigned int iy = 0; iy < this->params->yrange; iy++) {
+        futures.push_back(tpl.push([iy, step, this](int id) {
+            (void)id;
+            const auto &src = this->buff[iy - iy % step];
+            auto &dst = this->buff[iy];
+            bool row_aligned = iy % step == 0;
+            for (unsigned int ix = 0; ix < this->params->xrange; ix++) {
+                if (row_aligned && ix % step == 0)
+                    continue;
+                dst[ix] = src[ix - ix % step];
+            }
+        }));
+    }
+    for (const std::future<void> &f : futures) {
+        f.wait();
+    }
+}
@@ -0,0 +1,67 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRACTALCRUNCHPROGRESSIVE_H
+#define FRACTALCRUNCHPROGRESSIVE_H
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "ctpl_stl.h"
+
+#include "global.h"
+#include "fractalcruncher.h"
+
+/**
+ * @brief Multi resolution cruncher that publishes intermediate buffers
+ *
+ * @details
+ * The first level computes every n-th pixel in both directions, where n is
+ * the coarsest step. Every following level halves the step and only computes
+ * the pixels that are new on this level, samples of coarser levels are reused.
+ * After each level the pixels that were not yet computed are filled with the
+ * nearest computed sample and the progress callback is invoked. This way a
+ * viewer gets a coarse version of the fractal within milliseconds.
+ */
+class Fractalcrunchprogressive : public Fractalcruncher
+{
+public:
+    /**
+     * @brief Callback invoked after each level with the current step size
+     *
+     * @details
+     * The step is 1 for the final level, which means the buffer is complete.
+     */
+    typedef std::function<void(unsigned int step)> progresscallback;
+
+    Fractalcrunchprogressive(constants::fracbuff &buff,
+                             const std::shared_ptr<FractalParameters> &params,
+                             progresscallback callback);
+    virtual ~Fractalcrunchprogressive();
+
+    void fill_buffer();
+
+private:
+    progresscallback callback;
+
+    void crunch_level(ctpl::thread_pool &tpl, unsigned int step, bool first);
+    void fill_level(ctpl::thread_pool &tpl, unsigned int step);
+};
+
+#endif /* ifndef FRACTALCRUNCHPROGRESSIVE_H */
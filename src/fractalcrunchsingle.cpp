@@ -27,23 +27,9 @@ Fractalcrunchsingle::Fractalcrunchsingle(
 Fractalcrunchsingle::~Fractalcrunchsingle() {}
 void Fractalcrunchsingle::fill_buffer()
 {
-    double x = this->params->x;
-    double y = this->params->y;
-
-    // calculate pixel by pixel
-    for (unsigned int iy = 0; iy < this->params->yrange; iy++) {
-        for (unsigned int ix = 0; ix < this->params->xrange; ix++) {
-            auto crunched_mandel =
-                this->crunch_complex(x, y, this->params->bailout);
-
-            unsigned int its = std::get<0>(crunched_mandel);
-            double Zx = std::get<1>(crunched_mandel);
-            double Zy = std::get<2>(crunched_mandel);
-            buff[iy][ix] = this->iterations_factory(its, Zx, Zy);
-
-            x += this->params->xdelta;
-        }
-        y += this->params->ydelta;
-        x = this->params->xl;
-    }
+    // calculate row by row. The complex number is derived from the pixel
+    // index instead of accumulating the deltas so all engines compute exactly
+    // the same coordinates.
+    for (unsigned int iy = 0; iy < this->params->yrange; iy++)
+        this->crunch_span(iy, 0, this->params->xrange);
 }
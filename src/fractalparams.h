@@ -19,10 +19,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef FRACTALPARAMS_H
 #define FRACTALPARAMS_H
 
+#include <memory>
 #include <string>
 
 #include "global.h"
 
+// users of these include formula.h and newton.h, they are not part of the
+// public API
+class Formula;
+class Newton;
+
 struct FractalParameters {
     constants::FRACTAL set_type;
 
@@ -41,6 +47,11 @@ struct FractalParameters {
     double julia_real;
     double julia_ima;
 
+    // Compiled iteration formula of the FORMULA fractal type
+    std::shared_ptr<const Formula> formula;
+    // Polynomial of the NEWTON fractal type
+    std::shared_ptr<const Newton> newton;
+
     unsigned int bailout;
 
     double zoom;
@@ -54,6 +65,17 @@ struct FractalParameters {
 
     constants::COL_ALGO col_algo;
 
+    // Additional jittered samples for edge pixels, 0 disables supersampling
+    unsigned int aa_samples = 0;
+    // Minimum index difference to a neighbor that marks a pixel as edge pixel
+    double aa_threshold = 1.0;
+
+    // Coarsest step of the progressive renderer, 0 disables progressive mode
+    unsigned int progressive = 0;
+
+    // Region size of the boundary tracing engine, 0 disables boundary tracing
+    unsigned int boundary = 0;
+
     FractalParameters() {}
     FractalParameters(constants::FRACTAL set_type, unsigned int xrange,
                       double xl, double xh, unsigned int yrange, double yl,
@@ -86,5 +108,29 @@ struct FractalParameters {
         this->xdelta = (xh - xl) / xrange;
         this->ydelta = (yh - yl) / yrange;
     }
+
+    /**
+     * @brief Change the complex plane and the image size
+     *
+     * @details
+     * Derived values like the deltas are updated as well. This allows to copy
+     * a parameters object and only change the area that will be computed.
+     */
+    void set_complex_plane(unsigned int xrange, double xl, double xh,
+                           unsigned int yrange, double yl, double yh)
+    {
+        this->xrange = xrange;
+        this->xl = xl;
+        this->xh = xh;
+        this->yrange = yrange;
+        this->yl = yl;
+        this->yh = yh;
+
+        this->x = xl;
+        this->y = yl;
+
+        this->xdelta = (xh - xl) / xrange;
+        this->ydelta = (yh - yl) / yrange;
+    }
 };
 #endif /* ifndef FRACTALPARAMS_H */
@@ -0,0 +1,93 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "geomandel.h"
+
+#include "config.h"
+
+#include "printer.h"
+#include "image_rgb.h"
+
+#include "fractalcrunchboundary.h"
+#include "fractalcrunchsingle.h"
+#include "fractalcrunchmulti.h"
+#include "fractalcrunchprogressive.h"
+
+namespace geomandel
+{
+std::string version()
+{
+    std::string version =
+        std::string(GEOMANDEL_MAJOR) + "." + std::string(GEOMANDEL_MINOR);
+    if (std::string(GEOMANDEL_PATCH) != "0") {
+        version += "." + std::string(GEOMANDEL_PATCH);
+    }
+    return version;
+}
+
+constants::fracbuff create_buffer(const FractalParameters &params)
+{
+    // TODO: Using a two dimensional vector is unnecessary. Have a look at
+    // test_computation.cpp for a better solution.
+    constants::fracbuff buff;
+    buff.assign(params.yrange, constants::fracrow());
+    for (auto &v : buff) {
+        v.assign(params.xrange, constants::Iterations());
+    }
+    return buff;
+}
+
+void render(constants::fracbuff &buff,
+            const std::shared_ptr<FractalParameters> &params,
+            constants::samplebuff *samples)
+{
+    std::unique_ptr<Fractalcruncher> crunchi;
+    if (params->progressive > 0) {
+        crunchi = std::unique_ptr<Fractalcrunchprogressive>(
+            new Fractalcrunchprogressive(buff, params, nullptr));
+    } else if (params->boundary > 0) {
+        crunchi = std::unique_ptr<Fractalcrunchboundary>(
+            new Fractalcrunchboundary(buff, params));
+    } else if (params->cores > 0) {
+        crunchi = std::unique_ptr<Fractalcrunchmulti>(
+            new Fractalcrunchmulti(buff, params));
+    } else {
+        crunchi = std::unique_ptr<Fractalcrunchsingle>(
+            new Fractalcrunchsingle(buff, params));
+    }
+    crunchi->fill_buffer();
+    if (samples != nullptr && params->aa_samples > 0)
+        crunchi->supersample_buffer(*samples);
+}
+
+std::vector<uint8_t> render_rgb(const std::shared_ptr<FractalParameters> &params,
+                                const ColorParameters &colors)
+{
+    constants::fracbuff buff = create_buffer(*params);
+    constants::samplebuff samples;
+    render(buff, params, &samples);
+
+    std::shared_ptr<Printer> prnt = std::make_shared<Printer>(true);
+    ImageRGB img(buff, params, prnt, colors.rgb_base, colors.rgb_set_base,
+                 colors.rgb_freq, colors.rgb_phase, colors.rgb_amp);
+    img.set_samples(samples);
+    img.write_buffer();
+    const constants::rgbbuff &rgb = img.get_rgb_buffer();
+    return std::vector<uint8_t>(rgb.begin(), rgb.end());
+}
+}
@@ -0,0 +1,100 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GEOMANDEL_H
+#define GEOMANDEL_H
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <cstdint>
+
+#include "global.h"
+#include "fractalparams.h"
+
+/**
+ * @brief Public API of libgeomandel
+ *
+ * @details
+ * These functions allow to use the fractal engine in process without the
+ * command line application. Render parameters go in, an iteration buffer or a
+ * colorized image comes out. The engine is chosen from the parameters like
+ * the command line application does it.
+ */
+namespace geomandel
+{
+/**
+ * @brief Color options used when a buffer is colorized
+ *
+ * Defaults are the same as the defaults of the command line application.
+ */
+struct ColorParameters {
+    std::tuple<int, int, int> rgb_base = std::make_tuple(128, 128, 128);
+    std::tuple<int, int, int> rgb_set_base = std::make_tuple(0, 0, 0);
+    std::tuple<double, double, double> rgb_freq =
+        std::make_tuple(0.01, 0.01, 0.01);
+    std::tuple<int, int, int> rgb_phase = std::make_tuple(0, 2, 4);
+    std::tuple<double, double, double> rgb_amp = std::make_tuple(9, 15, 8.5);
+};
+
+/**
+ * @brief Library version as major.minor[.patch]
+ */
+std::string version();
+
+/**
+ * @brief Allocate a buffer that fits the image size of params
+ *
+ * @param params Fractal parameters
+ *
+ * @return Buffer with yrange rows of xrange Iterations objects
+ */
+constants::fracbuff create_buffer(const FractalParameters &params);
+
+/**
+ * @brief Compute a fractal
+ *
+ * @param buff Buffer created with create_buffer
+ * @param params Fractal parameters
+ * @param samples Optional sample buffer for supersampling, only used if
+ * aa_samples is greater than 0
+ *
+ * @details
+ * The progressive engine is used if progressive is greater than 0, the
+ * boundary tracing engine if boundary is greater than 0, the multicore engine
+ * if cores is greater than 0 and the singlecore engine otherwise. Boundary
+ * tracing throws std::invalid_argument if col_algo is not supported by it.
+ */
+void render(constants::fracbuff &buff,
+            const std::shared_ptr<FractalParameters> &params,
+            constants::samplebuff *samples = nullptr);
+
+/**
+ * @brief Compute and colorize a fractal
+ *
+ * @param params Fractal parameters
+ * @param colors Color options
+ *
+ * @return Packed RGB image, 3 bytes per pixel in row major order
+ */
+std::vector<uint8_t> render_rgb(const std::shared_ptr<FractalParameters> &params,
+                                const ColorParameters &colors);
+}
+
+#endif /* ifndef GEOMANDEL_H */
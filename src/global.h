@@ -19,13 +19,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef GLOBAL_H
 #define GLOBAL_H
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <sstream>
 #include <type_traits>
 
+#include "bufferarena.h"
 #include "cxxopts.hpp"
 
 /**
@@ -42,10 +46,10 @@ enum OUT_FORMAT {
     GEOTIFF
 };
 
-enum FRACTAL { MANDELBROT, TRICORN, JULIA, BURNING_SHIP };
+enum FRACTAL { MANDELBROT, TRICORN, JULIA, BURNING_SHIP, FORMULA, NEWTON };
 // TODO: I have removed ESCAPE_TIME_2 for the time beeing as it is just confusing
 // and not really adding something new.
-enum COL_ALGO { ESCAPE_TIME, CONTINUOUS_SINE, CONTINUOUS_BERN };
+enum COL_ALGO { ESCAPE_TIME, CONTINUOUS_SINE, CONTINUOUS_BERN, DISTANCE };
 
 const std::map<OUT_FORMAT, std::vector<std::string>> BITMAP_DEFS{
     {OUT_FORMAT::IMAGE_PNM_BW, {"pbm", "P1"}},
@@ -56,11 +60,25 @@ const std::map<OUT_FORMAT, std::vector<std::string>> BITMAP_DEFS{
 
 struct Iterations {
     unsigned int default_index;
-    double continous_index;
+    // Iterations that were executed to compute this sample. This is the work
+    // it took, not a color index, and fits into the padding before the double
+    unsigned int cost;
+    // Only one of these is computed for a fractal, depending on the coloring
+    // algorithm and the fractal type, so they share the memory
+    union {
+        // Continuous index for the sine coloring
+        double continous_index;
+        // Estimated distance to the set in the complex plane, only computed
+        // for the distance estimation coloring. 0 inside the set.
+        double distance;
+        // Index of the root a sample of a Newton fractal converged to
+        unsigned int basin;
+    };
 
     Iterations()
     {
         this->default_index = 0;
+        this->cost = 0;
         this->continous_index = 0;
     }
 
@@ -71,7 +89,19 @@ struct Iterations {
     }
 };
 
-typedef std::vector<std::vector<Iterations>> fracbuff;
+/**
+ * One row of the fractal buffer and the packed pixels of a RGB image. Both
+ * are frame sized and allocated from the Bufferarena.
+ */
+typedef std::vector<Iterations, Framealloc<Iterations>> fracrow;
+typedef std::vector<fracrow> fracbuff;
+typedef std::vector<uint8_t, Framealloc<uint8_t>> rgbbuff;
+/**
+ * Additional samples for pixels that were refined by the supersampling pass.
+ * The map key is the pixel index (y * width + x). Only a few percent of all
+ * pixels are stored here so a sparse container is sufficient.
+ */
+typedef std::unordered_map<unsigned long, std::vector<Iterations>> samplebuff;
 }
 
 namespace utility
@@ -95,6 +125,41 @@ inline void split(const std::string &s, char delim,
     }
 }
 
+/**
+ * @brief Initial value of a FNV-1a hash
+ */
+const uint64_t fnv_offset = 14695981039346656037ULL;
+
+/**
+ * @brief Add the bytes of a value to a FNV-1a hash
+ *
+ * @tparam T Trivially copyable type
+ * @param hash Current hash, start with fnv_offset
+ * @param value
+ */
+template <typename T>
+inline void fnv1a(uint64_t &hash, const T &value)
+{
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (unsigned char b : bytes) {
+        hash ^= b;
+        hash *= 1099511628211ULL;
+    }
+}
+
+/**
+ * @brief Add the characters of a string to a FNV-1a hash
+ */
+inline void fnv1a(uint64_t &hash, const std::string &value)
+{
+    fnv1a(hash, static_cast<uint64_t>(value.size()));
+    for (char ch : value) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ULL;
+    }
+}
+
 /**
  * @brief Primitives to string conversion
  *
@@ -0,0 +1,312 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "image_png.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include <zlib.h>
+
+#include "ctpl_stl.h"
+
+namespace
+{
+// uncompressed bytes per band, large enough for a good compression ratio
+const size_t band_bytes = 256 * 1024;
+
+void put_uint32(std::vector<uint8_t> &out, uint32_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void write_chunk(std::ofstream &out, const char *type, const uint8_t *data,
+                 size_t size)
+{
+    std::vector<uint8_t> head;
+    put_uint32(head, static_cast<uint32_t>(size));
+    head.insert(head.end(), type, type + 4);
+    uLong crc = crc32(0, head.data() + 4, 4);
+    if (size > 0)
+        crc = crc32(crc, data, static_cast<uInt>(size));
+    std::vector<uint8_t> tail;
+    put_uint32(tail, static_cast<uint32_t>(crc));
+
+    out.write(reinterpret_cast<const char *>(head.data()), head.size());
+    if (size > 0)
+        out.write(reinterpret_cast<const char *>(data),
+                  static_cast<std::streamsize>(size));
+    out.write(reinterpret_cast<const char *>(tail.data()), tail.size());
+}
+
+uint8_t paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<uint8_t>(a);
+    if (pb <= pc)
+        return static_cast<uint8_t>(b);
+    return static_cast<uint8_t>(c);
+}
+
+/**
+ * @brief Filter a row with all PNG filters and keep the best one
+ *
+ * @details
+ * Uses the heuristic recommended by the PNG specification, the filter with
+ * the smallest sum of absolute signed differences wins.
+ */
+void filter_row(const uint8_t *row, const uint8_t *prev, size_t len,
+                std::vector<uint8_t> &candidate, uint8_t *out)
+{
+    const size_t bpp = 3;
+    unsigned long best_sum = ~0ul;
+    for (uint8_t filter = 0; filter < 5; filter++) {
+        unsigned long sum = 0;
+        for (size_t i = 0; i < len; i++) {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = prev[i];
+            int c = i >= bpp ? prev[i - bpp] : 0;
+            uint8_t pred = 0;
+            switch (filter) {
+            case 1:
+                pred = static_cast<uint8_t>(a);
+                break;
+            case 2:
+                pred = static_cast<uint8_t>(b);
+                break;
+            case 3:
+                pred = static_cast<uint8_t>((a + b) / 2);
+                break;
+            case 4:
+                pred = paeth(a, b, c);
+                break;
+            }
+            uint8_t v = static_cast<uint8_t>(row[i] - pred);
+            candidate[i] = v;
+            sum += static_cast<unsigned long>(
+                std::abs(static_cast<int>(static_cast<int8_t>(v))));
+        }
+        if (sum < best_sum) {
+            best_sum = sum;
+            out[0] = filter;
+            std::copy(candidate.begin(), candidate.begin() + len, out + 1);
+        }
+    }
+}
+}
+
+ImagePNG::ImagePNG(const constants::fracbuff &buff,
+                   const std::shared_ptr<FractalParameters> &params,
+                   const std::shared_ptr<Printer> &prnt,
+                   std::tuple<int, int, int> rgb_base,
+                   std::tuple<int, int, int> rgb_set_base,
+                   std::tuple<double, double, double> rgb_freq,
+                   std::tuple<int, int, int> rgb_phase,
+                   std::tuple<double, double, double> rgb_amp)
+    : Imagewriter(buff, params, prnt),
+      rgb_base(std::move(rgb_base)),
+      rgb_set_base(std::move(rgb_set_base)),
+      rgb_freq(std::move(rgb_freq)),
+      rgb_phase(std::move(rgb_phase)),
+      rgb_amp(std::move(rgb_amp))
+{
+}
+
+ImagePNG::~ImagePNG() {}
+void ImagePNG::write_buffer()
+{
+    std::string filename =
+        this->out_file_name(
+            this->params->image_base, this->params->fractal_type,
+            this->params->bailout, this->params->xrange, this->params->yrange,
+            this->params->zoom, this->params->cores, this->params->xcoord,
+            this->params->ycoord, this->params->xl, this->params->xh,
+            this->params->yl, this->params->yh) +
+        ".png";
+    this->prnt << "+ \u2937 " + filename << std::endl;
+
+    std::ofstream out(filename, std::ofstream::out | std::ofstream::binary);
+    out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    try {
+        const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        out.write(reinterpret_cast<const char *>(signature),
+                  sizeof(signature));
+
+        std::vector<uint8_t> ihdr;
+        put_uint32(ihdr, this->params->xrange);
+        put_uint32(ihdr, this->params->yrange);
+        // 8 bit RGB, deflate, adaptive filtering, no interlacing
+        ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0});
+        write_chunk(out, "IHDR", ihdr.data(), ihdr.size());
+
+        // zlib header for a deflate stream with a 32K window
+        const uint8_t zlib_header[2] = {0x78, 0x9c};
+        write_chunk(out, "IDAT", zlib_header, sizeof(zlib_header));
+
+        unsigned int threads =
+            this->params->cores > 0
+                ? this->params->cores
+                : std::max(std::thread::hardware_concurrency(), 1u);
+        const size_t max_queued = threads * 2;
+        size_t row_bytes = static_cast<size_t>(this->params->xrange) * 3 + 1;
+        unsigned int band_rows = static_cast<unsigned int>(
+            std::max<size_t>(1, band_bytes / row_bytes));
+
+        // bands are written in order as soon as they are done
+        std::deque<std::future<Band>> bands;
+        uLong adler = adler32(0, Z_NULL, 0);
+        auto write_band = [&bands, &out, &adler]() {
+            Band band = bands.front().get();
+            bands.pop_front();
+            write_chunk(out, "IDAT", band.deflated.data(),
+                        band.deflated.size());
+            adler = adler32_combine(adler, band.adler,
+                                    static_cast<z_off_t>(band.raw_size));
+        };
+        unsigned int rows = this->params->yrange;
+        // small images like tiles consist of one band only, a thread pool is
+        // not worth it then
+        std::unique_ptr<ctpl::thread_pool> tpl;
+        if (band_rows < rows)
+            tpl = std::unique_ptr<ctpl::thread_pool>(
+                new ctpl::thread_pool(static_cast<int>(threads)));
+        for (unsigned int row = 0; row < rows; row += band_rows) {
+            if (bands.size() >= max_queued)
+                write_band();
+            unsigned int row_end = std::min(rows, row + band_rows);
+            bool last = row_end == rows;
+            if (tpl) {
+                bands.push_back(tpl->push([this, row, row_end, last](int id) {
+                    (void)id;
+                    return this->encode_band(row, row_end, last);
+                }));
+            } else {
+                bands.push_back(std::async(std::launch::deferred, [this]() {
+                    return this->encode_band(0, this->params->yrange, true);
+                }));
+            }
+        }
+        while (!bands.empty())
+            write_band();
+
+        std::vector<uint8_t> trailer;
+        put_uint32(trailer, static_cast<uint32_t>(adler));
+        write_chunk(out, "IDAT", trailer.data(), trailer.size());
+        write_chunk(out, "IEND", nullptr, 0);
+    } catch (const std::ofstream::failure &e) {
+        std::cerr << "Error writing png file " << filename << std::endl;
+        std::cerr << e.what() << std::endl;
+    } catch (const std::runtime_error &e) {
+        std::cerr << "Error encoding png file " << filename << std::endl;
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+std::tuple<int, int, int> ImagePNG::iterations_rgb(
+    const constants::Iterations &data)
+{
+    return this->rgb_palette(data, this->rgb_base, this->rgb_set_base,
+                             this->rgb_freq, this->rgb_phase, this->rgb_amp);
+}
+
+ImagePNG::Band ImagePNG::encode_band(unsigned int row_begin,
+                                     unsigned int row_end, bool last)
+{
+    size_t len = static_cast<size_t>(this->params->xrange) * 3;
+    std::vector<uint8_t> prev(len, 0);
+    std::vector<uint8_t> row(len);
+    std::vector<uint8_t> candidate(len);
+    std::vector<uint8_t> filtered((len + 1) * (row_end - row_begin));
+
+    // the filters of the first row need the last row of the previous band
+    if (row_begin > 0)
+        this->colorize_row(row_begin - 1, prev.data());
+    for (unsigned int iy = row_begin; iy < row_end; iy++) {
+        this->colorize_row(iy, row.data());
+        filter_row(row.data(), prev.data(), len, candidate,
+                   filtered.data() + (iy - row_begin) * (len + 1));
+        std::swap(row, prev);
+    }
+
+    Band band;
+    band.raw_size = filtered.size();
+    band.adler = adler32(adler32(0, Z_NULL, 0), filtered.data(),
+                         static_cast<uInt>(filtered.size()));
+
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    // raw deflate, the zlib header and trailer are written by write_buffer
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("Could not initialize zlib");
+    band.deflated.resize(deflateBound(&strm, filtered.size()) + 16);
+    strm.next_in = filtered.data();
+    strm.avail_in = static_cast<uInt>(filtered.size());
+    strm.next_out = band.deflated.data();
+    strm.avail_out = static_cast<uInt>(band.deflated.size());
+    // a full flush ends the band on a byte boundary without the final block
+    // flag, so the next band can continue the stream
+    int flush = last ? Z_FINISH : Z_FULL_FLUSH;
+    int ret = Z_OK;
+    for (;;) {
+        ret = deflate(&strm, flush);
+        if (ret == Z_STREAM_ERROR ||
+            (last ? ret == Z_STREAM_END : strm.avail_out != 0))
+            break;
+        size_t used = band.deflated.size();
+        band.deflated.resize(used * 2);
+        strm.next_out = band.deflated.data() + used;
+        strm.avail_out = static_cast<uInt>(used);
+    }
+    band.deflated.resize(strm.total_out);
+    deflateEnd(&strm);
+    if (ret == Z_STREAM_ERROR)
+        throw std::runtime_error("Could not compress image data");
+    return band;
+}
+
+void ImagePNG::colorize_row(unsigned int iy, uint8_t *out)
+{
+    if (this->shared_rgb != nullptr && !this->shared_rgb->empty()) {
+        size_t row_bytes = static_cast<size_t>(this->params->xrange) * 3;
+        std::memcpy(out, this->shared_rgb->data() + iy * row_bytes, row_bytes);
+        return;
+    }
+    const auto &v = this->buff[iy];
+    for (unsigned int ix = 0; ix < v.size(); ix++) {
+        auto rgb = this->pixel_rgb(ix, iy, v[ix]);
+        *out++ = static_cast<uint8_t>(std::get<0>(rgb));
+        *out++ = static_cast<uint8_t>(std::get<1>(rgb));
+        *out++ = static_cast<uint8_t>(std::get<2>(rgb));
+    }
+}
@@ -0,0 +1,82 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGE_PNG_H
+#define IMAGE_PNG_H
+
+#include <cstdint>
+#include <vector>
+
+#include "imagewriter.h"
+
+/**
+ * @brief Native PNG writer based on zlib
+ *
+ * @details
+ * The image is split into bands of rows. Every band is colorized, filtered and
+ * deflated on its own thread. Bands are compressed as raw deflate streams that
+ * end with a full flush, so they can simply be concatenated into one zlib
+ * stream (the approach of pigz). The adler32 checksums of the bands are
+ * combined for the stream trailer.
+ */
+class ImagePNG : public Imagewriter
+{
+public:
+    ImagePNG(const constants::fracbuff &buff,
+             const std::shared_ptr<FractalParameters> &params,
+             const std::shared_ptr<Printer> &prnt,
+             std::tuple<int, int, int> rgb_base,
+             std::tuple<int, int, int> rgb_set_base,
+             std::tuple<double, double, double> rgb_freq,
+             std::tuple<int, int, int> rgb_phase,
+             std::tuple<double, double, double> rgb_amp);
+    virtual ~ImagePNG();
+
+    void write_buffer();
+
+private:
+    /* data */
+    std::tuple<int, int, int> rgb_base;
+    std::tuple<int, int, int> rgb_set_base;
+    std::tuple<double, double, double> rgb_freq;
+    std::tuple<int, int, int> rgb_phase;
+    std::tuple<double, double, double> rgb_amp;
+
+    struct Band {
+        std::vector<uint8_t> deflated;
+        unsigned long adler;
+        size_t raw_size;
+    };
+
+    std::tuple<int, int, int> iterations_rgb(
+        const constants::Iterations &data);
+
+    /**
+     * @brief Colorize, filter and deflate a band of rows
+     *
+     * @param row_begin First row of the band
+     * @param row_end Row after the last row of the band
+     * @param last Whether this band ends the zlib stream
+     *
+     * @return Compressed band
+     */
+    Band encode_band(unsigned int row_begin, unsigned int row_end, bool last);
+    void colorize_row(unsigned int iy, uint8_t *out);
+};
+
+#endif /* ifndef IMAGE_PNG_H */
@@ -37,7 +37,7 @@ void ImagePNM::write_buffer()
             this->params->ycoord, this->params->xl, this->params->xh,
             this->params->yl, this->params->yh) +
         "." + constants::BITMAP_DEFS.at(this->format).at(0);
-    std::cout << "+ \u2937 " + filename << std::endl;
+    this->prnt << "+ \u2937 " + filename << std::endl;
 
     std::ofstream img(filename, std::ofstream::out);
     img.exceptions(std::ofstream::failbit | std::ofstream::badbit);
@@ -53,9 +53,10 @@ void ImagePNM::write_buffer()
             if (this->format == constants::OUT_FORMAT::IMAGE_PNM_GREY ||
                 this->format == constants::OUT_FORMAT::IMAGE_PNM_COL)
                 img << 255 << std::endl;
-            for (const auto &v : this->buff) {
+            for (unsigned int iy = 0; iy < this->buff.size(); iy++) {
+                const auto &v = this->buff[iy];
                 int linepos = 1;
-                for (const auto &data : v) {
+                for (unsigned int ix = 0; ix < v.size(); ix++) {
                     std::stringstream img_buf;
                     // this kind of images don't allow for more than 70
                     // characters in one row
@@ -65,7 +66,8 @@ void ImagePNM::write_buffer()
                         linepos = 0;
                     }
                     // write data to image file stream
-                    this->out_format_write(img_buf, data);
+                    this->out_format_write(img_buf,
+                                           this->pixel_rgb(ix, iy, v[ix]));
                     img << img_buf.rdbuf();
                     linepos++;
                 }
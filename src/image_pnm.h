@@ -37,7 +37,7 @@ public:
 
 protected:
     virtual void out_format_write(std::stringstream &img_buf,
-                                  const constants::Iterations &data) = 0;
+                                  const std::tuple<int, int, int> &rgb) = 0;
 
 private:
     /* data */
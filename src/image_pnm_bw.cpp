@@ -26,10 +26,33 @@ ImageBW::ImageBW(const constants::fracbuff &buff,
 }
 
 ImageBW::~ImageBW() {}
-void ImageBW::out_format_write(std::stringstream &img_buf,
-                               const constants::Iterations &data)
+std::tuple<int, int, int> ImageBW::iterations_rgb(
+    const constants::Iterations &data)
 {
     if (data.default_index == this->params->bailout) {
+        return std::make_tuple(0, 0, 0);
+    }
+    // neighbouring basins of Newton fractals alternate between black and white
+    if (this->params->set_type == constants::FRACTAL::NEWTON) {
+        if (data.basin % 2 == 1)
+            return std::make_tuple(0, 0, 0);
+        return std::make_tuple(255, 255, 255);
+    }
+    // filaments thinner than a pixel are drawn if the distance estimate
+    // puts the set within half a pixel
+    if (this->params->col_algo == constants::COL_ALGO::DISTANCE &&
+        data.distance < std::fabs(this->params->xdelta) / 2) {
+        return std::make_tuple(0, 0, 0);
+    }
+    return std::make_tuple(255, 255, 255);
+}
+
+void ImageBW::out_format_write(std::stringstream &img_buf,
+                               const std::tuple<int, int, int> &rgb)
+{
+    // supersampled pixels may be grey, a pixel is black if it is mostly
+    // inside the set
+    if (std::get<0>(rgb) < 128) {
         img_buf << 1 << " ";
     } else {
         img_buf << 0 << " ";
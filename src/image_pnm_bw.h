@@ -33,8 +33,10 @@ public:
 private:
     /* data */
 
+    std::tuple<int, int, int> iterations_rgb(
+        const constants::Iterations &data);
     void out_format_write(std::stringstream &img_buf,
-                          const constants::Iterations &data);
+                          const std::tuple<int, int, int> &rgb);
 };
 
 #endif /* ifndef IMAGEBW_H */
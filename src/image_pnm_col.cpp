@@ -36,32 +36,16 @@ Imagecol::Imagecol(const constants::fracbuff &buff,
 }
 
 Imagecol::~Imagecol() {}
-void Imagecol::out_format_write(std::stringstream &img_buf,
-                                const constants::Iterations &data)
+std::tuple<int, int, int> Imagecol::iterations_rgb(
+    const constants::Iterations &data)
 {
-    unsigned int its = data.default_index;
-    double continous_index = data.continous_index;
-    if (its == this->params->bailout) {
-        img_buf << std::get<0>(this->rgb_set_base) << " "
-                << std::get<1>(this->rgb_set_base) << " "
-                << std::get<2>(this->rgb_set_base) << "\t";
-        return;
-    }
-
-    auto rgb = std::make_tuple(0, 0, 0);
-
-    if (this->params->col_algo == constants::COL_ALGO::ESCAPE_TIME) {
-        rgb = this->rgb_linear(its, this->rgb_base, this->rgb_freq);
-    }
-    if (this->params->col_algo == constants::COL_ALGO::CONTINUOUS_SINE) {
-        rgb = this->rgb_continuous_sine(continous_index, this->rgb_base,
-                                        this->rgb_freq, this->rgb_phase);
-    }
-    if (this->params->col_algo == constants::COL_ALGO::CONTINUOUS_BERN) {
-        rgb = this->rgb_continuous_bernstein(its, this->params->bailout,
-                                             this->rgb_base, this->rgb_amp);
-    }
+    return this->rgb_palette(data, this->rgb_base, this->rgb_set_base,
+                             this->rgb_freq, this->rgb_phase, this->rgb_amp);
+}
 
+void Imagecol::out_format_write(std::stringstream &img_buf,
+                                const std::tuple<int, int, int> &rgb)
+{
     img_buf << std::get<0>(rgb) << " " << std::get<1>(rgb) << " "
             << std::get<2>(rgb) << "\t";
 }
@@ -45,8 +45,10 @@ private:
     std::tuple<int, int, int> rgb_phase;
     std::tuple<double, double, double> rgb_amp;
 
+    std::tuple<int, int, int> iterations_rgb(
+        const constants::Iterations &data);
     void out_format_write(std::stringstream &img_buf,
-                          const constants::Iterations &data);
+                          const std::tuple<int, int, int> &rgb);
 };
 
 #endif /* ifndef IMAGECOL_H */
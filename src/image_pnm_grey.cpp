@@ -32,16 +32,23 @@ Imagegrey::Imagegrey(const constants::fracbuff &buff,
 }
 
 Imagegrey::~Imagegrey() {}
-void Imagegrey::out_format_write(std::stringstream &img_buf,
-                                 const constants::Iterations &data)
+std::tuple<int, int, int> Imagegrey::iterations_rgb(
+    const constants::Iterations &data)
 {
     unsigned int its = data.default_index;
     if (its == this->params->bailout) {
-        img_buf << 0 << " ";
-        return;
+        return std::make_tuple(0, 0, 0);
     }
 
     std::tuple<int, int, int> rgb{0, 0, 0};
+    if (this->params->set_type == constants::FRACTAL::NEWTON) {
+        // luminance of the basin color, so the basins stay distinguishable
+        auto col = this->rgb_newton(its, data.basin);
+        int l = static_cast<int>(std::round(0.2126 * std::get<0>(col) +
+                                            0.7152 * std::get<1>(col) +
+                                            0.0722 * std::get<2>(col)));
+        return std::make_tuple(l, l, l);
+    }
     if (this->params->col_algo == constants::COL_ALGO::ESCAPE_TIME) {
         rgb = this->rgb_linear(its, this->rgb_base, this->rgb_freq);
     }
@@ -50,6 +57,18 @@ void Imagegrey::out_format_write(std::stringstream &img_buf,
         rgb = this->rgb_continuous_sine(continuous_index, this->rgb_base,
                                         this->rgb_freq, this->rgb_phase);
     }
+    if (this->params->col_algo == constants::COL_ALGO::DISTANCE) {
+        rgb = this->rgb_distance(its, data.distance, this->rgb_base,
+                                 this->rgb_freq, std::make_tuple(0, 0, 0));
+    }
+    // grey scale only uses the red channel
+    std::get<1>(rgb) = std::get<0>(rgb);
+    std::get<2>(rgb) = std::get<0>(rgb);
+    return rgb;
+}
 
+void Imagegrey::out_format_write(std::stringstream &img_buf,
+                                 const std::tuple<int, int, int> &rgb)
+{
     img_buf << std::get<0>(rgb) << " ";
 }
@@ -39,8 +39,10 @@ private:
     std::tuple<double, double, double> rgb_freq;
     std::tuple<int, int, int> rgb_phase;
 
+    std::tuple<int, int, int> iterations_rgb(
+        const constants::Iterations &data);
     void out_format_write(std::stringstream &img_buf,
-                          const constants::Iterations &data);
+                          const std::tuple<int, int, int> &rgb);
 };
 
 #endif /* ifndef IMAGEGREY_H */
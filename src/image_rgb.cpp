@@ -0,0 +1,52 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "image_rgb.h"
+
+ImageRGB::ImageRGB(const constants::fracbuff &buff,
+                   const std::shared_ptr<FractalParameters> &params,
+                   const std::shared_ptr<Printer> &prnt,
+                   std::tuple<int, int, int> rgb_base,
+                   std::tuple<int, int, int> rgb_set_base,
+                   std::tuple<double, double, double> rgb_freq,
+                   std::tuple<int, int, int> rgb_phase,
+                   std::tuple<double, double, double> rgb_amp)
+    : Imagewriter(buff, params, prnt),
+      rgb_base(std::move(rgb_base)),
+      rgb_set_base(std::move(rgb_set_base)),
+      rgb_freq(std::move(rgb_freq)),
+      rgb_phase(std::move(rgb_phase)),
+      rgb_amp(std::move(rgb_amp))
+{
+}
+
+ImageRGB::~ImageRGB() {}
+void ImageRGB::write_buffer()
+{
+    this->rgb_buf.resize(static_cast<size_t>(this->params->xrange) *
+                         this->params->yrange * 3);
+    this->colorize(this->rgb_buf.data(), 3);
+}
+
+constants::rgbbuff &ImageRGB::get_rgb_buffer() { return this->rgb_buf; }
+std::tuple<int, int, int> ImageRGB::iterations_rgb(
+    const constants::Iterations &data)
+{
+    return this->rgb_palette(data, this->rgb_base, this->rgb_set_base,
+                             this->rgb_freq, this->rgb_phase, this->rgb_amp);
+}
@@ -0,0 +1,70 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGE_RGB_H
+#define IMAGE_RGB_H
+
+#include <vector>
+#include <cstdint>
+
+#include "imagewriter.h"
+
+/**
+ * @brief Image writer that colorizes the buffer into memory
+ *
+ * @details
+ * The result is a packed RGB buffer, 3 bytes per pixel in row major order.
+ * This is used by the library API where no file should be written.
+ */
+class ImageRGB : public Imagewriter
+{
+public:
+    ImageRGB(const constants::fracbuff &buff,
+             const std::shared_ptr<FractalParameters> &params,
+             const std::shared_ptr<Printer> &prnt,
+             std::tuple<int, int, int> rgb_base,
+             std::tuple<int, int, int> rgb_set_base,
+             std::tuple<double, double, double> rgb_freq,
+             std::tuple<int, int, int> rgb_phase,
+             std::tuple<double, double, double> rgb_amp);
+    virtual ~ImageRGB();
+
+    void write_buffer();
+
+    /**
+     * @brief Get the colorized image
+     *
+     * @return Packed RGB buffer, empty until write_buffer was called
+     */
+    constants::rgbbuff &get_rgb_buffer();
+
+private:
+    /* data */
+    std::tuple<int, int, int> rgb_base;
+    std::tuple<int, int, int> rgb_set_base;
+    std::tuple<double, double, double> rgb_freq;
+    std::tuple<int, int, int> rgb_phase;
+    std::tuple<double, double, double> rgb_amp;
+
+    constants::rgbbuff rgb_buf;
+
+    std::tuple<int, int, int> iterations_rgb(
+        const constants::Iterations &data);
+};
+
+#endif /* ifndef IMAGE_RGB_H */
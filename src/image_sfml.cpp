@@ -18,6 +18,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "image_sfml.h"
 
+#include <future>
+
 ImageSFML::ImageSFML(const constants::fracbuff &buff,
                      const std::shared_ptr<FractalParameters> &params,
                      const std::shared_ptr<Printer> &prnt,
@@ -39,43 +41,12 @@ ImageSFML::ImageSFML(const constants::fracbuff &buff,
 ImageSFML::~ImageSFML() {}
 void ImageSFML::write_buffer()
 {
-    std::vector<uint8_t> sfml_img_buf;
-    // reserve memory this will make push_back less costly
-    sfml_img_buf.reserve(this->params->xrange * this->params->yrange);
-    // SFML needs a data structure with 4 uint8_t per RGBA pixel
-    for (const auto &v : this->buff) {
-        for (const auto &it : v) {
-            // TODO: This code is quite similar to the one used in the ppm class
-            unsigned int its = it.default_index;
-            double continous_index = it.continous_index;
-            if (its == this->params->bailout) {
-                sfml_img_buf.push_back(std::get<0>(this->rgb_set_base));
-                sfml_img_buf.push_back(std::get<1>(this->rgb_set_base));
-                sfml_img_buf.push_back(std::get<2>(this->rgb_set_base));
-                sfml_img_buf.push_back(255);
-                continue;
-            }
-
-            auto rgb = std::make_tuple(0, 0, 0);
-
-            if (this->params->col_algo == constants::COL_ALGO::ESCAPE_TIME) {
-                rgb = this->rgb_linear(its, this->rgb_base, this->rgb_freq);
-            }
-            if (this->params->col_algo == constants::COL_ALGO::CONTINUOUS_SINE) {
-                rgb = this->rgb_continuous_sine(continous_index, this->rgb_base,
-                                                this->rgb_freq, this->rgb_phase);
-            }
-            if (this->params->col_algo == constants::COL_ALGO::CONTINUOUS_BERN) {
-                rgb = this->rgb_continuous_bernstein(
-                    its, this->params->bailout, this->rgb_base, this->rgb_amp);
-            }
-
-            sfml_img_buf.push_back(static_cast<uint8_t>(std::get<0>(rgb)));
-            sfml_img_buf.push_back(static_cast<uint8_t>(std::get<1>(rgb)));
-            sfml_img_buf.push_back(static_cast<uint8_t>(std::get<2>(rgb)));
-            sfml_img_buf.push_back(255);
-        }
-    }
+    // Let SFML allocate its RGBA pixel array once and colorize straight into
+    // it. Building a separate buffer and passing it to create() would copy
+    // the whole image again.
+    sf::Image img;
+    img.create(this->params->xrange, this->params->yrange);
+    this->colorize(const_cast<sf::Uint8 *>(img.getPixelsPtr()), 4);
 
     std::string filename = this->out_file_name(
         this->params->image_base, this->params->fractal_type,
@@ -84,16 +55,28 @@ void ImageSFML::write_buffer()
         this->params->ycoord, this->params->xl, this->params->xh,
         this->params->yl, this->params->yh);
 
-    sf::Image img;
-    img.create(this->params->xrange, this->params->yrange, sfml_img_buf.data());
+    // both encoders only read the pixels, jpg is written on its own thread
+    // while the png encoder runs here
+    std::future<bool> jpg;
     if ((outfmt & static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_JPG)) ==
         static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_JPG)) {
         this->prnt << "+ \u2937 " + filename + ".jpg" << std::endl;
-        img.saveToFile(filename + ".jpg");
+        jpg = std::async(std::launch::async, [&img, &filename]() {
+            return img.saveToFile(filename + ".jpg");
+        });
     }
     if ((outfmt & static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_PNG)) ==
         static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_PNG)) {
         this->prnt << "+ \u2937 " + filename + ".png" << std::endl;
         img.saveToFile(filename + ".png");
     }
+    if (jpg.valid())
+        jpg.get();
+}
+
+std::tuple<int, int, int> ImageSFML::iterations_rgb(
+    const constants::Iterations &data)
+{
+    return this->rgb_palette(data, this->rgb_base, this->rgb_set_base,
+                             this->rgb_freq, this->rgb_phase, this->rgb_amp);
 }
@@ -46,6 +46,9 @@ private:
     std::tuple<int, int, int> rgb_phase;
     std::tuple<double, double, double> rgb_amp;
     uint8_t outfmt;
+
+    std::tuple<int, int, int> iterations_rgb(
+        const constants::Iterations &data);
 };
 
 #endif /* ifndef IMAGE_SFML_H */
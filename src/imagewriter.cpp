@@ -18,14 +18,192 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "imagewriter.h"
 
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ctpl_stl.h"
+
 Imagewriter::Imagewriter(const constants::fracbuff &buff,
                          const std::shared_ptr<FractalParameters> &params,
                          const std::shared_ptr<Printer> &prnt)
-    : Buffwriter(buff), params(params), prnt(prnt)
+    : Buffwriter(buff),
+      params(params),
+      prnt(prnt),
+      shared_rgb(nullptr),
+      workerclock(nullptr),
+      numa(nullptr),
+      pool(nullptr)
 {
 }
 
 Imagewriter::~Imagewriter() {}
+void Imagewriter::set_shared_rgb(const constants::rgbbuff &rgb)
+{
+    this->shared_rgb = &rgb;
+}
+
+void Imagewriter::set_workerclock(Workerclock *clock)
+{
+    this->workerclock = clock;
+}
+
+void Imagewriter::set_numa(const Numatopology *topo) { this->numa = topo; }
+void Imagewriter::set_pool(ctpl::thread_pool *tpl) { this->pool = tpl; }
+
+std::tuple<int, int, int> Imagewriter::pixel_rgb(
+    unsigned int ix, unsigned int iy, const constants::Iterations &data)
+{
+    if (this->shared_rgb != nullptr && !this->shared_rgb->empty()) {
+        const uint8_t *px =
+            this->shared_rgb->data() +
+            (static_cast<size_t>(iy) * this->params->xrange + ix) * 3;
+        return std::make_tuple(static_cast<int>(px[0]),
+                               static_cast<int>(px[1]),
+                               static_cast<int>(px[2]));
+    }
+    if (this->samples == nullptr || this->samples->empty())
+        return this->iterations_rgb(data);
+
+    auto sample_it = this->samples->find(
+        static_cast<unsigned long>(iy) * this->params->xrange + ix);
+    if (sample_it == this->samples->end())
+        return this->iterations_rgb(data);
+
+    auto rgb = this->iterations_rgb(data);
+    double red = srgb_to_linear(std::get<0>(rgb));
+    double green = srgb_to_linear(std::get<1>(rgb));
+    double blue = srgb_to_linear(std::get<2>(rgb));
+    for (const auto &s : sample_it->second) {
+        rgb = this->iterations_rgb(s);
+        red += srgb_to_linear(std::get<0>(rgb));
+        green += srgb_to_linear(std::get<1>(rgb));
+        blue += srgb_to_linear(std::get<2>(rgb));
+    }
+    double n = static_cast<double>(sample_it->second.size() + 1);
+    return std::make_tuple(linear_to_srgb(red / n), linear_to_srgb(green / n),
+                           linear_to_srgb(blue / n));
+}
+
+void Imagewriter::colorize(uint8_t *out, unsigned int channels)
+{
+    unsigned int rows = static_cast<unsigned int>(this->buff.size());
+    if (rows == 0)
+        return;
+    size_t row_bytes = static_cast<size_t>(this->params->xrange) * channels;
+    auto colorize_rows = [this, out, channels, row_bytes](unsigned int begin,
+                                                           unsigned int end) {
+        for (unsigned int iy = begin; iy < end; iy++) {
+            uint8_t *px = out + iy * row_bytes;
+            const auto &v = this->buff[iy];
+            for (unsigned int ix = 0; ix < v.size(); ix++) {
+                auto rgb = this->pixel_rgb(ix, iy, v[ix]);
+                px[0] = static_cast<uint8_t>(std::get<0>(rgb));
+                px[1] = static_cast<uint8_t>(std::get<1>(rgb));
+                px[2] = static_cast<uint8_t>(std::get<2>(rgb));
+                if (channels == 4)
+                    px[3] = 255;
+                px += channels;
+            }
+        }
+    };
+
+    ctpl::thread_pool *tpl = this->numa == nullptr ? this->pool : nullptr;
+    bool on_worker = false;
+    if (tpl != nullptr) {
+        // pushing bands from a worker could wait for ourselves
+        for (int i = 0; i < tpl->size() && !on_worker; i++) {
+            on_worker =
+                tpl->get_thread(i).get_id() == std::this_thread::get_id();
+        }
+    }
+    unsigned int threads =
+        tpl != nullptr
+            ? static_cast<unsigned int>(tpl->size())
+            : (this->params->cores > 0
+                   ? this->params->cores
+                   : std::max(std::thread::hardware_concurrency(), 1u));
+    if (threads == 1 || rows < 2 || on_worker) {
+        auto begin = Workerclock::clock::now();
+        colorize_rows(0, rows);
+        if (this->workerclock != nullptr)
+            this->workerclock->add(0, begin);
+        return;
+    }
+    // a few bands per thread so supersampled regions do not stall one worker
+    unsigned int band_rows = std::max(1u, rows / (threads * 4));
+    std::unique_ptr<ctpl::thread_pool> own;
+    if (tpl == nullptr) {
+        own = std::unique_ptr<ctpl::thread_pool>(
+            new ctpl::thread_pool(static_cast<int>(threads)));
+        tpl = own.get();
+    }
+    if (this->numa != nullptr) {
+        // read the rows where they were computed and write the pixels there
+        this->numa->pin(*tpl);
+        Nodequeue queue(this->numa->nodes());
+        for (unsigned int row = 0; row < rows; row += band_rows)
+            queue.push(this->numa->row_node(row, rows), row);
+        this->numa->run(*tpl, queue, [this, &colorize_rows, rows, band_rows](
+                                        int id, size_t row) {
+            auto begin = Workerclock::clock::now();
+            colorize_rows(static_cast<unsigned int>(row),
+                          std::min(rows, static_cast<unsigned int>(row) +
+                                             band_rows));
+            if (this->workerclock != nullptr)
+                this->workerclock->add(id, begin);
+        });
+        return;
+    }
+    std::vector<std::future<void>> bands;
+    for (unsigned int row = 0; row < rows; row += band_rows) {
+        unsigned int row_end = std::min(rows, row + band_rows);
+        bands.push_back(tpl->push([this, &colorize_rows, row, row_end](int id) {
+            auto begin = Workerclock::clock::now();
+            colorize_rows(row, row_end);
+            if (this->workerclock != nullptr)
+                this->workerclock->add(id, begin);
+        }));
+    }
+    for (auto &f : bands)
+        f.get();
+}
+
+std::tuple<int, int, int> Imagewriter::rgb_palette(
+    const constants::Iterations &data,
+    const std::tuple<int, int, int> &rgb_base,
+    const std::tuple<int, int, int> &rgb_set_base,
+    const std::tuple<double, double, double> &rgb_freq,
+    const std::tuple<int, int, int> &rgb_phase,
+    const std::tuple<double, double, double> &rgb_amp)
+{
+    unsigned int its = data.default_index;
+    if (its == this->params->bailout) {
+        return rgb_set_base;
+    }
+    if (this->params->set_type == constants::FRACTAL::NEWTON)
+        return this->rgb_newton(its, data.basin);
+    auto rgb = std::make_tuple(0, 0, 0);
+    if (this->params->col_algo == constants::COL_ALGO::ESCAPE_TIME) {
+        rgb = this->rgb_linear(its, rgb_base, rgb_freq);
+    }
+    if (this->params->col_algo == constants::COL_ALGO::CONTINUOUS_SINE) {
+        rgb = this->rgb_continuous_sine(data.continous_index, rgb_base,
+                                        rgb_freq, rgb_phase);
+    }
+    if (this->params->col_algo == constants::COL_ALGO::CONTINUOUS_BERN) {
+        rgb = this->rgb_continuous_bernstein(its, this->params->bailout,
+                                             rgb_base, rgb_amp);
+    }
+    if (this->params->col_algo == constants::COL_ALGO::DISTANCE) {
+        rgb = this->rgb_distance(its, data.distance, rgb_base, rgb_freq,
+                                 rgb_set_base);
+    }
+    return rgb;
+}
+
 std::tuple<int, int, int> Imagewriter::rgb_linear(
     unsigned int its, const std::tuple<int, int, int> &rgb_base,
     const std::tuple<double, double, double> &rgb_freq)
@@ -146,3 +324,58 @@ std::tuple<int, int, int> Imagewriter::rgb_continuous_bernstein(
     //<< std::get<2>(rgb) << std::endl;
     return rgb;
 }
+
+std::tuple<int, int, int> Imagewriter::rgb_distance(
+    unsigned int its, double distance,
+    const std::tuple<int, int, int> &rgb_base,
+    const std::tuple<double, double, double> &rgb_freq,
+    const std::tuple<int, int, int> &rgb_set_base)
+{
+    double pixels = distance / std::fabs(this->params->xdelta);
+    // the square root keeps the fade short and the boundary sharp
+    double t = std::sqrt(std::min(std::max(pixels / 2.0, 0.0), 1.0));
+    auto rgb = this->rgb_linear(its, rgb_base, rgb_freq);
+    auto fade = [t](int c, int set) {
+        return static_cast<int>(std::round(set + (c - set) * t));
+    };
+    return std::make_tuple(
+        fade(std::get<0>(rgb), std::get<0>(rgb_set_base)),
+        fade(std::get<1>(rgb), std::get<1>(rgb_set_base)),
+        fade(std::get<2>(rgb), std::get<2>(rgb_set_base)));
+}
+
+std::tuple<int, int, int> Imagewriter::rgb_newton(unsigned int its,
+                                                  unsigned int basin)
+{
+    double hue = std::fmod(basin * 0.618033988749895, 1.0) * 6.0;
+    double value = 0.15 + 0.85 * std::pow(0.93, its);
+    const double saturation = 0.75;
+    // HSV to RGB, the hue sector decides which channel rises or falls
+    int sector = static_cast<int>(hue) % 6;
+    double f = hue - sector;
+    double p = value * (1 - saturation);
+    double q = value * (1 - saturation * f);
+    double t = value * (1 - saturation * (1 - f));
+    const double sectors[6][3] = {{value, t, p}, {q, value, p},
+                                  {p, value, t}, {p, q, value},
+                                  {t, p, value}, {value, p, q}};
+    const double *c = sectors[sector];
+    return std::make_tuple(static_cast<int>(std::round(c[0] * 255)),
+                           static_cast<int>(std::round(c[1] * 255)),
+                           static_cast<int>(std::round(c[2] * 255)));
+}
+
+double Imagewriter::srgb_to_linear(int c)
+{
+    double cs = std::min(std::max(c, 0), 255) / 255.0;
+    if (cs <= 0.04045)
+        return cs / 12.92;
+    return std::pow((cs + 0.055) / 1.055, 2.4);
+}
+
+int Imagewriter::linear_to_srgb(double c)
+{
+    double cs = c <= 0.0031308 ? c * 12.92
+                               : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+    return static_cast<int>(std::round(std::min(std::max(cs, 0.0), 1.0) * 255));
+}
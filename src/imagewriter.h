@@ -22,11 +22,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 #include <cmath>
 #include <tuple>
+#include <vector>
 
 #include "buffwriter.h"
+#include "ctpl_stl.h"
 #include "global.h"
 #include "fractalparams.h"
+#include "numa.h"
 #include "printer.h"
+#include "stats.h"
 
 class Imagewriter : public Buffwriter
 {
@@ -38,10 +42,114 @@ public:
 
     virtual void write_buffer() = 0;
 
+    /**
+     * @brief Use colors that were already computed for this buffer
+     *
+     * @param rgb Packed RGB pixels of the whole image, must outlive the writer
+     *
+     * @details
+     * Several writers that use the same palette can share one colorization
+     * pass this way. The buffer is only used if it is not empty, so it may be
+     * filled after this call.
+     */
+    void set_shared_rgb(const constants::rgbbuff &rgb);
+
+    /**
+     * @brief Record the busy time of the threads that colorize the buffer
+     *
+     * @param clock Clock with a slot for every colorizer thread or nullptr
+     */
+    void set_workerclock(Workerclock *clock);
+
+    /**
+     * @brief Colorize every row on the NUMA node that computed it
+     *
+     * @param topo Node topology or nullptr
+     */
+    void set_numa(const Numatopology *topo);
+
+    /**
+     * @brief Colorize on an existing thread pool
+     *
+     * @param tpl Thread pool of the caller or nullptr for a pool of our own
+     *
+     * @details
+     * Long running callers like the render server keep their pool warm this
+     * way. If write_buffer is called from a thread of tpl the buffer is
+     * colorized on that thread, the other workers are busy with their own
+     * jobs. NUMA placement always uses a pool of its own.
+     */
+    void set_pool(ctpl::thread_pool *tpl);
+
 protected:
     const std::shared_ptr<FractalParameters> &params;
     const std::shared_ptr<Printer> &prnt;
 
+    /**
+     * @brief Map the data of one sample on a RGB color
+     *
+     * @param data Iterations object of the sample
+     *
+     * @return RGB tuple
+     */
+    virtual std::tuple<int, int, int> iterations_rgb(
+        const constants::Iterations &data) = 0;
+
+    /**
+     * @brief Color of a pixel with respect to supersampling
+     *
+     * @param ix X coordinate of the pixel
+     * @param iy Y coordinate of the pixel
+     * @param data Iterations object of the first sample of this pixel
+     *
+     * @return RGB tuple
+     *
+     * @details
+     * If the pixel was refined by the supersampling pass every sample is
+     * colored separately and the colors are averaged in linear RGB space.
+     * Averaging the iteration count instead would produce colors that do not
+     * exist in the palette.
+     */
+    std::tuple<int, int, int> pixel_rgb(unsigned int ix, unsigned int iy,
+                                        const constants::Iterations &data);
+
+    /**
+     * @brief Colorize the whole buffer into packed 8 bit pixels
+     *
+     * @param out Destination with room for xrange * yrange * channels bytes
+     * @param channels 3 for RGB or 4 for RGBA, alpha is always opaque
+     *
+     * @details
+     * Rows are colorized in bands on a thread pool. Every band writes to its
+     * own slice of out so no synchronization is needed. See set_pool for the
+     * pool that is used.
+     */
+    void colorize(uint8_t *out, unsigned int channels);
+
+    /**
+     * @brief Map a sample on the RGB palette of the selected coloring
+     *
+     * @param data Iterations object of the sample
+     * @param rgb_base The RGB base color
+     * @param rgb_set_base Color of the set
+     * @param rgb_freq The RGB frequency
+     * @param rgb_phase For out of phase waves
+     * @param rgb_amp RGB peak to peak amplitude
+     *
+     * @return RGB tuple
+     *
+     * @details
+     * Dispatches on the fractal and the coloring algorithm, shared by all
+     * writers that produce RGB images.
+     */
+    std::tuple<int, int, int> rgb_palette(
+        const constants::Iterations &data,
+        const std::tuple<int, int, int> &rgb_base,
+        const std::tuple<int, int, int> &rgb_set_base,
+        const std::tuple<double, double, double> &rgb_freq,
+        const std::tuple<int, int, int> &rgb_phase,
+        const std::tuple<double, double, double> &rgb_amp);
+
     /**
      * @brief Map iteration count on RGB colors in a inear fashion
      *
@@ -97,8 +205,56 @@ protected:
         const std::tuple<int, int, int> &rgb_base,
         const std::tuple<double, double, double> &rgb_amp);
 
+    /**
+     * @brief Darken the escape time colors close to the boundary of the set
+     *
+     * @param its Escape time
+     * @param distance Estimated distance to the set
+     * @param rgb_base The RGB base color
+     * @param rgb_freq The RGB frequency
+     * @param rgb_set_base Color of the set and its boundary
+     *
+     * @return RGB tuple
+     *
+     * @details
+     * The distance is measured in pixels. Pixels closer than two pixels to
+     * the set fade into the set color. Thin filaments stay visible this way
+     * without supersampling.
+     */
+    std::tuple<int, int, int> rgb_distance(
+        unsigned int its, double distance,
+        const std::tuple<int, int, int> &rgb_base,
+        const std::tuple<double, double, double> &rgb_freq,
+        const std::tuple<int, int, int> &rgb_set_base);
+
+    /**
+     * @brief Color a pixel of a Newton fractal by its root basin
+     *
+     * @param its Iterations until the pixel converged
+     * @param basin Index of the root the pixel converged to
+     *
+     * @return RGB tuple
+     *
+     * @details
+     * Every basin gets its own hue, consecutive indices are a golden angle
+     * apart so any number of roots stays distinguishable. Pixels get darker
+     * the slower they converge, which outlines the basin boundaries.
+     */
+    std::tuple<int, int, int> rgb_newton(unsigned int its, unsigned int basin);
+
+    /**
+     * @brief Shared RGB buffer or nullptr
+     */
+    const constants::rgbbuff *shared_rgb;
+    Workerclock *workerclock;
+    const Numatopology *numa;
+    ctpl::thread_pool *pool;
+
 private:
     /* data */
+
+    static double srgb_to_linear(int c);
+    static int linear_to_srgb(double c);
 };
 
 #endif /* ifndef IMAGEWRITER_H */
@@ -25,25 +25,45 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <chrono>
 #include <fstream>
 #include <tuple>
+#include <thread>
+#include <algorithm>
 
 #include "printer.h"
 #include "global.h"
 #include "main_helper.h"
+#include "stats.h"
 #include "config.h"
+#include "geomandel.h"
 
 #include "image_pnm_bw.h"
 #include "image_pnm_grey.h"
 #include "image_pnm_col.h"
+#include "image_rgb.h"
 #ifdef HAVE_SFML
 #include "image_sfml.h"
 #endif
+#ifdef HAVE_ZLIB
+#include "image_png.h"
+#endif
 
+#include "costwriter.h"
 #include "csvwriter.h"
+#include "dumpreader.h"
+#include "dumpwriter.h"
 
 #include "fractalzoom.h"
 
 #include "fractalcrunchsingle.h"
 #include "fractalcrunchmulti.h"
+#include "fractalcrunchprogressive.h"
+#include "fractalcrunchboundary.h"
+#include "tilerenderer.h"
+#ifdef HAVE_RENDERSERVER
+#include "renderserver.h"
+#endif
+#ifdef HAVE_RENDERCACHE
+#include "rendercache.h"
+#endif
 
 #include "ctpl_stl.h"
 #include "cxxopts.hpp"
@@ -71,8 +91,350 @@ void prnt_buff(const constants::fracbuff &buff, unsigned int bailout)
     }
 }
 
+/**
+ * @brief Number of threads of the pools that do not use the engine
+ *
+ * @details
+ * Matches the pool size of the colorizer and the png encoder.
+ */
+unsigned int pool_threads(const FractalParameters &params)
+{
+    return params.cores > 0
+               ? params.cores
+               : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+/**
+ * @brief Sum of the iterations that were executed for all pixels or samples
+ *
+ * @details
+ * This is the cost of every sample, not its escape time. Pixels filled by
+ * boundary tracing cost nothing and the distance estimation adds its extra
+ * steps.
+ */
+unsigned long long count_iterations(const constants::fracbuff &buff,
+                                    const constants::samplebuff *samples)
+{
+    unsigned long long its = 0;
+    if (samples == nullptr) {
+        for (const auto &row : buff)
+            for (const auto &px : row)
+                its += px.cost;
+    } else {
+        for (const auto &s : *samples)
+            for (const auto &px : s.second)
+                its += px.cost;
+    }
+    return its;
+}
+
+/**
+ * @brief Print the statistics report requested with --stats
+ *
+ * @param parser
+ * @param stats
+ * @param prnt
+ *
+ * @details
+ * The json report is always written to stdout, even in quiet mode. Combine it
+ * with --quiet to get nothing but the report.
+ */
+void print_stats(const cxxopts::Options &parser, const Runstats &stats,
+                 const std::shared_ptr<Printer> &prnt)
+{
+    if (!parser.count("stats"))
+        return;
+    if (parser["stats"].as<std::string>() == "json") {
+        std::cout << stats.json() << std::endl;
+    } else {
+        prnt << "+ Statistics" << std::endl;
+        prnt << stats.text();
+    }
+}
+
+/**
+ * @brief Image writers requested on the command line
+ *
+ * @details
+ * If more than one writer uses the RGB palette the colors are computed once
+ * by palette and shared with all of them.
+ */
+struct Imageoutputs {
+    std::vector<std::pair<std::string, std::unique_ptr<Buffwriter>>> writers;
+    std::unique_ptr<ImageRGB> palette;
+    std::shared_ptr<FractalParameters> params;
+
+    bool empty() const { return this->writers.empty(); }
+    void set_samples(const constants::samplebuff &samples)
+    {
+        if (this->palette)
+            this->palette->set_samples(samples);
+        for (auto &img : this->writers)
+            img.second->set_samples(samples);
+    }
+    void set_numa(const Numatopology *topo)
+    {
+        if (this->palette)
+            this->palette->set_numa(topo);
+        for (auto &img : this->writers) {
+            Imagewriter *writer = dynamic_cast<Imagewriter *>(img.second.get());
+            if (writer != nullptr)
+                writer->set_numa(topo);
+        }
+    }
+};
+
+/**
+ * @brief Create all image writers requested on the command line
+ *
+ * @param parser
+ * @param buff
+ * @param params
+ * @param prnt
+ *
+ * @return Image writers together with the message that is printed when the
+ * writer is used
+ */
+Imageoutputs create_image_writers(
+    const cxxopts::Options &parser, const constants::fracbuff &buff,
+    const std::shared_ptr<FractalParameters> &params,
+    const std::shared_ptr<Printer> &prnt)
+{
+    Imageoutputs images;
+    images.params = params;
+    if (parser.count("image-pnm-bw")) {
+        images.writers.emplace_back(
+            "+ Generating B/W image",
+            std::unique_ptr<ImageBW>(new ImageBW(buff, params, prnt)));
+    }
+    if (parser.count("image-pnm-grey")) {
+        unsigned int grey_base = parser["grey-base"].as<unsigned int>();
+        // do we need to use std::fabs for the parsed double here?
+        double grey_freq = parser["grey-freq"].as<double>();
+        images.writers.emplace_back(
+            "+ Generating grey scale bitmap",
+            std::unique_ptr<Imagegrey>(new Imagegrey(
+                buff, params, prnt, std::make_tuple(grey_base, 0, 0),
+                std::make_tuple(grey_freq, 0, 0))));
+    }
+
+    std::tuple<int, int, int> rgb_base;
+    std::tuple<int, int, int> rgb_set_base;
+    std::tuple<double, double, double> rgb_freq;
+    std::tuple<int, int, int> rgb_phase;
+    std::tuple<double, double, double> rgb_amp;
+    if (parser.count("image-pnm-col") || parser.count("image-png") ||
+        parser.count("image-jpg"))
+        parse_rgb_command_options(parser, rgb_base, rgb_set_base, rgb_freq,
+                                  rgb_phase, rgb_amp);
+    // writers that use the rgb palette
+    std::vector<Imagewriter *> rgb_writers;
+
+    if (parser.count("image-pnm-col")) {
+        Imagecol *col =
+            new Imagecol(buff, params, prnt, rgb_base, rgb_set_base, rgb_freq,
+                         rgb_phase, rgb_amp);
+        rgb_writers.push_back(col);
+        images.writers.emplace_back("+ Generating RGB bitmap",
+                                    std::unique_ptr<Imagecol>(col));
+    }
+    uint8_t png_jpg = 0;
+#ifdef HAVE_ZLIB
+    // the native png writer is preferred, SFML is only needed for jpg then
+    if (parser.count("image-png")) {
+        ImagePNG *png =
+            new ImagePNG(buff, params, prnt, rgb_base, rgb_set_base, rgb_freq,
+                         rgb_phase, rgb_amp);
+        rgb_writers.push_back(png);
+        images.writers.emplace_back("+ Generating png image",
+                                    std::unique_ptr<ImagePNG>(png));
+    }
+#else
+    if (parser.count("image-png"))
+        png_jpg |= static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_PNG);
+#endif
+
+    if (parser.count("image-jpg"))
+        png_jpg |= static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_JPG);
+    if (png_jpg != 0) {
+// TODO: Don't like ifdefs in code. Maybe better off with an "empty"
+// ImageSFML stub class
+#ifdef HAVE_SFML
+        ImageSFML *sfml =
+            new ImageSFML(buff, params, prnt, rgb_base, rgb_set_base, rgb_freq,
+                          rgb_phase, rgb_amp, png_jpg);
+        rgb_writers.push_back(sfml);
+        images.writers.emplace_back("+ Generating jpg/png image",
+                                    std::unique_ptr<ImageSFML>(sfml));
+#endif
+    }
+
+    if (rgb_writers.size() > 1) {
+        images.palette = std::unique_ptr<ImageRGB>(
+            new ImageRGB(buff, params, prnt, rgb_base, rgb_set_base, rgb_freq,
+                         rgb_phase, rgb_amp));
+        for (Imagewriter *w : rgb_writers)
+            w->set_shared_rgb(images.palette->get_rgb_buffer());
+    }
+    return images;
+}
+
+/**
+ * @brief Write all images
+ *
+ * @param images
+ * @param prnt
+ * @param announce Print the message of every writer
+ * @param stats Optional statistics that receive a colorize and an encode
+ * phase
+ *
+ * @details
+ * The shared palette is computed first, after that the encoders only read
+ * the buffers and run concurrently.
+ */
+void write_images(Imageoutputs &images, const std::shared_ptr<Printer> &prnt,
+                  bool announce = true, Runstats *stats = nullptr)
+{
+    if (images.empty())
+        return;
+    const auto &params = images.params;
+    unsigned long long pixels =
+        static_cast<unsigned long long>(params->xrange) * params->yrange;
+    if (images.palette) {
+        Workerclock clock(pool_threads(*params));
+        images.palette->set_workerclock(&clock);
+        if (stats)
+            stats->begin("colorize");
+        images.palette->write_buffer();
+        if (stats) {
+            Runstats::Phase &phase = stats->end();
+            phase.pixels = pixels;
+            phase.busy = clock.busy();
+        }
+        images.palette->set_workerclock(nullptr);
+    }
+
+    // every writer gets its own thread, the encoders stream to their files so
+    // writing the file is part of the encode phase
+    Workerclock clock(static_cast<unsigned int>(images.writers.size()));
+    if (stats)
+        stats->begin("encode");
+    if (images.writers.size() == 1) {
+        if (announce)
+            prnt << images.writers.front().first << std::endl;
+        auto begin = Workerclock::clock::now();
+        images.writers.front().second->write_buffer();
+        clock.add(0, begin);
+    } else {
+        ctpl::thread_pool tpl(static_cast<int>(images.writers.size()));
+        std::vector<std::future<void>> futures;
+        for (auto &img : images.writers) {
+            if (announce)
+                prnt << img.first << std::endl;
+            Buffwriter *writer = img.second.get();
+            futures.push_back(tpl.push([writer, &clock](int id) {
+                auto begin = Workerclock::clock::now();
+                writer->write_buffer();
+                clock.add(id, begin);
+            }));
+        }
+        for (auto &f : futures) {
+            f.get();
+        }
+    }
+    if (stats) {
+        Runstats::Phase &phase = stats->end();
+        phase.pixels = pixels * images.writers.size();
+        phase.busy = clock.busy();
+    }
+}
+
+/**
+ * @brief Color a binary dump with the image options of the command line
+ *
+ * @param parser
+ * @param cli_params Parameters parsed from the command line
+ * @param prnt
+ *
+ * @return Exit code
+ *
+ * @details
+ * The fractal is not computed again, only the image writers run. They only
+ * read the buffer so every writer gets its own thread.
+ */
+int recolor_dump(const cxxopts::Options &parser,
+                 const std::shared_ptr<FractalParameters> &cli_params,
+                 const std::shared_ptr<Printer> &prnt, Runstats &stats)
+{
+    std::string dumpfile = parser["from-dump"].as<std::string>();
+    if (parser.count("cost")) {
+        std::cerr << "Dumps do not contain the iteration cost, --cost can not "
+                     "be used with --from-dump"
+                  << std::endl;
+        return 1;
+    }
+    std::chrono::time_point<std::chrono::system_clock> tbegin =
+        std::chrono::system_clock::now();
+
+    constants::fracbuff buff;
+    constants::samplebuff samples;
+    std::shared_ptr<FractalParameters> params;
+    stats.begin("load");
+    try {
+        Dumpreader reader(dumpfile);
+        params = reader.parameters(cli_params->image_base);
+        reader.to_buffer(buff, samples);
+        stats.end().pixels =
+            static_cast<unsigned long long>(params->xrange) * params->yrange;
+    } catch (const std::exception &ex) {
+        std::cerr << "Could not load dump " << dumpfile << std::endl;
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    if (parser.count("col-algo")) {
+        if (cli_params->col_algo == constants::COL_ALGO::CONTINUOUS_SINE &&
+            params->col_algo != constants::COL_ALGO::CONTINUOUS_SINE) {
+            std::cerr << "The dump does not contain the continuous index "
+                         "needed for col-algo 1"
+                      << std::endl;
+            return 1;
+        }
+        params->col_algo = cli_params->col_algo;
+    }
+    if (params->col_algo == constants::COL_ALGO::DISTANCE) {
+        std::cerr << "Dumps do not contain the distance estimate needed for "
+                     "col-algo 3, choose another one with --col-algo"
+                  << std::endl;
+        return 1;
+    }
+    if (params->set_type == constants::FRACTAL::NEWTON) {
+        std::cerr << "Dumps do not contain the root basins of Newton fractals"
+                  << std::endl;
+        return 1;
+    }
+
+    auto images = create_image_writers(parser, buff, params, prnt);
+    if (images.empty()) {
+        std::cerr << "Recoloring a dump needs at least one image output"
+                  << std::endl;
+        return 1;
+    }
+
+    prnt << "+ Recoloring " << dumpfile << " (" << params->xrange << "x"
+         << params->yrange << ")" << std::endl;
+    images.set_samples(samples);
+    write_images(images, prnt, true, &stats);
+
+    auto deltat = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now() - tbegin);
+    prnt << "+ Recoloring time " << deltat.count() << "ms" << std::endl;
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+    Runstats stats;
+    stats.begin("parse");
     cxxopts::Options parser("geomandel", " - command line options");
     configure_command_line_parser(parser);
     try {
@@ -103,12 +465,82 @@ int main(int argc, char *argv[])
         std::cerr << "Could not parse command line arguments" << std::endl;
         return 1;
     }
-
-    std::string version =
-        std::string(GEOMANDEL_MAJOR) + "." + std::string(GEOMANDEL_MINOR);
-    if (std::string(GEOMANDEL_PATCH) != "0") {
-        version += "." + std::string(GEOMANDEL_PATCH);
+    if ((params->set_type == constants::FRACTAL::FORMULA ||
+         params->set_type == constants::FRACTAL::NEWTON) &&
+        params->col_algo == constants::COL_ALGO::DISTANCE) {
+        std::cerr << "Distance estimation is not available for formulas and "
+                     "Newton fractals"
+                  << std::endl;
+        return 1;
+    }
+    if (params->boundary > 0 &&
+        (params->progressive > 0 || parser.count("trace") ||
+         parser.count("cost-schedule") || parser.count("numa") ||
+         parser.count("serve") || parser.count("tiles"))) {
+        std::cerr << "Boundary tracing can not be combined with --progressive, "
+                     "--trace, --cost-schedule, --numa, --serve or --tiles"
+                  << std::endl;
+        return 1;
+    }
+    if (params->boundary > 0 &&
+        !Fractalcrunchboundary::supports(params->col_algo)) {
+        std::cerr << "Boundary tracing needs a coloring algorithm that only "
+                     "uses the escape time (col-algo 0 or 2)"
+                  << std::endl;
+        return 1;
+    }
+    if (parser.count("trace") &&
+        (!parser.count("m") || params->progressive > 0)) {
+        std::cerr << "A job trace can only be recorded by the multicore engine "
+                     "(-m without --progressive)"
+                  << std::endl;
+        return 1;
     }
+    if (parser.count("cost-schedule") &&
+        (!parser.count("m") || params->progressive > 0 ||
+         parser["cost-schedule"].as<unsigned int>() == 0)) {
+        std::cerr << "Cost scheduling needs the multicore engine (-m without "
+                     "--progressive) and a pre-pass divisor greater than 0"
+                  << std::endl;
+        return 1;
+    }
+    if (parser.count("numa") &&
+        (!parser.count("m") || params->progressive > 0)) {
+        std::cerr << "NUMA placement needs the multicore engine (-m without "
+                     "--progressive)"
+                  << std::endl;
+        return 1;
+    }
+    if (parser.count("arena")) {
+        std::string pages = parser["arena"].as<std::string>();
+        if (pages != "normal" && pages != "thp" && pages != "huge") {
+            std::cerr << "Arena pages must be normal, thp or huge" << std::endl;
+            return 1;
+        }
+        // reused blocks keep the node of their first touch
+        if (parser.count("numa")) {
+            std::cerr << "--arena can not be combined with --numa" << std::endl;
+            return 1;
+        }
+        // released blocks are kept until exit, with requests of arbitrary
+        // sizes a long running server would never give memory back
+        if (parser.count("serve")) {
+            std::cerr << "--arena can not be combined with --serve" << std::endl;
+            return 1;
+        }
+        Bufferarena::instance().enable(
+            pages == "normal" ? Bufferarena::NORMAL
+                              : (pages == "thp" ? Bufferarena::TRANSPARENT
+                                                : Bufferarena::EXPLICIT));
+    }
+    if (parser.count("stats") && parser["stats"].as<std::string>() != "text" &&
+        parser["stats"].as<std::string>() != "json") {
+        std::cerr << "Statistics format must be text or json" << std::endl;
+        return 1;
+    }
+    stats.end();
+
+    std::string version = geomandel::version();
 
     std::string frac_type = "Mandelbrot";
 
@@ -121,6 +553,123 @@ int main(int argc, char *argv[])
     if (params->set_type == constants::FRACTAL::BURNING_SHIP) {
         frac_type = "Burning Ship";
     }
+    if (params->set_type == constants::FRACTAL::FORMULA) {
+        frac_type = "Formula " + params->formula->source();
+    }
+    if (params->set_type == constants::FRACTAL::NEWTON) {
+        frac_type = "Newton " + params->newton->source();
+    }
+
+    if (parser.count("from-dump")) {
+        int ret = recolor_dump(parser, params, prnt, stats);
+        if (ret == 0)
+            print_stats(parser, stats, prnt);
+        return ret;
+    }
+
+#ifdef HAVE_RENDERCACHE
+    std::unique_ptr<Rendercache> cache;
+    if (parser.count("cache")) {
+        try {
+            cache = std::unique_ptr<Rendercache>(new Rendercache(
+                parser["cache"].as<std::string>(),
+                parser["cache-size"].as<unsigned long long>() * 1024 * 1024));
+        } catch (const std::exception &ex) {
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+    }
+#endif
+
+#ifdef HAVE_RENDERSERVER
+    if (parser.count("serve")) {
+        // command line values are the defaults for all requests
+        geomandel::ColorParameters colors;
+        parse_rgb_command_options(parser, colors.rgb_base, colors.rgb_set_base,
+                                  colors.rgb_freq, colors.rgb_phase,
+                                  colors.rgb_amp);
+        prnt << "+ geomandel " << version << " render server" << std::endl;
+        try {
+            Renderserver server(params, prnt, colors);
+            server.set_cache(cache.get());
+            server.set_tile_cache(
+                static_cast<size_t>(parser["tile-cache"].as<unsigned int>()) *
+                1024 * 1024);
+            server.run(parser["serve"].as<std::string>());
+        } catch (const std::exception &ex) {
+            std::cerr << "Render server error" << std::endl;
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+#endif
+
+    if (parser.count("tiles")) {
+        std::string levels = parser["tiles"].as<std::string>();
+        unsigned int zmin = 0;
+        unsigned int zmax = 0;
+        unsigned int tile_size = parser["tile-size"].as<unsigned int>();
+        try {
+            size_t sep = levels.find('-');
+            zmin = static_cast<unsigned int>(std::stoul(levels.substr(0, sep)));
+            zmax = sep == std::string::npos
+                       ? zmin
+                       : static_cast<unsigned int>(
+                             std::stoul(levels.substr(sep + 1)));
+        } catch (const std::exception &) {
+            std::cerr << "Could not parse tile levels " << levels << std::endl;
+            return 1;
+        }
+        if (zmax < zmin || zmax > 20 || tile_size == 0) {
+            std::cerr << "Tile levels must be in the range 0-20 and the tile "
+                         "size must not be 0"
+                      << std::endl;
+            return 1;
+        }
+        if (!parser.count("image-pnm-bw") && !parser.count("image-pnm-grey") &&
+            !parser.count("image-pnm-col") && !parser.count("image-png") &&
+            !parser.count("image-jpg")) {
+            std::cerr << "Tiles mode needs at least one image output"
+                      << std::endl;
+            return 1;
+        }
+
+        // writing every tile file name to stdout would be far too noisy
+        std::shared_ptr<Printer> tile_prnt = std::make_shared<Printer>(true);
+        Tilerenderer::writerfactory factory = [&parser, &tile_prnt](
+            const constants::fracbuff &buff,
+            const std::shared_ptr<FractalParameters> &tparams) {
+            std::vector<std::unique_ptr<Buffwriter>> writers;
+            auto images =
+                create_image_writers(parser, buff, tparams, tile_prnt);
+            // the writers run in order, so the palette has to come first
+            if (images.palette)
+                writers.push_back(std::move(images.palette));
+            for (auto &img : images.writers) {
+                writers.push_back(std::move(img.second));
+            }
+            return writers;
+        };
+
+        prnt << "+ Rendering " << frac_type << " tiles for levels " << zmin
+             << "-" << zmax << std::endl;
+        auto start = std::chrono::high_resolution_clock::now();
+        Tilerenderer tiler(params, prnt, factory);
+#ifdef HAVE_RENDERCACHE
+        tiler.set_cache(cache.get());
+#endif
+        unsigned long tiles =
+            tiler.render(zmin, zmax, tile_size, params->image_base);
+        auto end = std::chrono::high_resolution_clock::now();
+        prnt << "+ " << tiles << " tiles written to " << params->image_base
+             << " in "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(end -
+                                                                      start)
+                    .count()
+             << " ms" << std::endl;
+        return 0;
+    }
 
     // FIXME: real and Imaginary part only seem to have a precision of 5 digits
     // whereas the Zoom level is printed in scientific notation correctly. 
@@ -140,113 +689,206 @@ int main(int argc, char *argv[])
          << std::endl;
     prnt << "+   Level " << params->zoom << "x" << std::endl;
 
-    // TODO: Using a two dimensional vector is unnecessary. Have a look at
-    // test_computation.cpp for a better solution.
-    // create the buffer that holds our data
-    constants::fracbuff fractalbuffer;
-    fractalbuffer.assign(params->yrange, std::vector<constants::Iterations>());
-    for (auto &v : fractalbuffer) {
-        v.assign(params->xrange, constants::Iterations());
-    }
-
-    std::unique_ptr<Fractalcruncher> crunchi;
-
-    if (parser.count("m")) {
-        prnt << "+ Multicore: " << params->cores << std::endl;
-        crunchi = std::unique_ptr<Fractalcrunchmulti>(
-            new Fractalcrunchmulti(fractalbuffer, params));
-    } else {
-        prnt << "+ Singlecore " << std::endl;
-        crunchi = std::unique_ptr<Fractalcrunchsingle>(
-            new Fractalcrunchsingle(fractalbuffer, params));
-    }
-
-    // Do the work
-    std::chrono::time_point<std::chrono::system_clock> tbegin;
-    tbegin = std::chrono::system_clock::now();
-    crunchi->fill_buffer();
-    std::chrono::time_point<std::chrono::system_clock> tend =
-        std::chrono::system_clock::now();
+    unsigned long long pixels =
+        static_cast<unsigned long long>(params->xrange) * params->yrange;
 
-    // calculate time delta
-    auto deltat =
-        std::chrono::duration_cast<std::chrono::milliseconds>(tend - tbegin);
-    prnt << "+" << std::endl;
-    prnt << "+ Fractalcruncher time " << deltat.count() << "ms \n+" << std::endl;
+    // create the buffer that holds our data
+    stats.begin("allocate");
+    constants::fracbuff fractalbuffer = geomandel::create_buffer(*params);
+    stats.end().pixels = pixels;
 
     // TODO: More refactoring needed here. Would be nice to move this somewhere
     // else. Maybe we could put this into the Mandelparameters structure.
     // The way we make it right now is not testable by Catch.
     // TODO: Shouldn't we use unsigned int in rgb tuples?
 
-    // visualize/export the crunched numbers
-    std::unique_ptr<Buffwriter> img;
-    std::unique_ptr<Buffwriter> csv =
-        std::unique_ptr<CSVWriter>(new CSVWriter(fractalbuffer, params));
-    if (parser.count("image-pnm-bw")) {
-        prnt << "+ Generating B/W image" << std::endl;
-        img = std::unique_ptr<ImageBW>(new ImageBW(fractalbuffer, params, prnt));
-        img->write_buffer();
+    // image writers are created before the computation so the progressive
+    // renderer is able to publish intermediate images.
+    constants::samplebuff fractalsamples;
+    auto images = create_image_writers(parser, fractalbuffer, params, prnt);
+    images.set_samples(fractalsamples);
+    Numatopology topo;
+    if (parser.count("numa")) {
+        topo = Numatopology::detect();
+        prnt << "+ NUMA nodes: " << topo.nodes() << std::endl;
+        images.set_numa(&topo);
     }
-    if (parser.count("image-pnm-grey")) {
-        prnt << "+ Generating grey scale bitmap" << std::endl;
-        unsigned int grey_base = parser["grey-base"].as<unsigned int>();
-        // do we need to use std::fabs for the parsed double here?
-        double grey_freq = parser["grey-freq"].as<double>();
-        img = std::unique_ptr<Imagegrey>(new Imagegrey(
-            fractalbuffer, params, prnt, std::make_tuple(grey_base, 0, 0),
-            std::make_tuple(grey_freq, 0, 0)));
-        img->write_buffer();
-    }
-    if (parser.count("image-pnm-col")) {
-        prnt << "+ Generating RGB bitmap" << std::endl;
-        std::tuple<int, int, int> rgb_base;
-        std::tuple<int, int, int> rgb_set_base;
-        std::tuple<double, double, double> rgb_freq;
-        std::tuple<int, int, int> rgb_phase;
-        std::tuple<double, double, double> rgb_amp;
-        parse_rgb_command_options(parser, rgb_base, rgb_set_base, rgb_freq,
-                                  rgb_phase, rgb_amp);
-        img = std::unique_ptr<Imagecol>(
-            new Imagecol(fractalbuffer, params, prnt, std::move(rgb_base),
-                         std::move(rgb_set_base), std::move(rgb_freq),
-                         std::move(rgb_phase), std::move(rgb_amp)));
-        img->write_buffer();
+
+    bool cached = false;
+#ifdef HAVE_RENDERCACHE
+    if (cache != nullptr) {
+        stats.begin("cache");
+        cached = cache->load(*params, fractalbuffer, fractalsamples);
+        stats.end().pixels = cached ? pixels : 0;
+        if (cached)
+            prnt << "+ Loaded from render cache\n+" << std::endl;
     }
-    uint8_t png_jpg = 0;
-    if (parser.count("image-png"))
-        png_jpg |= static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_PNG);
+#endif
 
-    if (parser.count("image-jpg"))
-        png_jpg |= static_cast<uint8_t>(constants::OUT_FORMAT::IMAGE_JPG);
-    if (png_jpg != 0) {
-        prnt << "+ Generating jpg/png image" << std::endl;
-        std::tuple<int, int, int> rgb_base;
-        std::tuple<int, int, int> rgb_set_base;
-        std::tuple<double, double, double> rgb_freq;
-        std::tuple<int, int, int> rgb_phase;
-        std::tuple<double, double, double> rgb_amp;
-        parse_rgb_command_options(parser, rgb_base, rgb_set_base, rgb_freq,
-                                  rgb_phase, rgb_amp);
-// TODO: Don't like ifdefs in code. Maybe better off with an "empty"
-// ImageSFML stub class
-#ifdef HAVE_SFML
-        img = std::unique_ptr<ImageSFML>(
-            new ImageSFML(fractalbuffer, params, prnt, std::move(rgb_base),
-                          std::move(rgb_set_base), std::move(rgb_freq),
-                          std::move(rgb_phase), std::move(rgb_amp), png_jpg));
-        img->write_buffer();
+    if (!cached) {
+        std::unique_ptr<Fractalcruncher> crunchi;
+        // the single core engine has no thread pool, the main thread does the
+        // work then
+        std::unique_ptr<Workerclock> clock;
+        std::unique_ptr<Jobtrace> trace;
+        Fractalcrunchboundary *boundary = nullptr;
+
+        if (params->progressive > 0) {
+            prnt << "+ Progressive: " << params->progressive << std::endl;
+            // rewrite all images after every level except the final one, which
+            // is written below like in every other mode
+            crunchi = std::unique_ptr<Fractalcrunchprogressive>(
+                new Fractalcrunchprogressive(
+                    fractalbuffer, params, [&images, &prnt](unsigned int step) {
+                        if (step == 1)
+                            return;
+                        prnt << "+ Level " << step << std::endl;
+                        write_images(images, prnt, false);
+                    }));
+            clock = std::unique_ptr<Workerclock>(
+                new Workerclock(std::max(params->cores, 1u)));
+        } else if (params->boundary > 0) {
+            prnt << "+ Boundary tracing: " << params->boundary << "x"
+                 << params->boundary << " regions" << std::endl;
+            boundary = new Fractalcrunchboundary(fractalbuffer, params);
+            crunchi = std::unique_ptr<Fractalcruncher>(boundary);
+            clock = std::unique_ptr<Workerclock>(
+                new Workerclock(std::max(params->cores, 1u)));
+        } else if (parser.count("m")) {
+            prnt << "+ Multicore: " << params->cores << std::endl;
+            std::unique_ptr<Fractalcrunchmulti> multi(
+                new Fractalcrunchmulti(fractalbuffer, params));
+            if (parser.count("trace")) {
+                trace = std::unique_ptr<Jobtrace>(
+                    new Jobtrace(std::max(params->cores, 1u)));
+                multi->set_jobtrace(trace.get());
+            }
+            if (parser.count("numa")) {
+                multi->set_numa(&topo);
+                stats.begin("first_touch");
+                multi->first_touch();
+                stats.end().pixels = pixels;
+            }
+            if (parser.count("cost-schedule")) {
+                unsigned int divisor =
+                    parser["cost-schedule"].as<unsigned int>();
+                prnt << "+ Cost pre-pass: 1/" << divisor << " resolution"
+                     << std::endl;
+                stats.begin("prepass");
+                multi->prepass_costmap(divisor);
+                Runstats::Phase &prepass = stats.end();
+                prepass.pixels = static_cast<unsigned long long>(
+                                     std::max(params->xrange / divisor, 1u)) *
+                                 std::max(params->yrange / divisor, 1u);
+            }
+            crunchi = std::move(multi);
+            clock = std::unique_ptr<Workerclock>(
+                new Workerclock(std::max(params->cores, 1u)));
+        } else {
+            prnt << "+ Singlecore " << std::endl;
+            crunchi = std::unique_ptr<Fractalcrunchsingle>(
+                new Fractalcrunchsingle(fractalbuffer, params));
+        }
+
+        crunchi->set_workerclock(clock.get());
+
+        // Do the work
+        stats.begin("compute");
+        std::chrono::time_point<std::chrono::system_clock> tbegin;
+        tbegin = std::chrono::system_clock::now();
+        crunchi->fill_buffer();
+        std::chrono::time_point<std::chrono::system_clock> tend =
+            std::chrono::system_clock::now();
+        Runstats::Phase &compute = stats.end();
+        compute.pixels = pixels;
+        compute.iterations = count_iterations(fractalbuffer, nullptr);
+        compute.busy = clock ? clock->busy()
+                             : std::vector<double>(1, compute.seconds);
+
+        // calculate time delta
+        auto deltat = std::chrono::duration_cast<std::chrono::milliseconds>(
+            tend - tbegin);
+        prnt << "+" << std::endl;
+        prnt << "+ Fractalcruncher time " << deltat.count() << "ms \n+"
+             << std::endl;
+        if (boundary != nullptr) {
+            prnt << "+ Computed " << boundary->computed_pixels() << " of "
+                 << pixels << " pixels\n+" << std::endl;
+        }
+
+        // refine edge pixels with additional samples
+        if (params->aa_samples > 0) {
+            if (clock)
+                clock = std::unique_ptr<Workerclock>(
+                    new Workerclock(std::max(params->cores, 1u)));
+            crunchi->set_workerclock(clock.get());
+            stats.begin("supersample");
+            tbegin = std::chrono::system_clock::now();
+            crunchi->supersample_buffer(fractalsamples);
+            tend = std::chrono::system_clock::now();
+            Runstats::Phase &supersample = stats.end();
+            supersample.pixels = fractalsamples.size() * params->aa_samples;
+            supersample.iterations =
+                count_iterations(fractalbuffer, &fractalsamples);
+            supersample.busy =
+                clock ? clock->busy()
+                      : std::vector<double>(1, supersample.seconds);
+            deltat = std::chrono::duration_cast<std::chrono::milliseconds>(
+                tend - tbegin);
+            prnt << "+ Supersampling " << fractalsamples.size()
+                 << " edge pixels (" << params->aa_samples << " samples) "
+                 << deltat.count() << "ms \n+" << std::endl;
+        }
+#ifdef HAVE_RENDERCACHE
+        if (cache != nullptr)
+            cache->store(*params, fractalbuffer, fractalsamples);
 #endif
+        if (trace) {
+            std::string tracefile = parser["trace"].as<std::string>();
+            try {
+                trace->write(tracefile);
+                prnt << "+ Job trace written to " << tracefile << "\n+"
+                     << std::endl;
+            } catch (const std::exception &ex) {
+                std::cerr << ex.what() << std::endl;
+            }
+        }
     }
 
+    // visualize/export the crunched numbers
+    write_images(images, prnt, true, &stats);
+
+    std::unique_ptr<Buffwriter> csv =
+        std::unique_ptr<CSVWriter>(new CSVWriter(fractalbuffer, params));
+
+    bool exports =
+        parser.count("csv") || parser.count("dump") || parser.count("cost");
+    if (exports)
+        stats.begin("write");
     if (parser.count("csv")) {
         prnt << "+ Exporting data to csv files" << std::endl;
         csv->write_buffer();
     }
+    if (parser.count("dump")) {
+        prnt << "+ Exporting data to binary dump" << std::endl;
+        Dumpwriter dump(fractalbuffer, params);
+        dump.set_samples(fractalsamples);
+        dump.write_buffer();
+    }
+    if (parser.count("cost")) {
+        prnt << "+ Exporting iteration cost" << std::endl;
+        Costwriter cost(fractalbuffer, params,
+                        parser["cost-tile"].as<unsigned int>());
+        cost.set_samples(fractalsamples);
+        cost.write_buffer();
+    }
+    if (exports)
+        stats.end().pixels = pixels;
     if (parser.count("p"))
         prnt_buff(fractalbuffer, params->bailout);  // print the buffer
 
     prnt << "+\n+" << std::endl;
+    print_stats(parser, stats, prnt);
     prnt << "+++++++++++++++++++++++++++++++++++++" << std::endl << std::endl;
     return 0;
 }
@@ -22,8 +22,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "config.h"
 
+#include "formula.h"
 #include "fractalparams.h"
 #include "fractalzoom.h"
+#include "newton.h"
 
 inline void init_mandel_parameters(std::shared_ptr<FractalParameters> &params,
                                    const cxxopts::Options &parser)
@@ -50,10 +52,45 @@ inline void init_mandel_parameters(std::shared_ptr<FractalParameters> &params,
             set_type = constants::FRACTAL::BURNING_SHIP;
             fractal_type = "burning_ship";
             break;
+        case 4:
+            set_type = constants::FRACTAL::FORMULA;
+            fractal_type = "formula";
+            break;
+        case 5:
+            set_type = constants::FRACTAL::NEWTON;
+            fractal_type = "newton";
+            break;
         default:
             throw std::out_of_range("Fractal argument out of range");
         }
 
+        std::shared_ptr<const Formula> formula;
+        if (set_type == constants::FRACTAL::FORMULA) {
+            if (!parser.count("formula")) {
+                std::cerr << "Fractal 4 needs an iteration formula, e.g. "
+                             "--formula \"z^3 + c\""
+                          << std::endl;
+                return;
+            }
+            try {
+                formula = std::make_shared<const Formula>(
+                    parser["formula"].as<std::string>());
+            } catch (const std::invalid_argument &ex) {
+                std::cerr << ex.what() << std::endl;
+                return;
+            }
+        }
+        std::shared_ptr<const Newton> newton;
+        if (set_type == constants::FRACTAL::NEWTON) {
+            try {
+                newton = std::make_shared<const Newton>(
+                    parser["polynomial"].as<std::string>());
+            } catch (const std::invalid_argument &ex) {
+                std::cerr << ex.what() << std::endl;
+                return;
+            }
+        }
+
         unsigned int bailout = parser["b"].as<unsigned int>();
 
         // define complex plane variables
@@ -129,6 +166,9 @@ inline void init_mandel_parameters(std::shared_ptr<FractalParameters> &params,
         case 2:
             col_algo = constants::COL_ALGO::CONTINUOUS_BERN;
             break;
+        case 3:
+            col_algo = constants::COL_ALGO::DISTANCE;
+            break;
         default:
             throw std::out_of_range("Color algorithm argument out of range");
         }
@@ -140,6 +180,14 @@ inline void init_mandel_parameters(std::shared_ptr<FractalParameters> &params,
             bailout, zoomlvl, xcoord, ycoord,
             parser["image-file"].as<std::string>(), fractal_type, cores,
             col_algo);
+        params->formula = formula;
+        params->newton = newton;
+        params->aa_samples = parser["supersample"].as<unsigned int>();
+        params->aa_threshold = parser["aa-threshold"].as<double>();
+        if (parser.count("progressive"))
+            params->progressive = parser["progressive"].as<unsigned int>();
+        if (parser.count("boundary"))
+            params->boundary = parser["boundary"].as<unsigned int>();
     } catch (const cxxopts::missing_argument_exception &ex) {
         std::cerr << "Missing argument \n  " << ex.what() << std::endl;
     } catch (const cxxopts::OptionParseException &ex) {
@@ -154,10 +202,49 @@ inline void configure_command_line_parser(cxxopts::Options &p)
 {
     // clang-format off
     p.add_options()
+#ifdef HAVE_RENDERCACHE
+        ("cache", "Directory of a persistent render cache. Identical "
+         "computations are loaded from the cache instead",
+         cxxopts::value<std::string>())
+        ("cache-size", "Size limit of the render cache in MiB",
+         cxxopts::value<unsigned long long>()->default_value("1024"))
+#endif
+        ("from-dump", "Create images from a binary dump without computing "
+         "the fractal again",
+         cxxopts::value<std::string>())
         ("help", "Show this help")
         ("m,multi", "Use multiple cores",
          cxxopts::value<unsigned int>()->implicit_value("2"))
-        ("q,quiet", "Don't write to stdout (This does not influence stderr)");
+        ("cost-schedule", "Dispatch the jobs of the multicore engine by the "
+         "cost predicted from a pre-pass with 1/n of the resolution",
+         cxxopts::value<unsigned int>()->implicit_value("8"))
+        ("arena", "Reuse frame buffer memory between renders, backed by "
+         "normal, transparent huge (thp) or reserved huge pages (huge)",
+         cxxopts::value<std::string>()->implicit_value("thp"))
+        ("numa", "Pin the multicore workers to the NUMA nodes and place "
+         "every row of the buffer on the node that computes it")
+        ("progressive", "Progressive multi resolution rendering starting "
+         "with every n-th pixel. Images are rewritten after every level",
+         cxxopts::value<unsigned int>()->implicit_value("16"))
+        ("boundary", "Only compute the borders of the escape time bands in "
+         "regions of n x n pixels and fill the areas they enclose",
+         cxxopts::value<unsigned int>()->implicit_value("64"))
+        ("q,quiet", "Don't write to stdout (This does not influence stderr)")
+        ("stats", "Report time, throughput, thread utilization and memory of "
+         "every phase as text or json",
+         cxxopts::value<std::string>()->implicit_value("text"))
+        ("trace", "Write a Chrome trace event file with every job of the "
+         "multicore engine",
+         cxxopts::value<std::string>())
+#ifdef HAVE_RENDERSERVER
+        ("serve", "Run as render server listening on a localhost TCP port or "
+         "a Unix domain socket path",
+         cxxopts::value<std::string>())
+        ("tile-cache", "Memory in MiB the render server uses to cache tiles "
+         "for panning, 0 disables the tile cache",
+         cxxopts::value<unsigned int>()->default_value("256"))
+#endif
+        ;
 
     p.add_options("Fractal")
         ("f,fractal", "Choose which kind of fractal you want to compute and render",
@@ -175,7 +262,19 @@ inline void configure_command_line_parser(cxxopts::Options &p)
         ("julia-real", "Julia set constant real part",
          cxxopts::value<double>()->default_value("-0.8"))
         ("julia-ima", "Julia set constant imaginary part",
-         cxxopts::value<double>()->default_value("0.156"));
+         cxxopts::value<double>()->default_value("0.156"))
+        ("formula", "Iteration formula of fractal 4 in z and c, e.g. "
+         "\"z^3 + c\" or \"conj(z)^2 + c\"",
+         cxxopts::value<std::string>())
+        ("polynomial", "Coefficients of the polynomial of fractal 5 (Newton), "
+         "highest degree first. 1,0,0,-1 is z^3 - 1",
+         cxxopts::value<std::string>()->default_value("1,0,0,-1"))
+        ("supersample", "Number of additional jittered samples for pixels on "
+         "edges. 0 disables supersampling",
+         cxxopts::value<unsigned int>()->default_value("0"))
+        ("aa-threshold", "Minimum index difference to a neighbor pixel that "
+         "triggers supersampling",
+         cxxopts::value<double>()->default_value("1.0"));
 
     p.add_options("Image")
         ("image-file", "Image file name pattern. You can use different printf "
@@ -191,11 +290,13 @@ inline void configure_command_line_parser(cxxopts::Options &p)
         ("image-pnm-col", "Write Buffer to PPM Bitmap")
 #ifdef HAVE_SFML
         ("image-jpg", "Write Buffer to JPG image")
+#endif
+#if defined(HAVE_ZLIB) || defined(HAVE_SFML)
         ("image-png", "Write Buffer to PNG image")
 #endif
         ("col-algo", "Coloring algorithm 0->Escape Time Linear, "
          "1->Continuous Coloring Sine, "
-         "2->Continuous Coloring Bernstein" ,
+         "2->Continuous Coloring Bernstein, 3->Distance Estimation" ,
          cxxopts::value<unsigned int>()->default_value("1"))
         ("grey-base", "Base grey shade between 0 - 255",
          cxxopts::value<unsigned int>()->default_value("55"))
@@ -220,7 +321,17 @@ inline void configure_command_line_parser(cxxopts::Options &p)
 
     p.add_options("Export")
         ("p,print", "Print Buffer to terminal")
-        ("csv", "Export data to csv files");
+        ("csv", "Export data to csv files")
+        ("dump", "Export data to a binary iteration dump (.gmd)")
+        ("cost", "Export the iterations executed per pixel as a grey image "
+         "and the summed cost of tiles as csv")
+        ("cost-tile", "Width and height of a cost tile in pixels",
+         cxxopts::value<unsigned int>()->default_value("32"))
+        ("tiles", "Render a z/x/y tile pyramid for the zoom levels N-M (or "
+         "only level N) into the directory given by image-file",
+         cxxopts::value<std::string>())
+        ("tile-size", "Width and height of a tile in pixels",
+         cxxopts::value<unsigned int>()->default_value("256"));
     // clang-format on
 }
 
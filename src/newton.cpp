@@ -0,0 +1,276 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "newton.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+// a sample converged once a step is shorter than 1e-6
+const double step_tolerance = 1e-12;
+
+/**
+ * @brief Read a real or imaginary number like 2, -0.5, 3i or -i
+ */
+bool read_term(const char *&p, double &value, bool &imaginary)
+{
+    char *end = nullptr;
+    value = std::strtod(p, &end);
+    if (end == p) {
+        // a unit without number, i or -i
+        double sign = 1;
+        if (*p == '+') {
+            p++;
+        } else if (*p == '-') {
+            sign = -1;
+            p++;
+        }
+        if (*p != 'i')
+            return false;
+        p++;
+        value = sign;
+        imaginary = true;
+        return true;
+    }
+    p = end;
+    imaginary = *p == 'i';
+    if (imaginary)
+        p++;
+    return true;
+}
+
+std::complex<double> parse_coefficient(const std::string &item)
+{
+    const char *p = item.c_str();
+    double first = 0;
+    bool first_imaginary = false;
+    if (!read_term(p, first, first_imaginary))
+        throw std::invalid_argument("Invalid coefficient \"" + item + "\"");
+    std::complex<double> value =
+        first_imaginary ? std::complex<double>(0, first) : first;
+    if (*p != '\0') {
+        // real part followed by the imaginary part, like 1-0.5i
+        double second = 0;
+        bool second_imaginary = false;
+        if (first_imaginary || (*p != '+' && *p != '-') ||
+            !read_term(p, second, second_imaginary) || !second_imaginary ||
+            *p != '\0')
+            throw std::invalid_argument("Invalid coefficient \"" + item +
+                                        "\"");
+        value = std::complex<double>(first, second);
+    }
+    return value;
+}
+
+std::complex<double> horner(const std::vector<std::complex<double>> &coef,
+                            std::complex<double> z)
+{
+    std::complex<double> p = coef.front();
+    for (size_t j = 1; j < coef.size(); j++)
+        p = p * z + coef[j];
+    return p;
+}
+}
+
+const unsigned int Newton::lanes;
+
+Newton::Newton(const std::string &coefficients) : src(coefficients)
+{
+    std::vector<std::complex<double>> coef;
+    std::vector<std::string> items;
+    utility::split(coefficients, ',', items);
+    for (std::string item : items) {
+        item.erase(std::remove_if(item.begin(), item.end(),
+                                  [](char ch) { return std::isspace(ch); }),
+                   item.end());
+        std::complex<double> c = parse_coefficient(item);
+        // leading zeros do not count for the degree
+        if (coef.empty() && c == 0.0)
+            continue;
+        coef.push_back(c);
+    }
+    if (coef.size() < 3)
+        throw std::invalid_argument("Newton fractals need a polynomial of "
+                                    "degree 2 or higher, got \"" +
+                                    coefficients + "\"");
+    // the monic polynomial has the same roots and a simpler Horner scheme
+    std::complex<double> lead = coef.front();
+    for (const auto &c : coef) {
+        this->coef_re.push_back((c / lead).real());
+        this->coef_im.push_back((c / lead).imag());
+    }
+    this->find_roots();
+}
+
+const std::string &Newton::source() const { return this->src; }
+unsigned int Newton::degree() const
+{
+    return static_cast<unsigned int>(this->coef_re.size() - 1);
+}
+
+const std::vector<std::complex<double>> &Newton::roots() const
+{
+    return this->root_list;
+}
+
+void Newton::find_roots()
+{
+    std::vector<std::complex<double>> coef;
+    for (size_t j = 0; j < this->coef_re.size(); j++)
+        coef.emplace_back(this->coef_re[j], this->coef_im[j]);
+
+    // Durand-Kerner finds all roots at once, the start values must not be
+    // symmetric to the real axis
+    unsigned int n = this->degree();
+    std::vector<std::complex<double>> r(n);
+    std::complex<double> seed(0.4, 0.9);
+    r[0] = 1;
+    for (unsigned int k = 1; k < n; k++)
+        r[k] = r[k - 1] * seed;
+    for (unsigned int iter = 0; iter < 1000; iter++) {
+        double change = 0;
+        for (unsigned int k = 0; k < n; k++) {
+            std::complex<double> denom = 1;
+            for (unsigned int j = 0; j < n; j++) {
+                if (j != k)
+                    denom *= r[k] - r[j];
+            }
+            std::complex<double> delta = horner(coef, r[k]) / denom;
+            r[k] -= delta;
+            change = std::max(change, std::abs(delta));
+        }
+        if (change < 1e-14)
+            break;
+    }
+    // basins are numbered counter clockwise starting at the negative real
+    // axis, the same polynomial always gets the same colors
+    std::sort(r.begin(), r.end(),
+              [](const std::complex<double> &a, const std::complex<double> &b) {
+                  return std::arg(a) < std::arg(b);
+              });
+    this->root_list = r;
+}
+
+unsigned int Newton::nearest_root(double x, double y) const
+{
+    unsigned int best = 0;
+    double best_dist = 0;
+    for (unsigned int k = 0; k < this->root_list.size(); k++) {
+        double dx = x - this->root_list[k].real();
+        double dy = y - this->root_list[k].imag();
+        double dist = dx * dx + dy * dy;
+        if (k == 0 || dist < best_dist) {
+            best = k;
+            best_dist = dist;
+        }
+    }
+    return best;
+}
+
+constants::Iterations Newton::iterate(double x, double y,
+                                      unsigned int bailout) const
+{
+    constants::Iterations it;
+    this->iterate_span(&x, y, 1, bailout, &it);
+    return it;
+}
+
+void Newton::iterate_span(const double *x, double y, size_t n,
+                          unsigned int bailout,
+                          constants::Iterations *out) const
+{
+    const size_t deg = this->coef_re.size() - 1;
+    const double *ar = this->coef_re.data();
+    const double *ai = this->coef_im.data();
+
+    for (size_t base = 0; base < n; base += lanes) {
+        size_t count = std::min<size_t>(lanes, n - base);
+        double zr[lanes];
+        double zi[lanes];
+        unsigned int its[lanes];
+        bool active[lanes];
+        for (size_t k = 0; k < lanes; k++) {
+            // unused lanes compute a copy of the first pixel
+            zr[k] = x[base + (k < count ? k : 0)];
+            zi[k] = y;
+            its[k] = 0;
+            active[k] = k < count;
+        }
+
+        size_t remaining = count;
+        for (unsigned int i = 0; i < bailout && remaining > 0; i++) {
+            // p(z) and p'(z) with Horner's scheme, all lanes at once
+            double pr[lanes];
+            double pi[lanes];
+            double dr[lanes];
+            double di[lanes];
+            for (size_t k = 0; k < lanes; k++) {
+                pr[k] = ar[0];
+                pi[k] = ai[0];
+                dr[k] = 0;
+                di[k] = 0;
+            }
+            for (size_t j = 1; j <= deg; j++) {
+                for (size_t k = 0; k < lanes; k++) {
+                    double t = dr[k] * zr[k] - di[k] * zi[k] + pr[k];
+                    di[k] = dr[k] * zi[k] + di[k] * zr[k] + pi[k];
+                    dr[k] = t;
+                    t = pr[k] * zr[k] - pi[k] * zi[k] + ar[j];
+                    pi[k] = pr[k] * zi[k] + pi[k] * zr[k] + ai[j];
+                    pr[k] = t;
+                }
+            }
+            // step p / p', one division shared by both parts
+            double sr[lanes];
+            double si[lanes];
+            for (size_t k = 0; k < lanes; k++) {
+                double inv = 1.0 / (dr[k] * dr[k] + di[k] * di[k]);
+                sr[k] = (pr[k] * dr[k] + pi[k] * di[k]) * inv;
+                si[k] = (pi[k] * dr[k] - pr[k] * di[k]) * inv;
+            }
+            for (size_t k = 0; k < lanes; k++) {
+                if (!active[k])
+                    continue;
+                zr[k] -= sr[k];
+                zi[k] -= si[k];
+                its[k]++;
+                if (sr[k] * sr[k] + si[k] * si[k] < step_tolerance) {
+                    active[k] = false;
+                    remaining--;
+                }
+            }
+        }
+
+        for (size_t k = 0; k < count; k++) {
+            constants::Iterations &it = out[base + k];
+            it = constants::Iterations();
+            it.cost = its[k];
+            if (active[k]) {
+                // did not converge, colored like the inside of a set
+                it.default_index = bailout;
+            } else {
+                it.default_index = its[k];
+                it.basin = this->nearest_root(zr[k], zi[k]);
+            }
+        }
+    }
+}
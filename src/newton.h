@@ -0,0 +1,106 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NEWTON_H
+#define NEWTON_H
+
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "global.h"
+
+/**
+ * @brief Newton's method for a polynomial given on the command line
+ *
+ * @details
+ * Every point of the complex plane is the start value of Newton's method
+ * z = z - p(z) / p'(z). The result of a sample is the number of iterations
+ * it took to converge in default_index and the index of the root it
+ * converged to in basin. Samples that did not converge within the bailout
+ * get the bailout as default_index, like points inside the Mandelbrot set.
+ *
+ * p(z) and p'(z) are evaluated together with Horner's scheme. Rows are
+ * computed in groups of lanes pixels with branch free loops over the lanes,
+ * which the compiler vectorizes.
+ */
+class Newton
+{
+public:
+    /**
+     * @brief Pixels computed together by iterate_span
+     */
+    static const unsigned int lanes = 4;
+
+    /**
+     * @brief Parse the coefficients and find the roots
+     *
+     * @param coefficients Comma separated coefficients, highest degree
+     * first. Coefficients may be complex like 2i or 1-0.5i, "1,0,0,-1" is
+     * z^3 - 1.
+     *
+     * @throws std::invalid_argument If the coefficients can not be parsed or
+     * the degree is lower than 2
+     */
+    explicit Newton(const std::string &coefficients);
+
+    const std::string &source() const;
+    unsigned int degree() const;
+
+    /**
+     * @brief Roots of the polynomial, the basin index refers to this list
+     */
+    const std::vector<std::complex<double>> &roots() const;
+
+    /**
+     * @brief Newton's method for a single point
+     *
+     * @param x Real part of the start value
+     * @param y Imaginary part of the start value
+     * @param bailout Maximum number of iterations
+     */
+    constants::Iterations iterate(double x, double y,
+                                  unsigned int bailout) const;
+
+    /**
+     * @brief Newton's method for consecutive pixels of a row
+     *
+     * @param x Real parts of the start values
+     * @param y Imaginary part, the same for all pixels of a row
+     * @param n Number of pixels
+     * @param bailout Maximum number of iterations
+     * @param out Results of the n pixels
+     *
+     * @details
+     * The results are exactly the same as those of iterate.
+     */
+    void iterate_span(const double *x, double y, size_t n,
+                      unsigned int bailout, constants::Iterations *out) const;
+
+private:
+    std::string src;
+    // coefficients of the monic polynomial, highest degree first
+    std::vector<double> coef_re;
+    std::vector<double> coef_im;
+    std::vector<std::complex<double>> root_list;
+
+    void find_roots();
+    unsigned int nearest_root(double x, double y) const;
+};
+
+#endif /* ifndef NEWTON_H */
@@ -0,0 +1,181 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "numa.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "global.h"
+
+Nodequeue::Nodequeue(unsigned int nodes)
+    : items(std::max(nodes, 1u)),
+      next(new std::atomic<size_t>[std::max(nodes, 1u)])
+{
+    for (size_t n = 0; n < this->items.size(); n++)
+        this->next[n] = 0;
+}
+
+void Nodequeue::push(unsigned int node, size_t item)
+{
+    this->items[node % this->items.size()].push_back(item);
+}
+
+bool Nodequeue::claim(unsigned int node, size_t &item)
+{
+    size_t nodes = this->items.size();
+    for (size_t k = 0; k < nodes; k++) {
+        size_t n = (node + k) % nodes;
+        if (this->next[n].load(std::memory_order_relaxed) >=
+            this->items[n].size())
+            continue;
+        size_t idx = this->next[n].fetch_add(1, std::memory_order_relaxed);
+        if (idx < this->items[n].size()) {
+            item = this->items[n][idx];
+            return true;
+        }
+    }
+    return false;
+}
+
+Numatopology::Numatopology() : node_cpus(1) {}
+Numatopology::Numatopology(const std::vector<std::vector<int>> &node_cpus)
+    : node_cpus(node_cpus)
+{
+    if (this->node_cpus.empty())
+        this->node_cpus.resize(1);
+}
+
+Numatopology Numatopology::detect()
+{
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    std::string sysdir = "/sys/devices/system/node";
+    DIR *dir = opendir(sysdir.c_str());
+    if (dir == nullptr)
+        return Numatopology();
+    std::vector<int> ids;
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            std::all_of(name.begin() + 4, name.end(), [](char c) {
+                return std::isdigit(static_cast<unsigned char>(c)) != 0;
+            }))
+            ids.push_back(std::stoi(name.substr(4)));
+    }
+    closedir(dir);
+    std::sort(ids.begin(), ids.end());
+    for (int id : ids) {
+        std::ifstream in(sysdir + "/node" + std::to_string(id) + "/cpulist");
+        std::string list;
+        std::getline(in, list);
+        try {
+            std::vector<int> cpus = parse_cpulist(list);
+            // nodes with memory only can not run workers
+            if (!cpus.empty())
+                nodes.push_back(cpus);
+        } catch (const std::invalid_argument &) {
+            return Numatopology();
+        }
+    }
+#endif
+    return Numatopology(nodes);
+}
+
+std::vector<int> Numatopology::parse_cpulist(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::vector<std::string> ranges;
+    utility::split(list, ',', ranges);
+    for (const auto &range : ranges) {
+        if (range.empty())
+            continue;
+        std::vector<std::string> bounds;
+        utility::split(range, '-', bounds);
+        try {
+            int first = std::stoi(bounds.at(0));
+            int last = bounds.size() > 1 ? std::stoi(bounds.at(1)) : first;
+            if (bounds.size() > 2 || first < 0 || last < first)
+                throw std::invalid_argument(range);
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        } catch (const std::logic_error &) {
+            throw std::invalid_argument("Invalid cpu list " + list);
+        }
+    }
+    return cpus;
+}
+
+unsigned int Numatopology::nodes() const
+{
+    return static_cast<unsigned int>(this->node_cpus.size());
+}
+
+const std::vector<int> &Numatopology::cpus(unsigned int node) const
+{
+    return this->node_cpus.at(node);
+}
+
+unsigned int Numatopology::worker_node(unsigned int worker,
+                                       unsigned int workers) const
+{
+    if (workers == 0)
+        return 0;
+    return static_cast<unsigned int>(static_cast<unsigned long long>(worker) *
+                                     this->nodes() / workers) %
+           this->nodes();
+}
+
+unsigned int Numatopology::row_node(unsigned int row, unsigned int rows) const
+{
+    return this->worker_node(row, rows);
+}
+
+unsigned int Numatopology::pin(ctpl::thread_pool &tpl) const
+{
+    unsigned int pinned = 0;
+#ifdef __linux__
+    unsigned int workers = static_cast<unsigned int>(tpl.size());
+    for (unsigned int i = 0; i < workers; i++) {
+        const auto &cpus = this->node_cpus[this->worker_node(i, workers)];
+        if (cpus.empty())
+            continue;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        }
+        if (pthread_setaffinity_np(
+                tpl.get_thread(static_cast<int>(i)).native_handle(),
+                sizeof(set), &set) == 0)
+            pinned++;
+    }
+#else
+    (void)tpl;
+#endif
+    return pinned;
+}
@@ -0,0 +1,138 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ctpl_stl.h"
+
+/**
+ * @brief Work items grouped by the NUMA node whose memory they touch
+ *
+ * @details
+ * Workers claim the items of their own node first and take items of the other
+ * nodes once their node has run out of work. Claiming is a single atomic
+ * increment, all items have to be pushed before the first claim.
+ */
+class Nodequeue
+{
+public:
+    explicit Nodequeue(unsigned int nodes);
+
+    void push(unsigned int node, size_t item);
+
+    /**
+     * @brief Take the next item
+     *
+     * @param node Node of the calling worker
+     * @param item Receives the item
+     *
+     * @return False if all items of all nodes were taken
+     */
+    bool claim(unsigned int node, size_t &item);
+
+private:
+    std::vector<std::vector<size_t>> items;
+    std::unique_ptr<std::atomic<size_t>[]> next;
+};
+
+/**
+ * @brief CPUs of the NUMA nodes of this machine
+ *
+ * @details
+ * Pages are placed on the node of the thread that touches them first. If the
+ * workers of a pool are pinned to the nodes and every row is allocated and
+ * computed by a worker of the same node, memory traffic stays on the node.
+ * Rows are assigned to the nodes in contiguous bands, like the workers.
+ */
+class Numatopology
+{
+public:
+    /**
+     * @brief A single node without affinity information
+     */
+    Numatopology();
+    explicit Numatopology(const std::vector<std::vector<int>> &node_cpus);
+
+    /**
+     * @brief Read the nodes from /sys/devices/system/node
+     *
+     * @return The nodes with CPUs, a single node if the information is not
+     * available
+     */
+    static Numatopology detect();
+
+    /**
+     * @brief Parse a Linux cpu list like "0-3,8,10-11"
+     *
+     * @throw std::invalid_argument on syntax errors
+     */
+    static std::vector<int> parse_cpulist(const std::string &list);
+
+    unsigned int nodes() const;
+    const std::vector<int> &cpus(unsigned int node) const;
+
+    unsigned int worker_node(unsigned int worker, unsigned int workers) const;
+    unsigned int row_node(unsigned int row, unsigned int rows) const;
+
+    /**
+     * @brief Pin every worker of a pool to the CPUs of its node
+     *
+     * @param tpl
+     *
+     * @return Number of workers that were pinned, 0 if pinning is not
+     * supported
+     */
+    unsigned int pin(ctpl::thread_pool &tpl) const;
+
+    /**
+     * @brief Run job(id, item) for all items of a queue on all workers
+     *
+     * @param tpl Pool whose workers claim the items of their node
+     * @param queue
+     * @param job
+     */
+    template <typename F>
+    void run(ctpl::thread_pool &tpl, Nodequeue &queue, F job) const
+    {
+        unsigned int workers = static_cast<unsigned int>(tpl.size());
+        std::vector<std::future<void>> futures;
+        for (unsigned int i = 0; i < workers; i++) {
+            futures.push_back(tpl.push([this, workers, &queue, &job](int id) {
+                unsigned int node =
+                    this->worker_node(static_cast<unsigned int>(id), workers);
+                size_t item = 0;
+                while (queue.claim(node, item))
+                    job(id, item);
+            }));
+        }
+        for (auto &f : futures)
+            f.get();
+    }
+
+private:
+    std::vector<std::vector<int>> node_cpus;
+};
+
+#endif /* ifndef NUMA_H */
@@ -0,0 +1,373 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rendercache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "formula.h"
+#include "newton.h"
+
+namespace
+{
+const char cache_magic[4] = {'G', 'M', 'R', 'C'};
+const uint32_t cache_version = 3;
+const std::string cache_suffix = ".gmrc";
+
+template <typename T>
+void put(std::vector<char> &data, T value)
+{
+    size_t pos = data.size();
+    data.resize(pos + sizeof(T));
+    std::memcpy(&data[pos], &value, sizeof(T));
+}
+
+template <typename T>
+bool get(const char *&pos, const char *end, T &value)
+{
+    if (static_cast<size_t>(end - pos) < sizeof(T))
+        return false;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+/**
+ * @brief The value the coloring needs besides the escape time
+ *
+ * @return The continuous index for the sine coloring, the distance estimate
+ * for the distance coloring, the root basin of Newton fractals and nullptr for
+ * all others
+ *
+ * @details
+ * All of them share the memory of the continuous index, so the eight bytes of
+ * the union are stored as they are.
+ */
+double constants::Iterations::*double_plane(const FractalParameters &params)
+{
+    if (params.set_type == constants::FRACTAL::NEWTON ||
+        params.col_algo == constants::COL_ALGO::CONTINUOUS_SINE ||
+        params.col_algo == constants::COL_ALGO::DISTANCE)
+        return &constants::Iterations::continous_index;
+    return nullptr;
+}
+
+/**
+ * @brief Tag of the floating point plane, 0 none, 1 continuous, 2 distance,
+ * 3 root basin
+ */
+uint8_t plane_kind(const FractalParameters &params)
+{
+    if (params.set_type == constants::FRACTAL::NEWTON)
+        return 3;
+    if (params.col_algo == constants::COL_ALGO::DISTANCE)
+        return 2;
+    return double_plane(params) == nullptr ? 0 : 1;
+}
+}
+
+Rendercache::Rendercache(const std::string &dir, unsigned long long max_bytes)
+    : dir(dir), max_bytes(max_bytes), current_bytes(0), tmp_counter(0)
+{
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error("Can not create cache directory " + dir);
+    std::lock_guard<std::mutex> lock(this->mtx);
+    this->evict();
+}
+
+Rendercache::~Rendercache() {}
+uint64_t Rendercache::key(const FractalParameters &params)
+{
+    uint64_t hash = utility::fnv_offset;
+    utility::fnv1a(hash, static_cast<uint32_t>(params.set_type));
+    utility::fnv1a(hash, static_cast<uint32_t>(params.xrange));
+    utility::fnv1a(hash, static_cast<uint32_t>(params.yrange));
+    utility::fnv1a(hash, params.xl);
+    utility::fnv1a(hash, params.xh);
+    utility::fnv1a(hash, params.yl);
+    utility::fnv1a(hash, params.yh);
+    utility::fnv1a(hash, static_cast<uint32_t>(params.bailout));
+    if (params.set_type == constants::FRACTAL::JULIA) {
+        utility::fnv1a(hash, params.julia_real);
+        utility::fnv1a(hash, params.julia_ima);
+    }
+    if (params.set_type == constants::FRACTAL::FORMULA)
+        utility::fnv1a(hash, params.formula->source());
+    if (params.set_type == constants::FRACTAL::NEWTON)
+        utility::fnv1a(hash, params.newton->source());
+    utility::fnv1a(hash, plane_kind(params));
+    // boundary tracing only approximates the image, its results must never
+    // be handed to an exact render
+    utility::fnv1a(hash, static_cast<uint32_t>(params.boundary));
+    utility::fnv1a(hash, static_cast<uint32_t>(params.aa_samples));
+    if (params.aa_samples > 0)
+        utility::fnv1a(hash, params.aa_threshold);
+    return hash;
+}
+
+bool Rendercache::load(const FractalParameters &params,
+                       constants::fracbuff &buff,
+                       constants::samplebuff &samples)
+{
+    uint64_t k = key(params);
+    std::string fname = this->file_name(k);
+    std::ifstream in(fname, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    std::vector<char> data(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(data.data(), static_cast<std::streamsize>(data.size())))
+        return false;
+    in.close();
+
+    const char *pos = data.data();
+    const char *end = pos + data.size();
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t file_key = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t kind = 0;
+    if (data.size() < sizeof(magic))
+        return false;
+    std::memcpy(magic, pos, sizeof(magic));
+    pos += sizeof(magic);
+    if (std::memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+        !get(pos, end, version) || version != cache_version ||
+        !get(pos, end, file_key) || file_key != k ||
+        !get(pos, end, width) || width != params.xrange ||
+        !get(pos, end, height) || height != params.yrange ||
+        !get(pos, end, kind) || kind != plane_kind(params))
+        return false;
+    double constants::Iterations::*extra = double_plane(params);
+
+    // the buffer is only touched once we know the whole file is valid
+    size_t plane = static_cast<size_t>(width) * height;
+    size_t plane_bytes =
+        plane * (2 * sizeof(uint32_t) + (extra ? sizeof(double) : 0));
+    if (static_cast<size_t>(end - pos) < plane_bytes + sizeof(uint64_t))
+        return false;
+    if (buff.size() != height || (height > 0 && buff[0].size() != width))
+        return false;
+
+    // parse into temporaries, the buffers are only swapped in on success
+    const char *its = pos;
+    const char *costs = pos + plane * sizeof(uint32_t);
+    const char *cont = costs + plane * sizeof(uint32_t);
+    pos += plane_bytes;
+
+    constants::samplebuff loaded_samples;
+    uint64_t nsampled = 0;
+    if (!get(pos, end, nsampled))
+        return false;
+    const size_t record_size =
+        2 * sizeof(uint32_t) + (extra ? sizeof(double) : 0);
+    for (uint64_t i = 0; i < nsampled; i++) {
+        uint64_t idx = 0;
+        uint32_t n = 0;
+        if (!get(pos, end, idx) || !get(pos, end, n))
+            return false;
+        // a corrupt length must not make us allocate gigabytes
+        if (static_cast<uint64_t>(n) * record_size >
+            static_cast<uint64_t>(end - pos))
+            return false;
+        std::vector<constants::Iterations> v(n);
+        for (auto &it : v) {
+            if (!get(pos, end, it.default_index) || !get(pos, end, it.cost))
+                return false;
+            if (extra && !get(pos, end, it.*extra))
+                return false;
+        }
+        loaded_samples.emplace(idx, std::move(v));
+    }
+
+    for (uint32_t iy = 0; iy < height; iy++) {
+        for (uint32_t ix = 0; ix < width; ix++) {
+            uint32_t it;
+            uint32_t cost;
+            std::memcpy(&it, its, sizeof(it));
+            its += sizeof(it);
+            std::memcpy(&cost, costs, sizeof(cost));
+            costs += sizeof(cost);
+            buff[iy][ix].default_index = it;
+            buff[iy][ix].cost = cost;
+            if (extra) {
+                std::memcpy(&(buff[iy][ix].*extra), cont,
+                            sizeof(double));
+                cont += sizeof(double);
+            }
+        }
+    }
+    samples.swap(loaded_samples);
+
+    // the modification time is our last access time
+    utime(fname.c_str(), nullptr);
+    return true;
+}
+
+void Rendercache::store(const FractalParameters &params,
+                        const constants::fracbuff &buff,
+                        const constants::samplebuff &samples)
+{
+    uint64_t k = key(params);
+    double constants::Iterations::*extra = double_plane(params);
+    size_t plane = static_cast<size_t>(params.xrange) * params.yrange;
+
+    std::vector<char> data;
+    data.reserve(32 + plane * (2 * sizeof(uint32_t) + sizeof(double)));
+    data.insert(data.end(), cache_magic, cache_magic + sizeof(cache_magic));
+    put(data, cache_version);
+    put(data, k);
+    put(data, static_cast<uint32_t>(params.xrange));
+    put(data, static_cast<uint32_t>(params.yrange));
+    put(data, plane_kind(params));
+    // iterations, costs and the floating point values are stored as separate
+    // planes. The cost is what computing the pixel took, so --cost and the
+    // scheduling of the next frame work on cached renders too
+    for (const auto &row : buff) {
+        for (const auto &it : row)
+            put(data, static_cast<uint32_t>(it.default_index));
+    }
+    for (const auto &row : buff) {
+        for (const auto &it : row)
+            put(data, static_cast<uint32_t>(it.cost));
+    }
+    if (extra) {
+        for (const auto &row : buff) {
+            for (const auto &it : row)
+                put(data, it.*extra);
+        }
+    }
+    put(data, static_cast<uint64_t>(samples.size()));
+    for (const auto &kv : samples) {
+        put(data, static_cast<uint64_t>(kv.first));
+        put(data, static_cast<uint32_t>(kv.second.size()));
+        for (const auto &it : kv.second) {
+            put(data, static_cast<uint32_t>(it.default_index));
+            put(data, static_cast<uint32_t>(it.cost));
+            if (extra)
+                put(data, it.*extra);
+        }
+    }
+
+    std::string fname = this->file_name(k);
+    std::string tmpname;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        tmpname = fname + ".tmp" + std::to_string(getpid()) + "_" +
+                  std::to_string(this->tmp_counter++);
+    }
+    {
+        std::ofstream out(tmpname, std::ios::binary | std::ios::trunc);
+        if (!out.write(data.data(), static_cast<std::streamsize>(data.size())))
+        {
+            std::remove(tmpname.c_str());
+            return;
+        }
+    }
+    std::lock_guard<std::mutex> lock(this->mtx);
+    // an existing entry is replaced, so its size must not be counted twice
+    struct stat st;
+    if (stat(fname.c_str(), &st) == 0)
+        this->current_bytes -= std::min(
+            this->current_bytes, static_cast<unsigned long long>(st.st_size));
+    // readers either see the old file or the complete new one
+    if (std::rename(tmpname.c_str(), fname.c_str()) != 0) {
+        std::remove(tmpname.c_str());
+        return;
+    }
+    this->current_bytes += data.size();
+    if (this->current_bytes > this->max_bytes)
+        this->evict(fname);
+}
+
+unsigned long long Rendercache::size()
+{
+    std::lock_guard<std::mutex> lock(this->mtx);
+    return this->current_bytes;
+}
+
+std::string Rendercache::file_name(uint64_t key) const
+{
+    std::stringstream ss;
+    ss << this->dir << "/" << std::hex << std::setw(16) << std::setfill('0')
+       << key << cache_suffix;
+    return ss.str();
+}
+
+void Rendercache::evict(const std::string &keep)
+{
+    struct Entry {
+        std::string path;
+        time_t mtime;
+        unsigned long long bytes;
+    };
+    std::vector<Entry> entries;
+    unsigned long long total = 0;
+
+    // the directory is scanned so files of other processes are counted too
+    DIR *d = opendir(this->dir.c_str());
+    if (d == nullptr)
+        return;
+    while (struct dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() <= cache_suffix.size() ||
+            name.compare(name.size() - cache_suffix.size(),
+                         cache_suffix.size(), cache_suffix) != 0)
+            continue;
+        std::string path = this->dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+        unsigned long long bytes = static_cast<unsigned long long>(st.st_size);
+        entries.push_back({path, st.st_mtime, bytes});
+        total += bytes;
+    }
+    closedir(d);
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) {
+                  if (a.mtime != b.mtime)
+                      return a.mtime < b.mtime;
+                  return a.path < b.path;
+              });
+    // shrink a bit more than needed so not every store triggers a scan
+    unsigned long long target = this->max_bytes - this->max_bytes / 10;
+    if (total <= this->max_bytes)
+        target = total;
+    for (const auto &e : entries) {
+        if (total <= target)
+            break;
+        if (e.path != keep && std::remove(e.path.c_str()) == 0)
+            total -= e.bytes;
+    }
+    this->current_bytes = total;
+}
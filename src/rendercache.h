@@ -0,0 +1,113 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "global.h"
+#include "fractalparams.h"
+
+/**
+ * @brief Persistent on-disk cache of computed iteration buffers
+ *
+ * @details
+ * Every buffer is stored in its own file inside the cache directory. The file
+ * name is a hash of all FractalParameters fields that influence the iteration
+ * data. Colors are not part of the key as they are applied by the writers, so
+ * the same cache entry can be colored in different ways.
+ *
+ * The file modification time is used as last access time. When the cache
+ * grows beyond its size limit the least recently used files are removed.
+ *
+ * All methods are thread safe and several processes may share a cache
+ * directory.
+ */
+class Rendercache
+{
+public:
+    /**
+     * @brief Open or create a render cache
+     *
+     * @param dir Cache directory, will be created if it does not exist
+     * @param max_bytes Size limit of all cache files in bytes
+     */
+    Rendercache(const std::string &dir, unsigned long long max_bytes);
+    virtual ~Rendercache();
+
+    /**
+     * @brief Cache key of fractal parameters
+     *
+     * @param params
+     *
+     * @return FNV-1a hash of the fields that influence the iteration data
+     */
+    static uint64_t key(const FractalParameters &params);
+
+    /**
+     * @brief Load a cached buffer
+     *
+     * @param params Parameters of the buffer
+     * @param buff Buffer with the size described by params
+     * @param samples Supersampling buffer, filled if params->aa_samples > 0
+     *
+     * @return true if the buffer was found in the cache
+     */
+    bool load(const FractalParameters &params, constants::fracbuff &buff,
+              constants::samplebuff &samples);
+
+    /**
+     * @brief Store a buffer in the cache
+     *
+     * @param params Parameters of the buffer
+     * @param buff Computed buffer
+     * @param samples Supersampling buffer
+     */
+    void store(const FractalParameters &params,
+               const constants::fracbuff &buff,
+               const constants::samplebuff &samples);
+
+    /**
+     * @brief Current size of all cache files in bytes
+     */
+    unsigned long long size();
+
+private:
+    std::string dir;
+    unsigned long long max_bytes;
+    unsigned long long current_bytes;
+    unsigned long tmp_counter;
+
+    std::mutex mtx;
+
+    std::string file_name(uint64_t key) const;
+    /**
+     * @brief Remove least recently used files until the limit is reached
+     *
+     * @details
+     * Must be called with mtx locked.
+     *
+     * @param keep File that must not be removed, e.g. the one just stored
+     */
+    void evict(const std::string &keep = "");
+};
+
+#endif /* ifndef RENDERCACHE_H */
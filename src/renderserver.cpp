@@ -0,0 +1,469 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "renderserver.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "fractalcrunchmulti.h"
+#include "image_rgb.h"
+
+namespace
+{
+// small tiles keep the work for a pan close to the newly exposed area
+const unsigned int server_tile_size = 64;
+// resolution of the cost map that schedules the next request
+const unsigned int costmap_cell = 16;
+// largest image a request may ask for, 4096x4096 needs about 300 MiB
+const unsigned long long max_pixels = 4096ULL * 4096ULL;
+const unsigned int max_samples = 256;
+// a request line is a few hundred bytes, longer lines are not a request
+const size_t max_request_length = 64 * 1024;
+
+/**
+ * @brief Parse an unsigned value of a request
+ *
+ * @throw std::invalid_argument if the value is not a plain decimal number
+ * that fits into an unsigned int
+ */
+unsigned int parse_uint(const std::string &key, const std::string &value)
+{
+    // std::stoul accepts signs and wraps negative values around
+    if (value.empty() || value.size() > 10 ||
+        value.find_first_not_of("0123456789") != std::string::npos)
+        throw std::invalid_argument("Invalid value for " + key);
+    unsigned long long v = std::stoull(value);
+    if (v > std::numeric_limits<unsigned int>::max())
+        throw std::invalid_argument("Value of " + key + " is too large");
+    return static_cast<unsigned int>(v);
+}
+
+template <typename T>
+std::tuple<T, T, T> parse_triple(const std::string &value)
+{
+    std::vector<std::string> elems;
+    utility::split(value, ',', elems);
+    if (elems.size() != 3)
+        throw std::invalid_argument("Expected three comma separated values");
+    return std::make_tuple(static_cast<T>(std::stod(elems.at(0))),
+                           static_cast<T>(std::stod(elems.at(1))),
+                           static_cast<T>(std::stod(elems.at(2))));
+}
+
+bool write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t written = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (written <= 0)
+            return false;
+        data += written;
+        len -= static_cast<size_t>(written);
+    }
+    return true;
+}
+}
+
+Renderserver::Renderserver(const std::shared_ptr<FractalParameters> &params,
+                           const std::shared_ptr<Printer> &prnt,
+                           const geomandel::ColorParameters &colors)
+    : params(params),
+      prnt(prnt),
+      colors(colors),
+      tpl(params->cores > 0
+              ? static_cast<int>(params->cores)
+              : static_cast<int>(
+                    std::max(std::thread::hardware_concurrency(), 1u)))
+{
+}
+
+Renderserver::~Renderserver() {}
+void Renderserver::run(const std::string &address)
+{
+    int sfd = this->listen_socket(address);
+    this->prnt << "+ Listening on " << address << " with " << this->tpl.size()
+               << " threads" << std::endl;
+
+    bool quit = false;
+    while (!quit) {
+        int cfd = ::accept(sfd, nullptr, nullptr);
+        if (cfd < 0) {
+            if (errno == EINTR)
+                continue;
+            ::close(sfd);
+            throw std::runtime_error("accept failed: " +
+                                     std::string(std::strerror(errno)));
+        }
+        this->serve_connection(cfd, quit);
+        ::close(cfd);
+    }
+    ::close(sfd);
+    if (address.find_first_not_of("0123456789") != std::string::npos)
+        ::unlink(address.c_str());
+}
+
+std::map<std::string, std::string> Renderserver::parse_json(
+    const std::string &json)
+{
+    std::map<std::string, std::string> values;
+    size_t pos = 0;
+    auto skip_ws = [&json, &pos]() {
+        while (pos < json.size() &&
+               std::isspace(static_cast<unsigned char>(json[pos])))
+            pos++;
+    };
+    auto expect = [&json, &pos, &skip_ws](char c) {
+        skip_ws();
+        if (pos >= json.size() || json[pos] != c)
+            throw std::invalid_argument(std::string("Expected '") + c + "'");
+        pos++;
+    };
+    auto parse_string = [&json, &pos, &expect]() {
+        expect('"');
+        std::string s;
+        while (pos < json.size() && json[pos] != '"') {
+            if (json[pos] == '\\' && pos + 1 < json.size())
+                pos++;
+            s += json[pos++];
+        }
+        if (pos >= json.size())
+            throw std::invalid_argument("Unterminated string");
+        pos++;
+        return s;
+    };
+
+    expect('{');
+    skip_ws();
+    if (pos < json.size() && json[pos] == '}')
+        return values;
+    while (true) {
+        std::string key = parse_string();
+        expect(':');
+        skip_ws();
+        std::string value;
+        if (pos < json.size() && json[pos] == '"') {
+            value = parse_string();
+        } else {
+            size_t end = json.find_first_of(",}", pos);
+            if (end == std::string::npos)
+                throw std::invalid_argument("Unterminated value");
+            value = json.substr(pos, end - pos);
+            value.erase(value.find_last_not_of(" \t\r\n") + 1);
+            pos = end;
+        }
+        values[key] = value;
+        skip_ws();
+        if (pos < json.size() && json[pos] == ',') {
+            pos++;
+            continue;
+        }
+        expect('}');
+        break;
+    }
+    return values;
+}
+
+std::shared_ptr<FractalParameters> Renderserver::parse_request(
+    const std::string &request, const FractalParameters &defaults,
+    geomandel::ColorParameters &colors, std::string &format)
+{
+    std::map<std::string, std::string> values = parse_json(request);
+
+    auto req_params = std::make_shared<FractalParameters>(defaults);
+    unsigned int xrange = defaults.xrange;
+    unsigned int yrange = defaults.yrange;
+    double xl = defaults.xl;
+    double xh = defaults.xh;
+    double yl = defaults.yl;
+    double yh = defaults.yh;
+    format = "ppm";
+
+    for (const auto &kv : values) {
+        const std::string &key = kv.first;
+        const std::string &val = kv.second;
+        if (key == "fractal") {
+            switch (parse_uint(key, val)) {
+            case 0:
+                req_params->set_type = constants::FRACTAL::MANDELBROT;
+                req_params->fractal_type = "mandelbrot";
+                break;
+            case 1:
+                req_params->set_type = constants::FRACTAL::TRICORN;
+                req_params->fractal_type = "tricorn";
+                break;
+            case 2:
+                req_params->set_type = constants::FRACTAL::JULIA;
+                req_params->fractal_type = "julia";
+                break;
+            case 3:
+                req_params->set_type = constants::FRACTAL::BURNING_SHIP;
+                req_params->fractal_type = "burning_ship";
+                break;
+            default:
+                throw std::invalid_argument("Fractal argument out of range");
+            }
+        } else if (key == "bailout") {
+            req_params->bailout = parse_uint(key, val);
+        } else if (key == "width") {
+            xrange = parse_uint(key, val);
+        } else if (key == "height") {
+            yrange = parse_uint(key, val);
+        } else if (key == "creal-min") {
+            xl = std::stod(val);
+        } else if (key == "creal-max") {
+            xh = std::stod(val);
+        } else if (key == "cima-min") {
+            yl = std::stod(val);
+        } else if (key == "cima-max") {
+            yh = std::stod(val);
+        } else if (key == "julia-real") {
+            req_params->julia_real = std::stod(val);
+        } else if (key == "julia-ima") {
+            req_params->julia_ima = std::stod(val);
+        } else if (key == "col-algo") {
+            unsigned long calgo = parse_uint(key, val);
+            if (calgo > constants::COL_ALGO::DISTANCE)
+                throw std::invalid_argument(
+                    "Color algorithm argument out of range");
+            req_params->col_algo = static_cast<constants::COL_ALGO>(calgo);
+        } else if (key == "supersample") {
+            req_params->aa_samples = parse_uint(key, val);
+            // every edge pixel keeps its samples in memory
+            if (req_params->aa_samples > max_samples)
+                throw std::invalid_argument("At most " +
+                                            std::to_string(max_samples) +
+                                            " samples per pixel");
+        } else if (key == "aa-threshold") {
+            req_params->aa_threshold = std::stod(val);
+        } else if (key == "rgb-base") {
+            colors.rgb_base = parse_triple<int>(val);
+        } else if (key == "set-color") {
+            colors.rgb_set_base = parse_triple<int>(val);
+        } else if (key == "rgb-freq") {
+            colors.rgb_freq = parse_triple<double>(val);
+        } else if (key == "rgb-phase") {
+            colors.rgb_phase = parse_triple<int>(val);
+        } else if (key == "rgb-amp") {
+            colors.rgb_amp = parse_triple<double>(val);
+        } else if (key == "format") {
+            if (val != "ppm" && val != "raw")
+                throw std::invalid_argument("Unknown format " + val);
+            format = val;
+        } else if (key != "cmd") {
+            throw std::invalid_argument("Unknown key " + key);
+        }
+    }
+
+    if (xrange == 0 || yrange == 0)
+        throw std::invalid_argument("Image size must not be 0");
+    if (static_cast<unsigned long long>(xrange) * yrange > max_pixels)
+        throw std::invalid_argument("Image size exceeds " +
+                                    std::to_string(max_pixels) + " pixels");
+    if (xh < xl || yh < yl)
+        throw std::invalid_argument("Maximum can not be lower than minimum");
+
+    req_params->set_complex_plane(xrange, xl, xh, yrange, yl, yh);
+    return req_params;
+}
+
+int Renderserver::listen_socket(const std::string &address)
+{
+    // ignore SIGPIPE, clients may disconnect while we write an image
+    ::signal(SIGPIPE, SIG_IGN);
+
+    int sfd = -1;
+    if (!address.empty() &&
+        address.find_first_not_of("0123456789") == std::string::npos) {
+        // a port number, only listen on the loopback device
+        sfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (sfd < 0)
+            throw std::runtime_error("Could not create socket");
+        int reuse = 1;
+        ::setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::stoul(address)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(sfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
+            0) {
+            ::close(sfd);
+            throw std::runtime_error("Could not bind to port " + address);
+        }
+    } else {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        if (address.empty() || address.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Invalid socket path " + address);
+        sfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sfd < 0)
+            throw std::runtime_error("Could not create socket");
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+        // remove a stale socket of a previous run
+        ::unlink(address.c_str());
+        if (::bind(sfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
+            0) {
+            ::close(sfd);
+            throw std::runtime_error("Could not bind to " + address);
+        }
+    }
+    if (::listen(sfd, 16) < 0) {
+        ::close(sfd);
+        throw std::runtime_error("Could not listen on " + address);
+    }
+    return sfd;
+}
+
+void Renderserver::serve_connection(int fd, bool &quit)
+{
+    std::string pending;
+    char chunk[4096];
+    while (!quit) {
+        size_t nl = pending.find('\n');
+        if (nl == std::string::npos) {
+            // a client that never sends a newline must not fill our memory
+            if (pending.size() > max_request_length) {
+                const std::string err = "ERR Request too long\n";
+                write_all(fd, err.data(), err.size());
+                return;
+            }
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return;
+            pending.append(chunk, static_cast<size_t>(n));
+            continue;
+        }
+        std::string request = pending.substr(0, nl);
+        pending.erase(0, nl + 1);
+        if (request.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        std::string header;
+        try {
+            auto values = parse_json(request);
+            if (values.count("cmd") && values.at("cmd") == "quit") {
+                quit = true;
+                write_all(fd, "OK 0\n", 5);
+                return;
+            }
+            header = this->render(request);
+        } catch (const std::exception &ex) {
+            std::string err = "ERR " + std::string(ex.what()) + "\n";
+            if (!write_all(fd, err.data(), err.size()))
+                return;
+            continue;
+        }
+        std::string status =
+            "OK " + std::to_string(header.size() + this->rgb_buf.size()) + "\n";
+        if (!write_all(fd, status.data(), status.size()) ||
+            !write_all(fd, header.data(), header.size()) ||
+            !write_all(fd, reinterpret_cast<const char *>(this->rgb_buf.data()),
+                       this->rgb_buf.size()))
+            return;
+    }
+}
+
+void Renderserver::set_cache(Rendercache *cache) { this->cache = cache; }
+void Renderserver::set_tile_cache(size_t max_bytes)
+{
+    size_t tile_bytes = static_cast<size_t>(server_tile_size) *
+                        server_tile_size * sizeof(constants::Iterations);
+    if (max_bytes < tile_bytes) {
+        this->tilecache.reset();
+        return;
+    }
+    this->tilecache = std::unique_ptr<Tilecache>(
+        new Tilecache(server_tile_size, max_bytes / tile_bytes));
+}
+
+std::string Renderserver::render(const std::string &request)
+{
+    geomandel::ColorParameters req_colors = this->colors;
+    std::string format;
+    std::shared_ptr<FractalParameters> req_params =
+        parse_request(request, *this->params, req_colors, format);
+
+    // reuse the buffers of the previous request, only the size is adjusted
+    this->buff.resize(req_params->yrange);
+    for (auto &v : this->buff) {
+        v.resize(req_params->xrange);
+    }
+    this->samples.clear();
+
+    if (this->cache == nullptr ||
+        !this->cache->load(*req_params, this->buff, this->samples)) {
+        Fractalcrunchmulti crunchi(this->buff, req_params, this->tpl);
+        // clients zoom and pan in small steps, so the cost of the previous
+        // view predicts where the expensive parts of this one are
+        if (this->tilecache) {
+            this->tilecache->set_costmap(this->costmap);
+            this->tilecache->render(this->buff, req_params, this->tpl);
+        } else {
+            crunchi.set_costmap(this->costmap);
+            crunchi.fill_buffer();
+        }
+        if (req_params->aa_samples > 0)
+            crunchi.supersample_buffer(this->samples);
+        if (this->cache != nullptr)
+            this->cache->store(*req_params, this->buff, this->samples);
+    }
+    this->costmap =
+        Costmap::from_buffer(this->buff, nullptr, *req_params, costmap_cell);
+
+    if (format == "raw") {
+        // iteration count of every pixel as 32 bit unsigned integer in host
+        // byte order, row major
+        this->rgb_buf.resize(static_cast<size_t>(req_params->xrange) *
+                             req_params->yrange * sizeof(uint32_t));
+        size_t pos = 0;
+        for (const auto &v : this->buff) {
+            for (const auto &it : v) {
+                uint32_t its = it.default_index;
+                std::memcpy(&this->rgb_buf[pos], &its, sizeof(its));
+                pos += sizeof(its);
+            }
+        }
+        return std::string();
+    }
+
+    ImageRGB img(this->buff, req_params, this->prnt, req_colors.rgb_base,
+                 req_colors.rgb_set_base, req_colors.rgb_freq,
+                 req_colors.rgb_phase, req_colors.rgb_amp);
+    img.set_samples(this->samples);
+    img.set_pool(&this->tpl);
+    // hand our buffer to the writer so its capacity is reused
+    std::swap(img.get_rgb_buffer(), this->rgb_buf);
+    img.write_buffer();
+    std::swap(img.get_rgb_buffer(), this->rgb_buf);
+    return "P6\n" + std::to_string(req_params->xrange) + " " +
+           std::to_string(req_params->yrange) + "\n255\n";
+}
@@ -0,0 +1,133 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RENDERSERVER_H
+#define RENDERSERVER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "ctpl_stl.h"
+
+#include "global.h"
+#include "costmap.h"
+#include "fractalparams.h"
+#include "geomandel.h"
+#include "printer.h"
+#include "rendercache.h"
+#include "tilecache.h"
+
+/**
+ * @brief Long running render server listening on a local socket
+ *
+ * @details
+ * Clients send one request per line as flat JSON object, e.g.
+ * {"width": 256, "height": 256, "creal-min": -0.75, "creal-max": -0.74}
+ * All keys are optional and use the names of the command line options. Values
+ * that are not part of a request are taken from the parameters the server was
+ * started with. The answer is a line "OK <bytes>" followed by the image bytes
+ * or a line "ERR <message>". Several requests may be sent over one connection,
+ * {"cmd": "quit"} stops the server.
+ *
+ * The thread pool, the iteration buffer and the RGB buffer are kept between
+ * requests, so a request only pays for the computation itself.
+ */
+class Renderserver
+{
+public:
+    Renderserver(const std::shared_ptr<FractalParameters> &params,
+                 const std::shared_ptr<Printer> &prnt,
+                 const geomandel::ColorParameters &colors);
+    virtual ~Renderserver();
+
+    /**
+     * @brief Look up requests in a render cache before computing them
+     *
+     * @param cache Render cache or nullptr to disable caching
+     */
+    void set_cache(Rendercache *cache);
+
+    /**
+     * @brief Keep computed tiles in memory so panned views only compute the
+     * newly exposed area
+     *
+     * @param max_bytes Memory limit of the tile cache, 0 disables it
+     */
+    void set_tile_cache(size_t max_bytes);
+
+    /**
+     * @brief Listen on address and serve requests until quit was received
+     *
+     * @param address A port number for localhost TCP or a path for a Unix
+     * domain socket
+     *
+     * @throw std::runtime_error if the socket can not be created
+     */
+    void run(const std::string &address);
+
+    /**
+     * @brief Parse a render request
+     *
+     * @param request Flat JSON object
+     * @param defaults Values for keys that are not part of the request
+     * @param colors Color options, updated with the values of the request
+     * @param format Output format, "ppm" or "raw"
+     *
+     * @return Fractal parameters for this request
+     *
+     * @throw std::invalid_argument if the request can not be parsed
+     */
+    static std::shared_ptr<FractalParameters> parse_request(
+        const std::string &request, const FractalParameters &defaults,
+        geomandel::ColorParameters &colors, std::string &format);
+
+    /**
+     * @brief Split a flat JSON object into key value pairs
+     *
+     * @param json
+     *
+     * @return Map with all keys and their values as strings
+     *
+     * @throw std::invalid_argument on syntax errors
+     */
+    static std::map<std::string, std::string> parse_json(
+        const std::string &json);
+
+private:
+    const std::shared_ptr<FractalParameters> &params;
+    const std::shared_ptr<Printer> &prnt;
+    geomandel::ColorParameters colors;
+
+    ctpl::thread_pool tpl;
+    constants::fracbuff buff;
+    constants::samplebuff samples;
+    constants::rgbbuff rgb_buf;
+    Rendercache *cache = nullptr;
+    std::unique_ptr<Tilecache> tilecache;
+    // cost of the previous request, schedules the jobs of the next one
+    Costmap costmap;
+
+    int listen_socket(const std::string &address);
+    void serve_connection(int fd, bool &quit);
+    std::string render(const std::string &request);
+};
+
+#endif /* ifndef RENDERSERVER_H */
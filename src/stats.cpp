@@ -0,0 +1,231 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stats.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+std::string number(double value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.6g", value);
+    return buf;
+}
+}
+
+Workerclock::Workerclock(unsigned int threads) : busy_seconds(threads, 0) {}
+void Workerclock::add(int id, clock::time_point begin)
+{
+    if (id < 0 || static_cast<size_t>(id) >= this->busy_seconds.size())
+        return;
+    this->busy_seconds[static_cast<size_t>(id)] +=
+        std::chrono::duration<double>(clock::now() - begin).count();
+}
+
+const std::vector<double> &Workerclock::busy() const
+{
+    return this->busy_seconds;
+}
+
+Jobtrace::Jobtrace(unsigned int threads)
+    : origin(clock::now()), thread_jobs(threads)
+{
+}
+
+void Jobtrace::add(int id, const std::string &category, unsigned int row,
+                   clock::time_point queued, clock::time_point begin,
+                   unsigned long long iterations)
+{
+    if (id < 0 || static_cast<size_t>(id) >= this->thread_jobs.size())
+        return;
+    Job job;
+    job.category = category;
+    job.row = row;
+    job.queued = queued;
+    job.begin = begin;
+    job.end = clock::now();
+    job.iterations = iterations;
+    this->thread_jobs[static_cast<size_t>(id)].push_back(job);
+}
+
+const std::vector<Jobtrace::Job> &Jobtrace::jobs(unsigned int thread) const
+{
+    return this->thread_jobs.at(thread);
+}
+
+void Jobtrace::write(const std::string &filename) const
+{
+    std::ofstream out(filename, std::ofstream::out | std::ofstream::trunc);
+    if (!out.is_open())
+        throw std::runtime_error("Could not open trace file " + filename);
+
+    // microseconds with a fixed precision, %g would switch to exponents for
+    // long runs
+    auto duration = [](clock::time_point from, clock::time_point to) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3f",
+                      std::chrono::duration<double, std::micro>(to - from)
+                          .count());
+        return std::string(buf);
+    };
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (size_t tid = 0; tid < this->thread_jobs.size(); tid++) {
+        out << (tid == 0 ? "\n" : ",\n");
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            << "\"tid\": " << tid << ", \"args\": {\"name\": \"worker "
+            << tid << "\"}}";
+        for (const Job &job : this->thread_jobs[tid]) {
+            // complete events, the time a job waited in the queue is an
+            // argument so stalls are visible in the event details
+            out << ",\n{\"name\": \"" << job.category << " row " << job.row
+                << "\", \"cat\": \"" << job.category
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+                << ", \"ts\": " << duration(this->origin, job.begin)
+                << ", \"dur\": " << duration(job.begin, job.end)
+                << ", \"args\": {\"row\": " << job.row
+                << ", \"iterations\": " << job.iterations
+                << ", \"queued_us\": "
+                << duration(job.queued, job.begin) << "}}";
+        }
+    }
+    out << "\n]}" << std::endl;
+    if (!out.good())
+        throw std::runtime_error("Could not write trace file " + filename);
+}
+
+Runstats::Runstats() : run_begin(Workerclock::clock::now()) {}
+void Runstats::begin(const std::string &name)
+{
+    Phase phase;
+    phase.name = name;
+    this->phase_list.push_back(phase);
+    this->arena_begin = Bufferarena::instance().counters();
+    this->phase_begin = Workerclock::clock::now();
+}
+
+Runstats::Phase &Runstats::end()
+{
+    Phase &phase = this->phase_list.back();
+    phase.seconds = std::chrono::duration<double>(Workerclock::clock::now() -
+                                                  this->phase_begin)
+                        .count();
+    phase.peak_rss_kib = Runstats::peak_rss_kib();
+    Bufferarena::Counters arena = Bufferarena::instance().counters();
+    phase.allocations = arena.allocations - this->arena_begin.allocations;
+    phase.reused = arena.reused - this->arena_begin.reused;
+    return phase;
+}
+
+const std::vector<Runstats::Phase> &Runstats::phases() const
+{
+    return this->phase_list;
+}
+
+unsigned long long Runstats::peak_rss_kib()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    // bytes on OS X, KiB everywhere else
+    return static_cast<unsigned long long>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<unsigned long long>(usage.ru_maxrss);
+#endif
+#else
+    return 0;
+#endif
+}
+
+std::string Runstats::json() const
+{
+    std::stringstream out;
+    double total = std::chrono::duration<double>(Workerclock::clock::now() -
+                                                 this->run_begin)
+                       .count();
+    Bufferarena::Counters arena = Bufferarena::instance().counters();
+    out << "{\"seconds\": " << number(total)
+        << ", \"peak_rss_kib\": " << Runstats::peak_rss_kib()
+        << ", \"allocations\": " << arena.allocations
+        << ", \"reused_allocations\": " << arena.reused
+        << ", \"arena_mapped_bytes\": " << arena.mapped_bytes
+        << ", \"phases\": [";
+    for (size_t i = 0; i < this->phase_list.size(); i++) {
+        const Phase &p = this->phase_list[i];
+        out << (i == 0 ? "" : ", ") << "{\"name\": \"" << p.name
+            << "\", \"seconds\": " << number(p.seconds)
+            << ", \"iterations\": " << p.iterations
+            << ", \"pixels\": " << p.pixels;
+        if (p.seconds > 0) {
+            out << ", \"pixels_per_second\": " << number(p.pixels / p.seconds)
+                << ", \"iterations_per_second\": "
+                << number(p.iterations / p.seconds);
+        }
+        out << ", \"peak_rss_kib\": " << p.peak_rss_kib
+            << ", \"allocations\": " << p.allocations
+            << ", \"reused_allocations\": " << p.reused
+            << ", \"threads\": [";
+        for (size_t t = 0; t < p.busy.size(); t++) {
+            double idle = p.seconds > p.busy[t] ? p.seconds - p.busy[t] : 0;
+            out << (t == 0 ? "" : ", ") << "{\"busy\": " << number(p.busy[t])
+                << ", \"idle\": " << number(idle) << "}";
+        }
+        out << "]}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+std::string Runstats::text() const
+{
+    std::stringstream out;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-12s %10s %14s %14s %11s %13s %s\n",
+                  "phase", "ms", "pixels/s", "iterations/s", "rss KiB",
+                  "allocs/reused", "busy/idle ms per thread");
+    out << line;
+    for (const Phase &p : this->phase_list) {
+        double pps = p.seconds > 0 ? p.pixels / p.seconds : 0;
+        double ips = p.seconds > 0 ? p.iterations / p.seconds : 0;
+        std::string allocs =
+            std::to_string(p.allocations) + "/" + std::to_string(p.reused);
+        std::snprintf(line, sizeof(line),
+                      "%-12s %10.1f %14.4g %14.4g %11llu %13s",
+                      p.name.c_str(), p.seconds * 1000, pps, ips,
+                      p.peak_rss_kib, allocs.c_str());
+        out << line;
+        for (double busy : p.busy) {
+            double idle = p.seconds > busy ? p.seconds - busy : 0;
+            std::snprintf(line, sizeof(line), " %.1f/%.1f", busy * 1000,
+                          idle * 1000);
+            out << line;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,180 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "bufferarena.h"
+
+/**
+ * @brief Busy time of the worker threads of a thread pool
+ *
+ * @details
+ * Jobs add the time they ran to the slot of their thread id. Every slot is
+ * only written by one thread and read after all jobs were waited for, so no
+ * locking is needed.
+ */
+class Workerclock
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit Workerclock(unsigned int threads);
+
+    /**
+     * @brief Account the runtime of a job
+     *
+     * @param id Thread id as passed to the job by ctpl
+     * @param begin Time the job started
+     *
+     * @details
+     * Ids outside of the number of threads given to the constructor are
+     * ignored.
+     */
+    void add(int id, clock::time_point begin);
+
+    /**
+     * @brief Busy seconds of every thread
+     */
+    const std::vector<double> &busy() const;
+
+private:
+    std::vector<double> busy_seconds;
+};
+
+/**
+ * @brief Per job timeline of the worker threads of a thread pool
+ *
+ * @details
+ * Like Workerclock every thread appends to its own list, so jobs can record
+ * themselves without locking. The timeline is exported in the Chrome trace
+ * event format that can be loaded in chrome://tracing or Perfetto.
+ */
+class Jobtrace
+{
+public:
+    typedef Workerclock::clock clock;
+
+    struct Job {
+        std::string category;
+        unsigned int row;
+        clock::time_point queued;
+        clock::time_point begin;
+        clock::time_point end;
+        unsigned long long iterations;
+    };
+
+    explicit Jobtrace(unsigned int threads);
+
+    /**
+     * @brief Record a finished job
+     *
+     * @param id Thread id as passed to the job by ctpl
+     * @param category Phase the job belongs to, e.g. compute
+     * @param row Image row the job computed
+     * @param queued Time the job was pushed to the pool
+     * @param begin Time a worker started the job
+     * @param iterations Iterations the job computed
+     *
+     * @details
+     * The job ends now. Ids outside of the number of threads are ignored.
+     */
+    void add(int id, const std::string &category, unsigned int row,
+             clock::time_point queued, clock::time_point begin,
+             unsigned long long iterations);
+
+    /**
+     * @brief Jobs of one worker thread in the order they ran
+     */
+    const std::vector<Job> &jobs(unsigned int thread) const;
+
+    /**
+     * @brief Write the trace as Chrome trace event json
+     *
+     * @param filename
+     *
+     * @throws std::runtime_error if the file can not be written
+     */
+    void write(const std::string &filename) const;
+
+private:
+    clock::time_point origin;
+    std::vector<std::vector<Job>> thread_jobs;
+};
+
+/**
+ * @brief Timing and throughput of the phases of one run
+ *
+ * @details
+ * Phases are measured with begin and end. The caller may add the number of
+ * iterations, pixels and the worker busy times to the phase end returns.
+ * Frame buffer allocations are counted automatically.
+ */
+class Runstats
+{
+public:
+    struct Phase {
+        std::string name;
+        double seconds = 0;
+        unsigned long long iterations = 0;
+        unsigned long long pixels = 0;
+        // busy seconds per worker thread, empty for phases on the main thread
+        std::vector<double> busy;
+        // peak resident set size of the process at the end of the phase
+        unsigned long long peak_rss_kib = 0;
+        // frame buffer allocations of the phase and how many of them reused
+        // a block of the Bufferarena
+        unsigned long long allocations = 0;
+        unsigned long long reused = 0;
+    };
+
+    Runstats();
+
+    void begin(const std::string &name);
+    Phase &end();
+
+    const std::vector<Phase> &phases() const;
+
+    /**
+     * @brief Peak resident set size of this process in KiB
+     *
+     * @return 0 if the platform does not provide it
+     */
+    static unsigned long long peak_rss_kib();
+
+    /**
+     * @brief Report as json object
+     */
+    std::string json() const;
+    /**
+     * @brief Report as human readable table
+     */
+    std::string text() const;
+
+private:
+    std::vector<Phase> phase_list;
+    Workerclock::clock::time_point phase_begin;
+    Workerclock::clock::time_point run_begin;
+    Bufferarena::Counters arena_begin;
+};
+
+#endif /* ifndef STATS_H */
@@ -38,3 +38,14 @@ constants::Iterations FractalcruncherMock::test_iterfactory(unsigned int its,
 {
     return this->iterations_factory(its, z_real, z_ima);
 }
+
+constants::Iterations FractalcruncherMock::test_distance(
+    double real, double ima, unsigned int bailout) const
+{
+    return this->crunch_distance(real, ima, bailout);
+}
+
+bool FractalcruncherMock::test_is_edge(unsigned int ix, unsigned int iy) const
+{
+    return this->is_edge_pixel(ix, iy);
+}
@@ -35,6 +35,9 @@ public:
         double real, double ima, unsigned int bailout) const;
     constants::Iterations test_iterfactory(unsigned int its, double z_real,
                                            double z_ima) const;
+    constants::Iterations test_distance(double real, double ima,
+                                        unsigned int bailout) const;
+    bool test_is_edge(unsigned int ix, unsigned int iy) const;
 
 private:
     /* data */
@@ -22,6 +22,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "main_helper.h"
 #include "fractalparams.h"
 #include "fractalzoom.h"
+#ifdef HAVE_RENDERSERVER
+#include "renderserver.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 #include <iostream>
 #include <vector>
@@ -176,3 +186,216 @@ TEST_CASE("Command line arguments", "[commandline]")
         REQUIRE(params != nullptr);
     }
 }
+
+#ifdef HAVE_RENDERSERVER
+/**
+ * @brief Minimal client for a render server on a Unix domain socket
+ */
+class Serverclient
+{
+public:
+    explicit Serverclient(const std::string &path) : fd(-1)
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        // the server thread might not listen yet
+        for (int i = 0; i < 200 && this->fd < 0; i++) {
+            this->fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (::connect(this->fd, reinterpret_cast<sockaddr *>(&addr),
+                          sizeof(addr)) != 0) {
+                ::close(this->fd);
+                this->fd = -1;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+    }
+    ~Serverclient() { this->close(); }
+    /**
+     * @brief Close the connection, the server serves one client at a time
+     */
+    void close()
+    {
+        if (this->fd >= 0)
+            ::close(this->fd);
+        this->fd = -1;
+    }
+
+    bool connected() const { return this->fd >= 0; }
+    bool send(const std::string &data)
+    {
+        return ::send(this->fd, data.data(), data.size(), MSG_NOSIGNAL) ==
+               static_cast<ssize_t>(data.size());
+    }
+
+    /**
+     * @brief Read the status line and the payload of an answer
+     *
+     * @return Status line, empty if the connection was closed
+     */
+    std::string answer(std::vector<char> &payload)
+    {
+        std::string status;
+        char c;
+        while (::recv(this->fd, &c, 1, 0) == 1 && c != '\n')
+            status.push_back(c);
+        payload.clear();
+        if (status.compare(0, 3, "OK ") != 0)
+            return status;
+        payload.resize(std::stoul(status.substr(3)));
+        size_t pos = 0;
+        while (pos < payload.size()) {
+            ssize_t n = ::recv(this->fd, payload.data() + pos,
+                               payload.size() - pos, 0);
+            if (n <= 0)
+                return std::string();
+            pos += static_cast<size_t>(n);
+        }
+        return status;
+    }
+
+private:
+    int fd;
+};
+
+TEST_CASE("Render server requests", "[commandline]")
+{
+    auto parser = generate_empty_parser();
+    const char *test_argv[] = {"Unittester", "-b", "500"};
+    int test_argc = 3;
+    char **cxxopt_pointer = const_cast<char **>(test_argv);
+    parser.parse(test_argc, cxxopt_pointer);
+    std::shared_ptr<FractalParameters> defaults = nullptr;
+    init_mandel_parameters(defaults, parser);
+    REQUIRE(defaults != nullptr);
+
+    geomandel::ColorParameters colors;
+    std::string format;
+
+    SECTION("Values of the request override the defaults")
+    {
+        auto params = Renderserver::parse_request(
+            "{\"width\": 64, \"height\":32, \"fractal\": 2, "
+            "\"creal-min\": -0.5, \"set-color\": \"1,2,3\", "
+            "\"format\": \"raw\"}",
+            *defaults, colors, format);
+        REQUIRE(params->xrange == 64);
+        REQUIRE(params->yrange == 32);
+        REQUIRE(params->set_type == constants::FRACTAL::JULIA);
+        REQUIRE(params->fractal_type == "julia");
+        REQUIRE(params->xl == Catch::Detail::Approx(-0.5));
+        REQUIRE(params->xdelta == Catch::Detail::Approx(1.5 / 64));
+        REQUIRE(params->bailout == 500);
+        REQUIRE(std::get<2>(colors.rgb_set_base) == 3);
+        REQUIRE(format == "raw");
+    }
+
+    SECTION("Invalid requests are rejected")
+    {
+        REQUIRE_THROWS(Renderserver::parse_request("{\"width\": 64", *defaults,
+                                                   colors, format));
+        REQUIRE_THROWS(Renderserver::parse_request("{\"unknown\": 1}",
+                                                   *defaults, colors, format));
+        REQUIRE_THROWS(Renderserver::parse_request(
+            "{\"creal-min\": 2, \"creal-max\": 1}", *defaults, colors,
+            format));
+        REQUIRE_THROWS(Renderserver::parse_request("{\"width\": 0}",
+                                                   *defaults, colors, format));
+        // std::stoul would wrap these around to huge sizes
+        REQUIRE_THROWS(Renderserver::parse_request("{\"width\": -1}",
+                                                   *defaults, colors, format));
+        REQUIRE_THROWS(Renderserver::parse_request("{\"height\": \"+5\"}",
+                                                   *defaults, colors, format));
+        REQUIRE_THROWS(Renderserver::parse_request(
+            "{\"width\": 99999999999}", *defaults, colors, format));
+        REQUIRE_THROWS(Renderserver::parse_request(
+            "{\"width\": 100000, \"height\": 100000}", *defaults, colors,
+            format));
+        REQUIRE_THROWS(Renderserver::parse_request(
+            "{\"supersample\": 100000}", *defaults, colors, format));
+        REQUIRE_THROWS(Renderserver::parse_request("{\"bailout\": 1e3}",
+                                                   *defaults, colors, format));
+    }
+}
+
+TEST_CASE("Render server", "[commandline]")
+{
+    auto parser = generate_empty_parser();
+    const char *test_argv[] = {"Unittester", "-b", "200", "-m", "2"};
+    int test_argc = 5;
+    char **cxxopt_pointer = const_cast<char **>(test_argv);
+    parser.parse(test_argc, cxxopt_pointer);
+    std::shared_ptr<FractalParameters> defaults = nullptr;
+    init_mandel_parameters(defaults, parser);
+    REQUIRE(defaults != nullptr);
+    std::shared_ptr<Printer> prnt = std::make_shared<Printer>(true);
+
+    std::string path =
+        "/tmp/geomandel_test_" + std::to_string(::getpid()) + ".sock";
+    Renderserver server(defaults, prnt, geomandel::ColorParameters());
+    // the default configuration of the command line with a tile cache
+    server.set_tile_cache(256 * 1024 * 1024);
+    std::thread runner([&server, &path]() { server.run(path); });
+
+    Serverclient client(path);
+    REQUIRE(client.connected());
+    std::vector<char> payload;
+
+    SECTION("Views are computed with the tile cache")
+    {
+        // a zoom sequence, every view is scheduled with the cost of the one
+        // before it
+        const double views[3][4] = {{-2.0, 1.0, -1.5, 1.5},
+                                    {-1.5, 0.5, -1.0, 1.0},
+                                    {-1.0, 0.0, -0.5, 0.5}};
+        for (const auto &v : views) {
+            std::string request =
+                "{\"width\": 64, \"height\": 48, \"format\": \"raw\", "
+                "\"creal-min\": " + std::to_string(v[0]) +
+                ", \"creal-max\": " + std::to_string(v[1]) +
+                ", \"cima-min\": " + std::to_string(v[2]) +
+                ", \"cima-max\": " + std::to_string(v[3]) + "}\n";
+            REQUIRE(client.send(request));
+            REQUIRE(client.answer(payload) ==
+                    "OK " + std::to_string(64 * 48 * sizeof(uint32_t)));
+
+            auto params = std::make_shared<FractalParameters>(*defaults);
+            params->set_complex_plane(64, v[0], v[1], 48, v[2], v[3]);
+            constants::fracbuff ref = geomandel::create_buffer(*params);
+            geomandel::render(ref, params);
+            // tiles are computed on a grid, a few pixels right at the border
+            // of the set might differ by one iteration
+            unsigned int differing = 0;
+            for (unsigned int iy = 0; iy < 48; iy++) {
+                for (unsigned int ix = 0; ix < 64; ix++) {
+                    uint32_t its;
+                    std::memcpy(&its,
+                                payload.data() +
+                                    (iy * 64 + ix) * sizeof(uint32_t),
+                                sizeof(its));
+                    if (its != ref[iy][ix].default_index)
+                        differing++;
+                }
+            }
+            REQUIRE(differing < 10);
+        }
+    }
+
+    SECTION("Overlong requests close the connection")
+    {
+        // the server closes the connection before all of it was sent
+        std::string flood(16 * 1024, ' ');
+        for (int i = 0; i < 16 && client.send(flood); i++) {
+        }
+        REQUIRE(client.answer(payload) == "ERR Request too long");
+        REQUIRE(client.answer(payload).empty());
+    }
+
+    client.close();
+    Serverclient closer(path);
+    REQUIRE(closer.send("{\"cmd\": \"quit\"}\n"));
+    closer.answer(payload);
+    runner.join();
+}
+#endif
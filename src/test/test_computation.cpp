@@ -18,15 +18,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "catch.hpp"
+#include "bufferarena.h"
+#include "costmap.h"
 
+#include "formula.h"
 #include "fractalzoom.h"
+#include "geomandel.h"
 #include "global.h"
+#include "newton.h"
 
 #include "fractalcruncher_mock.h"
+#include "fractalcrunchboundary.h"
+#include "fractalcrunchmulti.h"
+#include "fractalcrunchprogressive.h"
+#include "fractalcrunchsingle.h"
+#include "numa.h"
+#include "tilecache.h"
+#include "stats.h"
+#include "tilerenderer.h"
 
 /**
  * @brief Fills a vector<int> with escape time integers.
@@ -502,3 +519,957 @@ TEST_CASE("Test computation of continuous index", "[computation]")
                 Catch::Detail::Approx(55.69450318630743));
     }
 }
+
+TEST_CASE("Test distance estimation", "[computation]")
+{
+    // the estimate shares its memory with the continuous index
+    REQUIRE(sizeof(constants::Iterations) == 16);
+    constants::fracbuff b;
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>();
+    params->set_type = constants::FRACTAL::MANDELBROT;
+    params->col_algo = constants::COL_ALGO::DISTANCE;
+    FractalcruncherMock crunch_test(b, params);
+
+    SECTION("Escape time does not change")
+    {
+        for (double x = -2.4; x < 1.0; x += 0.17) {
+            for (double y = -1.3; y < 1.3; y += 0.23) {
+                auto it = crunch_test.test_distance(x, y, 200);
+                auto its = crunch_test.test_cruncher(x, y, 200);
+                REQUIRE(it.default_index == std::get<0>(its));
+                REQUIRE(it.cost >= it.default_index);
+            }
+        }
+    }
+
+    SECTION("Points of the set have no distance")
+    {
+        REQUIRE(crunch_test.test_distance(0, 0, 500).distance == 0);
+        REQUIRE(crunch_test.test_distance(-1, 0, 500).distance == 0);
+    }
+
+    SECTION("Distance is close to the true distance")
+    {
+        // the set touches the real axis at -2 and 0.25
+        auto left = crunch_test.test_distance(-2.5, 0, 500);
+        REQUIRE(left.distance == Approx(0.5).epsilon(0.1));
+        // close to the cusp at 0.25 the estimate is a lot smaller than the
+        // true distance but never larger
+        auto right = crunch_test.test_distance(0.3, 0, 500);
+        REQUIRE(right.distance > 0);
+        REQUIRE(right.distance < 0.05);
+        auto far = crunch_test.test_distance(0.35, 0, 500);
+        REQUIRE(far.distance > right.distance);
+    }
+
+    SECTION("Single and multi core engine agree")
+    {
+        params->xrange = 120;
+        params->yrange = 90;
+        params->set_complex_plane(120, -2.5, 1.0, 90, -1.5, 1.5);
+        params->bailout = 100;
+        constants::fracbuff single_buff(params->yrange,
+                                        constants::fracrow(params->xrange));
+        constants::fracbuff multi_buff(params->yrange,
+                                       constants::fracrow(params->xrange));
+        Fractalcrunchsingle single(single_buff, params);
+        single.fill_buffer();
+        params->cores = 3;
+        Fractalcrunchmulti multi(multi_buff, params);
+        multi.fill_buffer();
+        unsigned int outside = 0;
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(single_buff[iy][ix].default_index ==
+                        multi_buff[iy][ix].default_index);
+                REQUIRE(single_buff[iy][ix].distance ==
+                        multi_buff[iy][ix].distance);
+                if (single_buff[iy][ix].distance > 0)
+                    outside++;
+            }
+        }
+        REQUIRE(outside > 0);
+    }
+}
+
+TEST_CASE("Test boundary tracing", "[computation]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 400, -2.5, 1.0, 300, -1.5, 1.5,
+            -0.8, 0.156, 50, 0, 0, 0, "", "mandelbrot", 3,
+            constants::COL_ALGO::ESCAPE_TIME);
+    params->boundary = 64;
+    constants::fracbuff reference(params->yrange,
+                                  constants::fracrow(params->xrange));
+    Fractalcrunchsingle single(reference, params);
+    single.fill_buffer();
+
+    SECTION("Escape time matches the single core engine")
+    {
+        constants::fracbuff b(params->yrange,
+                              constants::fracrow(params->xrange));
+        Fractalcrunchboundary crunchi(b, params);
+        crunchi.fill_buffer();
+        unsigned long long pixels =
+            static_cast<unsigned long long>(params->xrange) * params->yrange;
+        unsigned long long cost = 0;
+        unsigned long long reference_cost = 0;
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(b[iy][ix].default_index ==
+                        reference[iy][ix].default_index);
+                cost += b[iy][ix].cost;
+                reference_cost += reference[iy][ix].cost;
+            }
+        }
+        // the overview is dominated by wide bands and the set, filled pixels
+        // cost nothing
+        REQUIRE(crunchi.computed_pixels() < pixels / 2);
+        REQUIRE(cost < reference_cost / 2);
+    }
+
+    SECTION("Region size does not change the result")
+    {
+        params->boundary = 7;
+        constants::fracbuff b(params->yrange,
+                              constants::fracrow(params->xrange));
+        Fractalcrunchboundary crunchi(b, params);
+        crunchi.fill_buffer();
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(b[iy][ix].default_index ==
+                        reference[iy][ix].default_index);
+            }
+        }
+    }
+
+    SECTION("The library render function traces boundaries")
+    {
+        params->cores = 0;
+        constants::fracbuff b = geomandel::create_buffer(*params);
+        geomandel::render(b, params);
+        unsigned long long cost = 0;
+        unsigned long long reference_cost = 0;
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(b[iy][ix].default_index ==
+                        reference[iy][ix].default_index);
+                cost += b[iy][ix].cost;
+                reference_cost += reference[iy][ix].cost;
+            }
+        }
+        REQUIRE(cost < reference_cost / 2);
+    }
+
+    SECTION("Colorings that change inside a band are rejected")
+    {
+        params->col_algo = constants::COL_ALGO::CONTINUOUS_SINE;
+        constants::fracbuff b;
+        REQUIRE_THROWS_AS(Fractalcrunchboundary(b, params),
+                          std::invalid_argument &);
+        REQUIRE(Fractalcrunchboundary::supports(
+            constants::COL_ALGO::CONTINUOUS_BERN));
+        REQUIRE_FALSE(
+            Fractalcrunchboundary::supports(constants::COL_ALGO::DISTANCE));
+    }
+}
+
+TEST_CASE("Test iteration formulas", "[computation]")
+{
+    SECTION("Syntax errors report the position")
+    {
+        REQUIRE_THROWS_AS(Formula("z^^2 + c"), std::invalid_argument &);
+        REQUIRE_THROWS_AS(Formula("(z + c"), std::invalid_argument &);
+        REQUIRE_THROWS_AS(Formula("tan(z) + c"), std::invalid_argument &);
+        REQUIRE_THROWS_AS(Formula(""), std::invalid_argument &);
+        std::string msg;
+        try {
+            Formula("z^2 + x");
+        } catch (const std::invalid_argument &ex) {
+            msg = ex.what();
+        }
+        REQUIRE(msg.find("position 7") != std::string::npos);
+    }
+
+    SECTION("Powers of z run on a native kernel")
+    {
+        REQUIRE(Formula("z^3 + c").kernel() == Formula::POWER);
+        REQUIRE(Formula("z*z + c").kernel() == Formula::POWER);
+        REQUIRE(Formula("c + conj(z)^2").kernel() == Formula::CONJ_POWER);
+        REQUIRE(Formula("fold(z)^2 + c").kernel() == Formula::BYTECODE);
+    }
+
+    SECTION("Operations are fused and constants are folded")
+    {
+        // the conjugate, the square and the sum are one instruction
+        REQUIRE(Formula("conj(z)^2 + 0.5*c").instructions() == 1);
+        REQUIRE(Formula("z^2 + (1 + 2) * c - 1").instructions() == 2);
+        REQUIRE(Formula("z * (c + 1) + c").instructions() == 1);
+    }
+
+    SECTION("Bytecode computes the same values as complex arithmetic")
+    {
+        Formula f("(z^2 + c) / (z - 1) + exp(z) * 2i - z^-3 + z^1.5");
+        std::complex<double> z(0.3, -0.7);
+        std::complex<double> c(-0.4, 0.2);
+        std::complex<double> i(0, 1);
+        std::complex<double> expected =
+            (z * z + c) / (z - 1.0) + std::exp(z) * 2.0 * i -
+            1.0 / (z * z * z) + std::pow(z, 1.5);
+        std::complex<double> result = f.evaluate(z, c);
+        REQUIRE(result.real() == Approx(expected.real()));
+        REQUIRE(result.imag() == Approx(expected.imag()));
+    }
+
+    SECTION("Formulas of the built in fractals give the same escape times")
+    {
+        std::vector<std::pair<constants::FRACTAL, std::string>> builtin = {
+            {constants::FRACTAL::MANDELBROT, "z^2 + c"},
+            {constants::FRACTAL::TRICORN, "conj(z)^2 + c"},
+            {constants::FRACTAL::BURNING_SHIP, "fold(z)^2 + c"}};
+        for (const auto &b : builtin) {
+            std::shared_ptr<FractalParameters> params =
+                std::make_shared<FractalParameters>(
+                    b.first, 120, -2.5, 1.5, 90, -2.0, 1.0, -0.8, 0.156, 200,
+                    0, 0, 0, "", "formula", 1,
+                    constants::COL_ALGO::CONTINUOUS_SINE);
+            constants::fracbuff native(params->yrange,
+                                       constants::fracrow(params->xrange));
+            Fractalcrunchsingle crunch_native(native, params);
+            crunch_native.fill_buffer();
+
+            params->set_type = constants::FRACTAL::FORMULA;
+            params->formula = std::make_shared<const Formula>(b.second);
+            constants::fracbuff formula(params->yrange,
+                                        constants::fracrow(params->xrange));
+            Fractalcrunchsingle crunch_formula(formula, params);
+            crunch_formula.fill_buffer();
+            for (unsigned int iy = 0; iy < params->yrange; iy++) {
+                for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                    REQUIRE(formula[iy][ix].default_index ==
+                            native[iy][ix].default_index);
+                    REQUIRE(formula[iy][ix].continous_index ==
+                            native[iy][ix].continous_index);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Test Newton fractal", "[computation]")
+{
+    SECTION("Invalid polynomials are rejected")
+    {
+        REQUIRE_THROWS_AS(Newton("1,x,1"), std::invalid_argument &);
+        REQUIRE_THROWS_AS(Newton("0,0,1,2"), std::invalid_argument &);
+        REQUIRE_THROWS_AS(Newton(""), std::invalid_argument &);
+        REQUIRE(Newton("0,1i,0,-1").degree() == 2);
+    }
+
+    SECTION("The roots of unity are found")
+    {
+        Newton newton("1,0,0,-1");
+        REQUIRE(newton.degree() == 3);
+        REQUIRE(newton.roots().size() == 3);
+        for (const auto &r : newton.roots()) {
+            REQUIRE(std::abs(r * r * r - 1.0) < 1e-9);
+        }
+    }
+
+    SECTION("Start values close to a root converge to its basin")
+    {
+        Newton newton("1,-2i,3,-1+0.5i");
+        for (unsigned int i = 0; i < newton.roots().size(); i++) {
+            std::complex<double> r = newton.roots()[i];
+            constants::Iterations it =
+                newton.iterate(r.real() + 1e-3, r.imag() - 1e-3, 50);
+            REQUIRE(it.default_index < 10);
+            REQUIRE(it.basin == i);
+        }
+    }
+
+    SECTION("The vectorized kernel gives the same results")
+    {
+        Newton newton("1,0,0,0,0,-1");
+        const size_t n = 37;
+        std::vector<double> xs(n);
+        for (size_t k = 0; k < n; k++)
+            xs[k] = -1.5 + 0.08 * k;
+        std::vector<constants::Iterations> span(n);
+        newton.iterate_span(xs.data(), 0.3, n, 40, span.data());
+        for (size_t k = 0; k < n; k++) {
+            constants::Iterations single = newton.iterate(xs[k], 0.3, 40);
+            REQUIRE(span[k].default_index == single.default_index);
+            REQUIRE(span[k].basin == single.basin);
+            REQUIRE(span[k].cost == single.cost);
+        }
+    }
+
+    SECTION("Single and multi core engines agree")
+    {
+        std::shared_ptr<FractalParameters> params =
+            std::make_shared<FractalParameters>(
+                constants::FRACTAL::NEWTON, 101, -2.0, 2.0, 75, -1.5, 1.5,
+                -0.8, 0.156, 60, 0, 0, 0, "", "newton", 3,
+                constants::COL_ALGO::ESCAPE_TIME);
+        params->newton = std::make_shared<const Newton>("1,0,0,-1");
+        constants::fracbuff single(params->yrange,
+                                   constants::fracrow(params->xrange));
+        constants::fracbuff multi(params->yrange,
+                                  constants::fracrow(params->xrange));
+        Fractalcrunchsingle crunch_single(single, params);
+        crunch_single.fill_buffer();
+        Fractalcrunchmulti crunch_multi(multi, params);
+        crunch_multi.fill_buffer();
+        unsigned int basins[3] = {0, 0, 0};
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(single[iy][ix].default_index ==
+                        multi[iy][ix].default_index);
+                REQUIRE(single[iy][ix].basin == multi[iy][ix].basin);
+                if (single[iy][ix].default_index < params->bailout)
+                    basins[single[iy][ix].basin]++;
+            }
+        }
+        // z^3 - 1 is symmetric, every basin covers about a third of the plane
+        for (unsigned int b : basins)
+            REQUIRE(b > params->xrange * params->yrange / 4);
+    }
+
+    SECTION("Supersampling refines the borders of the basins")
+    {
+        // there is no continuous index, the default coloring must not hide
+        // the edges
+        std::shared_ptr<FractalParameters> params =
+            std::make_shared<FractalParameters>(
+                constants::FRACTAL::NEWTON, 60, -2.0, 2.0, 45, -1.5, 1.5, -0.8,
+                0.156, 60, 0, 0, 0, "", "newton", 0,
+                constants::COL_ALGO::CONTINUOUS_SINE);
+        params->newton = std::make_shared<const Newton>("1,0,0,-1");
+        params->aa_samples = 4;
+        params->aa_threshold = 1000;
+        constants::fracbuff b(params->yrange,
+                              constants::fracrow(params->xrange));
+        Fractalcrunchsingle crunchi(b, params);
+        crunchi.fill_buffer();
+        constants::samplebuff samples;
+        crunchi.supersample_buffer(samples);
+        // the threshold is too high for the iteration counts, every basin
+        // border is found by its basin alone
+        unsigned int borders = 0;
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix + 1 < params->xrange; ix++) {
+                if (b[iy][ix].basin == b[iy][ix + 1].basin)
+                    continue;
+                borders++;
+                REQUIRE(samples.count(iy * params->xrange + ix) == 1);
+                REQUIRE(samples.count(iy * params->xrange + ix + 1) == 1);
+            }
+        }
+        REQUIRE(borders > 0);
+    }
+}
+
+TEST_CASE("Test adaptive supersampling of edge pixels", "[computation]")
+{
+    constants::fracbuff b;
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 30, -2.5, 1.0, 30, -1.5, 1.5, -0.8,
+            0.156, 50, 0, 0, 0, "", "mandelbrot", 0,
+            constants::COL_ALGO::ESCAPE_TIME);
+    params->aa_samples = 4;
+    params->aa_threshold = 2.0;
+    FractalcruncherMock crunch_test_aa(b, params);
+
+    // first pass with one sample per pixel
+    b.assign(params->yrange, constants::fracrow());
+    for (unsigned int iy = 0; iy < params->yrange; iy++) {
+        for (unsigned int ix = 0; ix < params->xrange; ix++) {
+            auto crunched = crunch_test_aa.test_cruncher(
+                params->x + ix * params->xdelta, params->y + iy * params->ydelta,
+                params->bailout);
+            b[iy].push_back(crunch_test_aa.test_iterfactory(
+                std::get<0>(crunched), std::get<1>(crunched),
+                std::get<2>(crunched)));
+        }
+    }
+
+    constants::samplebuff samples;
+    crunch_test_aa.supersample_buffer(samples);
+
+    SECTION("Only edge pixels get additional samples")
+    {
+        REQUIRE(!samples.empty());
+        REQUIRE(samples.size() < params->xrange * params->yrange);
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                auto it = samples.find(iy * params->xrange + ix);
+                REQUIRE((it != samples.end()) ==
+                        crunch_test_aa.test_is_edge(ix, iy));
+                if (it != samples.end())
+                    REQUIRE(it->second.size() == params->aa_samples);
+            }
+        }
+    }
+
+    SECTION("Jittered samples are reproducible")
+    {
+        constants::samplebuff samples_second;
+        crunch_test_aa.supersample_buffer(samples_second);
+        REQUIRE(samples_second.size() == samples.size());
+        for (const auto &s : samples) {
+            const auto &other = samples_second.at(s.first);
+            for (unsigned int i = 0; i < s.second.size(); i++) {
+                REQUIRE(s.second[i].default_index == other[i].default_index);
+            }
+        }
+    }
+}
+
+TEST_CASE("Test progressive multi resolution rendering", "[computation]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 37, -2.5, 1.0, 29, -1.5, 1.5, -0.8,
+            0.156, 60, 0, 0, 0, "", "mandelbrot", 2,
+            constants::COL_ALGO::CONTINUOUS_SINE);
+    params->progressive = 12;
+
+    constants::fracbuff b;
+    b.assign(params->yrange,
+             constants::fracrow(params->xrange));
+
+    std::vector<unsigned int> steps;
+    // the top left sample is computed on the first level and must never change
+    std::vector<unsigned int> first_pixel;
+    Fractalcrunchprogressive crunch_test_prog(
+        b, params, [&steps, &first_pixel, &b](unsigned int step) {
+            steps.push_back(step);
+            first_pixel.push_back(b[0][0].default_index);
+        });
+    crunch_test_prog.fill_buffer();
+
+    SECTION("Levels are published from coarse to fine")
+    {
+        REQUIRE(steps == std::vector<unsigned int>({8, 4, 2, 1}));
+        for (auto its : first_pixel)
+            REQUIRE(its == first_pixel.front());
+    }
+
+    SECTION("Final level equals a full resolution render")
+    {
+        constants::fracbuff ref;
+        FractalcruncherMock crunch_ref(ref, params);
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                auto crunched = crunch_ref.test_cruncher(
+                    params->x + ix * params->xdelta,
+                    params->y + iy * params->ydelta, params->bailout);
+                auto it = crunch_ref.test_iterfactory(std::get<0>(crunched),
+                                                      std::get<1>(crunched),
+                                                      std::get<2>(crunched));
+                REQUIRE(b[iy][ix].default_index == it.default_index);
+                REQUIRE(b[iy][ix].continous_index ==
+                        Catch::Detail::Approx(it.continous_index));
+            }
+        }
+    }
+}
+
+TEST_CASE("Test tile pyramid parameters", "[computation]")
+{
+    FractalParameters world(constants::FRACTAL::MANDELBROT, 1000, -2.5, 1.0,
+                            1000, -1.5, 1.5, -0.8, 0.156, 60, 0, 0, 0, "",
+                            "mandelbrot", 2,
+                            constants::COL_ALGO::CONTINUOUS_SINE);
+
+    SECTION("Level 0 is the whole complex plane")
+    {
+        auto tparams = Tilerenderer::tile_parameters(world, 0, 0, 0, 256);
+        REQUIRE(tparams->xrange == 256);
+        REQUIRE(tparams->yrange == 256);
+        REQUIRE(tparams->xl == Approx(world.xl));
+        REQUIRE(tparams->xh == Approx(world.xh));
+        REQUIRE(tparams->yl == Approx(world.yl));
+        REQUIRE(tparams->yh == Approx(world.yh));
+        REQUIRE(tparams->xdelta == Approx(3.5 / 256));
+        REQUIRE(tparams->bailout == world.bailout);
+    }
+
+    SECTION("Tiles of a level cover the plane without gaps")
+    {
+        for (unsigned int x = 0; x < 4; x++) {
+            for (unsigned int y = 0; y < 4; y++) {
+                auto tparams =
+                    Tilerenderer::tile_parameters(world, 2, x, y, 64);
+                REQUIRE(tparams->xl == Approx(world.xl + x * 3.5 / 4));
+                REQUIRE(tparams->xh == Approx(world.xl + (x + 1) * 3.5 / 4));
+                REQUIRE(tparams->yl == Approx(world.yl + y * 3.0 / 4));
+                REQUIRE(tparams->yh == Approx(world.yl + (y + 1) * 3.0 / 4));
+                REQUIRE(tparams->x == tparams->xl);
+                REQUIRE(tparams->y == tparams->yl);
+            }
+        }
+    }
+}
+
+TEST_CASE("Test in-memory tile cache", "[computation]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 100, -2.5, 1.0, 80, -1.5, 1.3,
+            -0.8, 0.156, 80, 0, 0, 0, "", "mandelbrot", 0,
+            constants::COL_ALGO::CONTINUOUS_SINE);
+    ctpl::thread_pool tpl(2);
+    Tilecache cache(16, 1000);
+
+    constants::fracbuff b;
+    b.assign(params->yrange,
+             constants::fracrow(params->xrange));
+    unsigned long computed = cache.render(b, params, tpl);
+    REQUIRE(computed > 0);
+    REQUIRE(cache.size() == computed);
+
+    SECTION("Composed view matches a direct render")
+    {
+        constants::fracbuff ref;
+        ref.assign(params->yrange,
+                   constants::fracrow(params->xrange));
+        Fractalcrunchsingle crunchi(ref, params);
+        crunchi.fill_buffer();
+        // pixel coordinates are computed from the grid, so a few pixels right
+        // at the border of the set might differ by one iteration
+        unsigned long differing = 0;
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                if (b[iy][ix].default_index != ref[iy][ix].default_index)
+                    differing++;
+            }
+        }
+        REQUIRE(differing < 10);
+    }
+
+    SECTION("The same view is not computed again")
+    {
+        REQUIRE(cache.render(b, params, tpl) == 0);
+    }
+
+    SECTION("Panning only computes newly exposed tiles")
+    {
+        // pan by 21 pixels to the right and 5 pixels down
+        auto panned = std::make_shared<FractalParameters>(*params);
+        panned->set_complex_plane(
+            params->xrange, params->xl + 21 * params->xdelta,
+            params->xh + 21 * params->xdelta, params->yrange,
+            params->yl + 5 * params->ydelta, params->yh + 5 * params->ydelta);
+        constants::fracbuff pb;
+        pb.assign(params->yrange,
+                  constants::fracrow(params->xrange));
+        unsigned long pan_computed = cache.render(pb, panned, tpl);
+        REQUIRE(pan_computed > 0);
+        REQUIRE(pan_computed < computed);
+
+        // overlapping area is identical to the first view
+        for (unsigned int iy = 0; iy < params->yrange - 5; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange - 21; ix++) {
+                REQUIRE(pb[iy][ix].default_index ==
+                        b[iy + 5][ix + 21].default_index);
+                REQUIRE(pb[iy][ix].continous_index ==
+                        b[iy + 5][ix + 21].continous_index);
+            }
+        }
+
+        // an empty cache composes exactly the same view
+        Tilecache fresh(16, 1000);
+        constants::fracbuff fb;
+        fb.assign(params->yrange,
+                  constants::fracrow(params->xrange));
+        fresh.render(fb, panned, tpl);
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(fb[iy][ix].default_index == pb[iy][ix].default_index);
+            }
+        }
+    }
+
+    SECTION("Tiles are queued by the cost of the previous view")
+    {
+        auto zoomed = std::make_shared<FractalParameters>(*params);
+        zoomed->set_complex_plane(params->xrange, -1.5, 0.25, params->yrange,
+                                  -0.7, 0.7);
+        constants::fracbuff plain_buff;
+        plain_buff.assign(params->yrange, constants::fracrow(params->xrange));
+        Tilecache plain(16, 1000);
+        plain.render(plain_buff, zoomed, tpl);
+
+        constants::fracbuff sorted_buff;
+        sorted_buff.assign(params->yrange, constants::fracrow(params->xrange));
+        Tilecache sorted(16, 1000);
+        sorted.set_costmap(Costmap::from_buffer(b, nullptr, *params, 10));
+        sorted.render(sorted_buff, zoomed, tpl);
+
+        // the same tiles in another order, the tiles through the set first
+        auto plain_jobs = plain.last_jobs();
+        auto sorted_jobs = sorted.last_jobs();
+        REQUIRE(!sorted_jobs.empty());
+        REQUIRE(sorted_jobs != plain_jobs);
+        std::sort(plain_jobs.begin(), plain_jobs.end());
+        std::sort(sorted_jobs.begin(), sorted_jobs.end());
+        REQUIRE(sorted_jobs == plain_jobs);
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(sorted_buff[iy][ix].default_index ==
+                        plain_buff[iy][ix].default_index);
+            }
+        }
+    }
+
+    SECTION("Least recently used tiles are evicted")
+    {
+        Tilecache small(16, 4);
+        small.render(b, params, tpl);
+        REQUIRE(small.size() == 4);
+    }
+}
+
+TEST_CASE("Test run statistics", "[computation]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 64, -2.5, 1.0, 48, -1.5, 1.5, -0.8,
+            0.156, 200, 0, 0, 0, "", "mandelbrot", 2,
+            constants::COL_ALGO::ESCAPE_TIME);
+    constants::fracbuff b;
+    b.assign(params->yrange,
+             constants::fracrow(params->xrange));
+
+    Runstats stats;
+    Workerclock clock(params->cores);
+    stats.begin("compute");
+    Fractalcrunchmulti crunchi(b, params);
+    crunchi.set_workerclock(&clock);
+    crunchi.fill_buffer();
+    Runstats::Phase &phase = stats.end();
+    phase.busy = clock.busy();
+
+    SECTION("Every worker thread is accounted")
+    {
+        REQUIRE(phase.busy.size() == 2);
+        double busy = phase.busy[0] + phase.busy[1];
+        REQUIRE(busy > 0);
+        // two threads can not be busy for longer than twice the wall time
+        REQUIRE(busy <= 2 * phase.seconds);
+    }
+
+    SECTION("Unknown thread ids are ignored")
+    {
+        Workerclock small(1);
+        small.add(1, Workerclock::clock::now());
+        small.add(-1, Workerclock::clock::now());
+        REQUIRE(small.busy() == std::vector<double>({0}));
+    }
+
+    SECTION("Reports contain all phases")
+    {
+        stats.begin("encode");
+        stats.end();
+        REQUIRE(stats.phases().size() == 2);
+        REQUIRE(stats.phases()[1].name == "encode");
+        std::string json = stats.json();
+        REQUIRE(json.front() == '{');
+        REQUIRE(json.back() == '}');
+        REQUIRE(json.find("\"name\": \"compute\"") != std::string::npos);
+        REQUIRE(json.find("\"busy\": ") != std::string::npos);
+        REQUIRE(stats.text().find("encode") != std::string::npos);
+#if defined(__unix__) || defined(__APPLE__)
+        REQUIRE(Runstats::peak_rss_kib() > 0);
+#endif
+    }
+}
+
+TEST_CASE("Test multicore job trace", "[computation]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 40, -2.5, 1.0, 30, -1.5, 1.5, -0.8,
+            0.156, 100, 0, 0, 0, "", "mandelbrot", 3,
+            constants::COL_ALGO::DISTANCE);
+    constants::fracbuff b;
+    b.assign(params->yrange,
+             constants::fracrow(params->xrange));
+
+    Jobtrace trace(params->cores);
+    Fractalcrunchmulti crunchi(b, params);
+    crunchi.set_jobtrace(&trace);
+    crunchi.fill_buffer();
+
+    // every row is one job and the job iterations add up to the cost of the
+    // buffer
+    std::vector<unsigned int> rows;
+    unsigned long long its = 0;
+    for (unsigned int t = 0; t < params->cores; t++) {
+        for (const auto &job : trace.jobs(t)) {
+            REQUIRE(job.category == "compute");
+            REQUIRE(job.queued <= job.begin);
+            REQUIRE(job.begin <= job.end);
+            rows.push_back(job.row);
+            its += job.iterations;
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    REQUIRE(rows.size() == params->yrange);
+    for (unsigned int iy = 0; iy < params->yrange; iy++)
+        REQUIRE(rows[iy] == iy);
+
+    unsigned long long buff_its = 0;
+    unsigned long long escape_times = 0;
+    for (const auto &row : b) {
+        for (const auto &px : row) {
+            buff_its += px.cost;
+            escape_times += px.default_index;
+        }
+    }
+    REQUIRE(its == buff_its);
+    // the distance estimation iterates on after the escape
+    REQUIRE(its > escape_times);
+
+    std::string file = "geomandel_test_trace.json";
+    trace.write(file);
+    std::ifstream in(file);
+    std::string json((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(file.c_str());
+    REQUIRE(json.find("\"traceEvents\"") != std::string::npos);
+    REQUIRE(json.find("\"ph\": \"X\"") != std::string::npos);
+    REQUIRE(json.find("\"name\": \"compute row 0\"") != std::string::npos);
+}
+
+TEST_CASE("Test cost predictive scheduling", "[computation]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 90, -2.5, 1.0, 60, -1.5, 1.5, -0.8,
+            0.156, 300, 0, 0, 0, "", "mandelbrot", 3,
+            constants::COL_ALGO::CONTINUOUS_SINE);
+    constants::fracbuff ref;
+    ref.assign(params->yrange,
+               constants::fracrow(params->xrange));
+    Fractalcrunchsingle single(ref, params);
+    single.fill_buffer();
+    Costmap map = Costmap::from_buffer(ref, nullptr, *params, 10);
+
+    SECTION("Cost map predicts the iterations of its cells")
+    {
+        REQUIRE(map.matches(*params));
+        double cell = 0;
+        for (unsigned int iy = 20; iy < 30; iy++)
+            for (unsigned int ix = 50; ix < 60; ix++)
+                cell += ref[iy][ix].cost;
+        double re = params->x + 55 * params->xdelta;
+        double im = params->y + 25 * params->ydelta;
+        REQUIRE(map.density(re, im) == Approx(cell / 100));
+        // outside of the map the average cost is the best guess
+        double total = 0;
+        for (const auto &row : ref)
+            for (const auto &px : row)
+                total += px.cost;
+        REQUIRE(map.density(5.0, 5.0) == Approx(total / (90 * 60)));
+
+        auto other = std::make_shared<FractalParameters>(*params);
+        other->bailout = 1000;
+        REQUIRE(!map.matches(*other));
+        REQUIRE(!Costmap().matches(*params));
+    }
+
+    SECTION("Regions cover every pixel once, most expensive first")
+    {
+        auto regions = Fractalcrunchmulti::schedule(map, *params, 100);
+        REQUIRE(!regions.empty());
+        std::vector<unsigned int> covered(90 * 60, 0);
+        for (size_t i = 0; i < regions.size(); i++) {
+            const auto &r = regions[i];
+            REQUIRE(r.x0 < r.x1);
+            REQUIRE(r.y0 < r.y1);
+            if (i > 0)
+                REQUIRE(regions[i - 1].cost >= r.cost);
+            for (unsigned int iy = r.y0; iy < r.y1; iy++)
+                for (unsigned int ix = r.x0; ix < r.x1; ix++)
+                    covered[iy * 90 + ix]++;
+        }
+        REQUIRE(std::count(covered.begin(), covered.end(), 1u) == 90 * 60);
+        // the rows through the set are expensive and have to be split
+        REQUIRE(std::any_of(regions.begin(), regions.end(),
+                            [](const Fractalcrunchmulti::Region &r) {
+                                return r.x0 > 0 || r.x1 < 90;
+                            }));
+        REQUIRE(regions.size() >= 50);
+    }
+
+    SECTION("Scheduled and row jobs compute the same buffer")
+    {
+        constants::fracbuff b;
+        b.assign(params->yrange,
+                 constants::fracrow(params->xrange));
+        Fractalcrunchmulti crunchi(b, params);
+        SECTION("Map of a previous frame") { crunchi.set_costmap(map); }
+        SECTION("Pre-pass")
+        {
+            REQUIRE(crunchi.prepass_costmap(4).matches(*params));
+        }
+        crunchi.fill_buffer();
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(b[iy][ix].default_index == ref[iy][ix].default_index);
+                REQUIRE(b[iy][ix].continous_index ==
+                        ref[iy][ix].continous_index);
+            }
+        }
+    }
+}
+
+TEST_CASE("Test NUMA aware scheduling", "[computation]")
+{
+    SECTION("Linux cpu lists are parsed")
+    {
+        REQUIRE(Numatopology::parse_cpulist("0-3,8,10-11") ==
+                std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+        REQUIRE(Numatopology::parse_cpulist("").empty());
+        REQUIRE_THROWS_AS(Numatopology::parse_cpulist("3-1"),
+                          std::invalid_argument &);
+        REQUIRE_THROWS_AS(Numatopology::parse_cpulist("a-b"),
+                          std::invalid_argument &);
+        REQUIRE(Numatopology::detect().nodes() >= 1);
+    }
+
+    Numatopology topo({{0}, {0}});
+
+    SECTION("Rows and workers are assigned in contiguous bands")
+    {
+        REQUIRE(topo.nodes() == 2);
+        REQUIRE(topo.worker_node(0, 4) == 0);
+        REQUIRE(topo.worker_node(1, 4) == 0);
+        REQUIRE(topo.worker_node(2, 4) == 1);
+        REQUIRE(topo.worker_node(3, 4) == 1);
+        REQUIRE(topo.row_node(49, 100) == 0);
+        REQUIRE(topo.row_node(50, 100) == 1);
+    }
+
+    SECTION("Workers take their own node first and every item once")
+    {
+        Nodequeue queue(2);
+        for (size_t i = 0; i < 10; i++)
+            queue.push(i < 5 ? 0 : 1, i);
+        size_t item = 0;
+        REQUIRE(queue.claim(1, item));
+        REQUIRE(item == 5);
+        std::vector<size_t> claimed = {item};
+        while (queue.claim(0, item))
+            claimed.push_back(item);
+        std::sort(claimed.begin(), claimed.end());
+        REQUIRE(claimed.size() == 10);
+        for (size_t i = 0; i < 10; i++)
+            REQUIRE(claimed[i] == i);
+    }
+
+    SECTION("Node local rows compute the same buffer")
+    {
+        std::shared_ptr<FractalParameters> params =
+            std::make_shared<FractalParameters>(
+                constants::FRACTAL::JULIA, 50, -2.0, 2.0, 40, -1.5, 1.5, -0.8,
+                0.156, 200, 0, 0, 0, "", "julia", 4,
+                constants::COL_ALGO::CONTINUOUS_SINE);
+        constants::fracbuff ref;
+        ref.assign(params->yrange,
+                   constants::fracrow(params->xrange));
+        Fractalcrunchsingle single(ref, params);
+        single.fill_buffer();
+
+        constants::fracbuff b;
+        b.assign(params->yrange,
+                 constants::fracrow(params->xrange));
+        b[7][3].default_index = 12345;
+        Fractalcrunchmulti crunchi(b, params);
+        crunchi.set_numa(&topo);
+        crunchi.first_touch();
+        REQUIRE(b.size() == params->yrange);
+        REQUIRE(b[7].size() == params->xrange);
+        REQUIRE(b[7][3].default_index == 0);
+        crunchi.fill_buffer();
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(b[iy][ix].default_index == ref[iy][ix].default_index);
+                REQUIRE(b[iy][ix].continous_index ==
+                        ref[iy][ix].continous_index);
+            }
+        }
+    }
+}
+
+TEST_CASE("Test frame buffer arena", "[computation]")
+{
+    Bufferarena &arena = Bufferarena::instance();
+    // a block from before the arena was enabled must still be freed
+    constants::fracrow early(10000);
+    arena.enable(Bufferarena::TRANSPARENT);
+    REQUIRE(arena.enabled());
+
+    SECTION("Released blocks are reused for the same size")
+    {
+        auto before = arena.counters();
+        void *p = arena.allocate(64 * 1024);
+        arena.release(p, 64 * 1024);
+        void *q = arena.allocate(64 * 1024);
+        REQUIRE(q == p);
+        void *r = arena.allocate(32 * 1024);
+        REQUIRE(r != p);
+        auto after = arena.counters();
+        REQUIRE(after.allocations - before.allocations == 3);
+        REQUIRE(after.reused - before.reused == 1);
+        REQUIRE(after.mapped_bytes >= Bufferarena::huge_page_size);
+        REQUIRE(reinterpret_cast<size_t>(p) % 64 == 0);
+        arena.release(q, 64 * 1024);
+        arena.release(r, 32 * 1024);
+    }
+
+    SECTION("Frames of a batch reuse the rows of the previous frame")
+    {
+        std::shared_ptr<FractalParameters> params =
+            std::make_shared<FractalParameters>(
+                constants::FRACTAL::MANDELBROT, 600, -2.5, 1.0, 20, -1.5, 1.5,
+                -0.8, 0.156, 50, 0, 0, 0, "", "mandelbrot", 1,
+                constants::COL_ALGO::ESCAPE_TIME);
+        Runstats stats;
+        for (int frame = 0; frame < 2; frame++) {
+            stats.begin("allocate");
+            constants::fracbuff b;
+            b.assign(params->yrange, constants::fracrow(params->xrange));
+            stats.end();
+            Fractalcrunchsingle crunchi(b, params);
+            crunchi.fill_buffer();
+            REQUIRE(b[10][300].default_index > 0);
+        }
+        // the prototype row and all rows of the frame
+        REQUIRE(stats.phases()[0].allocations == 21);
+        REQUIRE(stats.phases()[1].allocations == 21);
+        REQUIRE(stats.phases()[1].reused == 21);
+        REQUIRE(stats.json().find("\"reused_allocations\": 21") !=
+                std::string::npos);
+    }
+
+    SECTION("Small allocations bypass the arena")
+    {
+        auto before = arena.counters();
+        void *p = arena.allocate(100);
+        arena.release(p, 100);
+        void *q = arena.allocate(100);
+        arena.release(q, 100);
+        REQUIRE(arena.counters().reused == before.reused);
+    }
+
+    early.clear();
+    early.shrink_to_fit();
+}
@@ -16,10 +16,36 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
 #include "catch.hpp"
 
+#include "config.h"
+
 #include "buffwriter_mock.h"
+#include "costwriter.h"
+#include "csvwriter.h"
+#include "dumpreader.h"
+#include "dumpwriter.h"
+#include "geomandel.h"
 #include "global.h"
+#include "image_rgb.h"
+#ifdef HAVE_RENDERCACHE
+#include <unistd.h>
+
+#include "rendercache.h"
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+
+#include "image_png.h"
+#endif
 
 TEST_CASE("Filename Patterns", "[output]")
 {
@@ -87,4 +113,579 @@ TEST_CASE("Filename Patterns", "[output]")
                     utility::primitive_to_string(z_real_max) + ", " +
                     utility::primitive_to_string(z_ima_max) + ")");
     }
+
+    SECTION("Adjacent placeholders and incomplete patterns")
+    {
+        std::string filename = bmock.test_filename_patterns(
+            "%w%h%Z%ZI%", fractal_type, bailout, xrange, yrange, zoom, cores,
+            xcoord, ycoord, z_real_min, z_real_max, z_ima_min, z_ima_max);
+        REQUIRE(filename == "1024768%Z1.5%");
+
+        // a writer reuses its compiled pattern until the pattern changes
+        filename = bmock.test_filename_patterns(
+            "%b", fractal_type, bailout, xrange, yrange, zoom, cores, xcoord,
+            ycoord, z_real_min, z_real_max, z_ima_min, z_ima_max);
+        REQUIRE(filename == "2048");
+        filename = bmock.test_filename_patterns(
+            "%b", fractal_type, 100, xrange, yrange, zoom, cores, xcoord,
+            ycoord, z_real_min, z_real_max, z_ima_min, z_ima_max);
+        REQUIRE(filename == "100");
+    }
+}
+
+TEST_CASE("Library API", "[output]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 40, -2.5, 1.0, 30, -1.5, 1.5, -0.8,
+            0.156, 100, 0, 0, 0, "", "mandelbrot", 0,
+            constants::COL_ALGO::ESCAPE_TIME);
+
+    SECTION("Buffer and image have the requested size")
+    {
+        constants::fracbuff buff = geomandel::create_buffer(*params);
+        REQUIRE(buff.size() == 30);
+        REQUIRE(buff.at(0).size() == 40);
+
+        geomandel::ColorParameters colors;
+        colors.rgb_set_base = std::make_tuple(1, 2, 3);
+        std::vector<uint8_t> rgb = geomandel::render_rgb(params, colors);
+        REQUIRE(rgb.size() == 40 * 30 * 3);
+
+        // the center of the image is inside the mandelbrot set
+        geomandel::render(buff, params);
+        REQUIRE(buff[15][28].default_index == params->bailout);
+        size_t pos = (15 * 40 + 28) * 3;
+        REQUIRE(rgb[pos] == 1);
+        REQUIRE(rgb[pos + 1] == 2);
+        REQUIRE(rgb[pos + 2] == 3);
+    }
+
+    SECTION("Singlecore and multicore engine produce the same buffer")
+    {
+        constants::fracbuff single = geomandel::create_buffer(*params);
+        geomandel::render(single, params);
+        params->cores = 3;
+        constants::fracbuff multi = geomandel::create_buffer(*params);
+        geomandel::render(multi, params);
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(single[iy][ix].default_index ==
+                        multi[iy][ix].default_index);
+            }
+        }
+    }
+
+    SECTION("Images are colorized on the pool of the caller")
+    {
+        constants::fracbuff buff = geomandel::create_buffer(*params);
+        geomandel::render(buff, params);
+        std::shared_ptr<Printer> prnt = std::make_shared<Printer>(true);
+        geomandel::ColorParameters colors;
+        auto colorize = [&](ctpl::thread_pool *tpl) {
+            ImageRGB img(buff, params, prnt, colors.rgb_base,
+                         colors.rgb_set_base, colors.rgb_freq,
+                         colors.rgb_phase, colors.rgb_amp);
+            img.set_pool(tpl);
+            img.write_buffer();
+            return img.get_rgb_buffer();
+        };
+        constants::rgbbuff reference = colorize(nullptr);
+
+        ctpl::thread_pool tpl(3);
+        REQUIRE(colorize(&tpl) == reference);
+        // busy workers must not wait for bands queued behind their own jobs
+        ctpl::thread_pool tiles(2);
+        std::atomic<int> started(0);
+        auto job = [&](int) {
+            started++;
+            while (started.load() < 2)
+                std::this_thread::yield();
+            return colorize(&tiles);
+        };
+        auto first = tiles.push(job);
+        auto second = tiles.push(job);
+        REQUIRE(first.get() == reference);
+        REQUIRE(second.get() == reference);
+    }
+}
+
+TEST_CASE("CSV export", "[output]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 7, -2.5, 1.0, 70, -1.5, 1.5, -0.8,
+            0.156, 100, 0, 0, 0, "geomandel_test_csv", "mandelbrot", 3,
+            constants::COL_ALGO::CONTINUOUS_SINE);
+    constants::fracbuff buff = geomandel::create_buffer(*params);
+    geomandel::render(buff, params);
+
+    // values that are hard to format, rounding ties and huge numbers
+    std::vector<double> special = {0.0,       -0.0,      0.0000005,
+                                   -0.0000005, 1.0000015, 2.5e-7,
+                                   -1e-9,     123456.789, 1e300,
+                                   -7.25e12,  4294967295.5, 0.1234565};
+    for (size_t i = 0; i < special.size(); i++)
+        buff[i][i % 7].continous_index = special[i];
+    buff[0][1].default_index = 4294967295u;
+
+    CSVWriter csv(buff, params);
+    csv.write_buffer();
+
+    // reference implementation of the original csv export
+    std::stringstream ref_iter;
+    std::stringstream ref_cont;
+    for (const auto &row : buff) {
+        for (size_t ix = 0; ix < row.size(); ix++) {
+            if (ix > 0) {
+                ref_iter << ";";
+                ref_cont << ";";
+            }
+            ref_iter << std::to_string(row[ix].default_index);
+            ref_cont << std::to_string(row[ix].continous_index);
+        }
+        ref_iter << "\n";
+        ref_cont << "\n";
+    }
+
+    std::ifstream iter_file("geomandel_test_csv_iterindex.csv");
+    std::ifstream cont_file("geomandel_test_csv_contindex.csv");
+    std::stringstream iter_content;
+    std::stringstream cont_content;
+    iter_content << iter_file.rdbuf();
+    cont_content << cont_file.rdbuf();
+    REQUIRE(iter_content.str() == ref_iter.str());
+    REQUIRE(cont_content.str() == ref_cont.str());
+    iter_file.close();
+    cont_file.close();
+    std::remove("geomandel_test_csv_iterindex.csv");
+    std::remove("geomandel_test_csv_contindex.csv");
+}
+
+TEST_CASE("Binary dump", "[output]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::JULIA, 37, -2.0, 2.0, 23, -1.5, 1.5, -0.8,
+            0.156, 120, 0, 0, 0, "", "julia", 2,
+            constants::COL_ALGO::CONTINUOUS_SINE);
+    params->aa_samples = 3;
+    constants::fracbuff buff = geomandel::create_buffer(*params);
+    constants::samplebuff samples;
+    geomandel::render(buff, params, &samples);
+    REQUIRE(!samples.empty());
+
+    std::string filename = "geomandel_test_dump.gmd";
+    Dumpwriter writer(buff, params);
+    writer.set_samples(samples);
+    writer.write_file(filename);
+
+    {
+        Dumpreader reader(filename);
+        REQUIRE(reader.width() == 37);
+        REQUIRE(reader.height() == 23);
+        REQUIRE(reader.header().iterations_offset % 64 == 0);
+        REQUIRE(reader.header().continuous_offset % 64 == 0);
+
+        SECTION("Planes contain the buffer")
+        {
+            for (unsigned int iy = 0; iy < 23; iy++) {
+                for (unsigned int ix = 0; ix < 37; ix++) {
+                    REQUIRE(reader.iterations()[iy * 37 + ix] ==
+                            buff[iy][ix].default_index);
+                    REQUIRE(reader.continuous()[iy * 37 + ix] ==
+                            buff[iy][ix].continous_index);
+                }
+            }
+        }
+
+        SECTION("Parameters are restored")
+        {
+            auto p = reader.parameters("recolored");
+            REQUIRE(p->set_type == constants::FRACTAL::JULIA);
+            REQUIRE(p->fractal_type == "julia");
+            REQUIRE(p->image_base == "recolored");
+            REQUIRE(p->bailout == 120);
+            REQUIRE(p->julia_real == -0.8);
+            REQUIRE(p->julia_ima == 0.156);
+            REQUIRE(p->xdelta == params->xdelta);
+            REQUIRE(p->ydelta == params->ydelta);
+            REQUIRE(p->col_algo == params->col_algo);
+            REQUIRE(p->aa_samples == 3);
+        }
+
+        SECTION("Buffer and samples are restored")
+        {
+            constants::fracbuff loaded;
+            constants::samplebuff loaded_samples;
+            reader.to_buffer(loaded, loaded_samples);
+            REQUIRE(loaded.size() == buff.size());
+            for (unsigned int iy = 0; iy < 23; iy++) {
+                for (unsigned int ix = 0; ix < 37; ix++) {
+                    REQUIRE(loaded[iy][ix].default_index ==
+                            buff[iy][ix].default_index);
+                }
+            }
+            REQUIRE(loaded_samples.size() == samples.size());
+            for (const auto &kv : samples) {
+                const auto &v = loaded_samples.at(kv.first);
+                REQUIRE(v.size() == kv.second.size());
+                for (size_t i = 0; i < v.size(); i++) {
+                    REQUIRE(v[i].default_index == kv.second[i].default_index);
+                    REQUIRE(v[i].continous_index ==
+                            kv.second[i].continous_index);
+                }
+            }
+        }
+    }
+    std::remove(filename.c_str());
+    REQUIRE_THROWS(Dumpreader("geomandel_test_missing.gmd"));
+}
+
+#ifdef HAVE_ZLIB
+TEST_CASE("Iteration cost export", "[output]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 45, -2.5, 1.0, 30, -1.5, 1.5, -0.8,
+            0.156, 200, 0, 0, 0, "geomandel_test_cost", "mandelbrot", 2,
+            constants::COL_ALGO::ESCAPE_TIME);
+    params->aa_samples = 4;
+    constants::fracbuff buff = geomandel::create_buffer(*params);
+    constants::samplebuff samples;
+    geomandel::render(buff, params, &samples);
+    REQUIRE(!samples.empty());
+
+    SECTION("Cost is the number of iterations executed")
+    {
+        for (const auto &row : buff) {
+            for (const auto &it : row)
+                REQUIRE(it.cost == it.default_index);
+        }
+        unsigned long long sample_cost = 0;
+        for (const auto &kv : samples) {
+            unsigned int ix = kv.first % 45;
+            unsigned int iy = kv.first / 45;
+            sample_cost = buff[iy][ix].cost;
+            for (const auto &s : kv.second)
+                sample_cost += s.default_index;
+            REQUIRE(Costwriter::pixel_cost(buff, &samples, ix, iy) ==
+                    sample_cost);
+            REQUIRE(Costwriter::pixel_cost(buff, nullptr, ix, iy) ==
+                    buff[iy][ix].cost);
+        }
+    }
+
+    SECTION("Tile costs add up to the total cost")
+    {
+        auto tiles = Costwriter::tile_costs(buff, &samples, 16);
+        REQUIRE(tiles.size() == 2);
+        REQUIRE(tiles[0].size() == 3);
+        unsigned long long total = 0;
+        for (unsigned int iy = 0; iy < 30; iy++) {
+            for (unsigned int ix = 0; ix < 45; ix++)
+                total += Costwriter::pixel_cost(buff, &samples, ix, iy);
+        }
+        unsigned long long tile_total = 0;
+        for (const auto &row : tiles) {
+            for (auto c : row)
+                tile_total += c;
+        }
+        REQUIRE(tile_total == total);
+        unsigned long long corner = 0;
+        for (unsigned int iy = 16; iy < 30; iy++) {
+            for (unsigned int ix = 32; ix < 45; ix++)
+                corner += Costwriter::pixel_cost(buff, &samples, ix, iy);
+        }
+        REQUIRE(tiles[1][2] == corner);
+    }
+
+    SECTION("Grey image and tile csv are written")
+    {
+        Costwriter writer(buff, params, 16);
+        writer.set_samples(samples);
+        writer.write_buffer();
+
+        std::ifstream img("geomandel_test_cost_cost.pgm", std::ios::binary);
+        REQUIRE(img.is_open());
+        std::string magic;
+        std::getline(img, magic);
+        REQUIRE(magic == "P5");
+        std::string comment;
+        std::getline(img, comment);
+        REQUIRE(comment[0] == '#');
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int maxval = 0;
+        img >> width >> height >> maxval;
+        img.get();
+        REQUIRE(width == 45);
+        REQUIRE(height == 30);
+        REQUIRE(maxval == 255);
+        std::vector<char> grey(45 * 30);
+        img.read(grey.data(), static_cast<std::streamsize>(grey.size()));
+        REQUIRE(img.gcount() == static_cast<std::streamsize>(grey.size()));
+        // the most expensive pixel is white
+        REQUIRE(std::find(grey.begin(), grey.end(), static_cast<char>(255)) !=
+                grey.end());
+        img.close();
+
+        std::ifstream csv("geomandel_test_cost_cost.csv");
+        REQUIRE(csv.is_open());
+        std::string line;
+        std::getline(csv, line);
+        REQUIRE(line == "tile_x,tile_y,x,y,width,height,iterations");
+        unsigned int lines = 0;
+        while (std::getline(csv, line))
+            lines++;
+        REQUIRE(lines == 6);
+        csv.close();
+        std::remove("geomandel_test_cost_cost.pgm");
+        std::remove("geomandel_test_cost_cost.csv");
+    }
+}
+
+TEST_CASE("Native PNG writer", "[output]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 300, -2.5, 1.0, 700, -1.5, 1.5,
+            -0.8, 0.156, 100, 0, 0, 0, "geomandel_test_png", "mandelbrot", 3,
+            constants::COL_ALGO::CONTINUOUS_SINE);
+    params->aa_samples = 2;
+    constants::fracbuff buff = geomandel::create_buffer(*params);
+    constants::samplebuff samples;
+    geomandel::render(buff, params, &samples);
+
+    geomandel::ColorParameters colors;
+    std::shared_ptr<Printer> prnt = std::make_shared<Printer>(true);
+    ImagePNG png(buff, params, prnt, colors.rgb_base, colors.rgb_set_base,
+                 colors.rgb_freq, colors.rgb_phase, colors.rgb_amp);
+    png.set_samples(samples);
+    png.write_buffer();
+
+    std::ifstream in("geomandel_test_png.png", std::ifstream::binary);
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    in.close();
+    std::remove("geomandel_test_png.png");
+    REQUIRE(data.substr(0, 8) == "\x89PNG\r\n\x1a\n");
+
+    // collect the image data, every chunk must have a valid crc
+    auto be32 = [&data](size_t pos) {
+        return static_cast<uint32_t>(static_cast<uint8_t>(data[pos])) << 24 |
+               static_cast<uint32_t>(static_cast<uint8_t>(data[pos + 1]))
+                   << 16 |
+               static_cast<uint32_t>(static_cast<uint8_t>(data[pos + 2]))
+                   << 8 |
+               static_cast<uint32_t>(static_cast<uint8_t>(data[pos + 3]));
+    };
+    std::string idat;
+    unsigned int idat_chunks = 0;
+    size_t pos = 8;
+    while (pos + 12 <= data.size()) {
+        uint32_t len = be32(pos);
+        std::string type = data.substr(pos + 4, 4);
+        uLong crc = crc32(0, reinterpret_cast<const Bytef *>(&data[pos + 4]),
+                          len + 4);
+        REQUIRE(crc == be32(pos + 8 + len));
+        if (type == "IHDR") {
+            REQUIRE(be32(pos + 8) == 300);
+            REQUIRE(be32(pos + 12) == 700);
+        }
+        if (type == "IDAT") {
+            idat += data.substr(pos + 8, len);
+            idat_chunks++;
+        }
+        pos += 12 + len;
+    }
+    REQUIRE(pos == data.size());
+    // the image is big enough to be split into several bands
+    REQUIRE(idat_chunks > 3);
+
+    size_t stride = 300 * 3;
+    std::vector<uint8_t> raw(700 * (stride + 1));
+    uLongf raw_size = raw.size();
+    REQUIRE(uncompress(raw.data(), &raw_size,
+                       reinterpret_cast<const Bytef *>(idat.data()),
+                       idat.size()) == Z_OK);
+    REQUIRE(raw_size == raw.size());
+
+    // undo the row filters and compare with the in memory colorizer
+    std::vector<uint8_t> rgb = geomandel::render_rgb(params, colors);
+    std::vector<uint8_t> prev(stride, 0);
+    for (size_t y = 0; y < 700; y++) {
+        uint8_t filter = raw[y * (stride + 1)];
+        uint8_t *row = &raw[y * (stride + 1) + 1];
+        for (size_t i = 0; i < stride; i++) {
+            int a = i >= 3 ? row[i - 3] : 0;
+            int b = prev[i];
+            int c = i >= 3 ? prev[i - 3] : 0;
+            int pred = 0;
+            if (filter == 1)
+                pred = a;
+            if (filter == 2)
+                pred = b;
+            if (filter == 3)
+                pred = (a + b) / 2;
+            if (filter == 4) {
+                int p = a + b - c;
+                int pa = std::abs(p - a);
+                int pb = std::abs(p - b);
+                int pc = std::abs(p - c);
+                pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            }
+            row[i] = static_cast<uint8_t>(row[i] + pred);
+        }
+        REQUIRE(std::equal(row, row + stride, rgb.begin() + y * stride));
+        prev.assign(row, row + stride);
+    }
+}
+#endif
+
+#ifdef HAVE_RENDERCACHE
+TEST_CASE("Render cache", "[output]")
+{
+    std::shared_ptr<FractalParameters> params =
+        std::make_shared<FractalParameters>(
+            constants::FRACTAL::MANDELBROT, 40, -2.5, 1.0, 30, -1.5, 1.5, -0.8,
+            0.156, 100, 0, 0, 0, "", "mandelbrot", 0,
+            constants::COL_ALGO::CONTINUOUS_SINE);
+    params->aa_samples = 4;
+    std::string cache_dir = "geomandel_test_cache";
+
+    constants::fracbuff buff = geomandel::create_buffer(*params);
+    constants::samplebuff samples;
+    geomandel::render(buff, params, &samples);
+
+    SECTION("Key only depends on fields that change the iterations")
+    {
+        FractalParameters other = *params;
+        other.image_base = "other";
+        other.cores = 8;
+        REQUIRE(Rendercache::key(*params) == Rendercache::key(other));
+        other.bailout = 101;
+        REQUIRE(Rendercache::key(*params) != Rendercache::key(other));
+        other = *params;
+        other.set_complex_plane(40, -2.5, 1.0, 30, -1.5, 1.6);
+        REQUIRE(Rendercache::key(*params) != Rendercache::key(other));
+    }
+
+    SECTION("Boundary tracing results are kept apart from exact renders")
+    {
+        FractalParameters other = *params;
+        other.boundary = 64;
+        REQUIRE(Rendercache::key(*params) != Rendercache::key(other));
+        FractalParameters smaller = other;
+        smaller.boundary = 32;
+        REQUIRE(Rendercache::key(other) != Rendercache::key(smaller));
+    }
+
+    SECTION("Stored buffers are loaded unchanged")
+    {
+        Rendercache cache(cache_dir, 1024 * 1024);
+        constants::fracbuff loaded = geomandel::create_buffer(*params);
+        constants::samplebuff loaded_samples;
+        // the cost may differ from the escape time, e.g. with boundary
+        // tracing, so it has to be stored as well
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++)
+                buff[iy][ix].cost = (ix + iy) % 3;
+        }
+        cache.store(*params, buff, samples);
+        REQUIRE(cache.load(*params, loaded, loaded_samples));
+        for (unsigned int iy = 0; iy < params->yrange; iy++) {
+            for (unsigned int ix = 0; ix < params->xrange; ix++) {
+                REQUIRE(loaded[iy][ix].default_index ==
+                        buff[iy][ix].default_index);
+                REQUIRE(loaded[iy][ix].cost == buff[iy][ix].cost);
+                REQUIRE(loaded[iy][ix].continous_index ==
+                        buff[iy][ix].continous_index);
+            }
+        }
+        REQUIRE(!samples.empty());
+        REQUIRE(loaded_samples.size() == samples.size());
+        for (const auto &kv : samples) {
+            const auto &other = loaded_samples.at(kv.first);
+            REQUIRE(other.size() == kv.second.size());
+            for (size_t i = 0; i < other.size(); i++) {
+                REQUIRE(other[i].default_index == kv.second[i].default_index);
+                REQUIRE(other[i].cost == kv.second[i].cost);
+            }
+        }
+
+        params->bailout = 200;
+        REQUIRE(!cache.load(*params, loaded, loaded_samples));
+    }
+
+    SECTION("Corrupt sample records are rejected without touching the buffers")
+    {
+        Rendercache cache(cache_dir, 1024 * 1024);
+        cache.store(*params, buff, samples);
+        std::stringstream ss;
+        ss << cache_dir << "/" << std::hex << std::setw(16)
+           << std::setfill('0') << Rendercache::key(*params) << ".gmrc";
+        // header, the iteration, cost and continuous index planes, the number
+        // of sampled pixels and the index of the first one
+        size_t plane = static_cast<size_t>(params->xrange) * params->yrange;
+        long count_pos = 25 + plane * (2 * sizeof(uint32_t) + sizeof(double)) +
+                         2 * sizeof(uint64_t);
+        {
+            std::fstream f(ss.str(),
+                           std::ios::binary | std::ios::in | std::ios::out);
+            REQUIRE(f);
+            f.seekp(count_pos);
+            uint32_t huge = 0xFFFFFFFF;
+            f.write(reinterpret_cast<const char *>(&huge), sizeof(huge));
+        }
+
+        constants::fracbuff loaded = geomandel::create_buffer(*params);
+        loaded[0][0].default_index = 4711;
+        constants::samplebuff loaded_samples;
+        loaded_samples[1].resize(3);
+        REQUIRE(!cache.load(*params, loaded, loaded_samples));
+        REQUIRE(loaded[0][0].default_index == 4711);
+        REQUIRE(loaded_samples.size() == 1);
+        REQUIRE(loaded_samples.at(1).size() == 3);
+    }
+
+    SECTION("Least recently used entries are evicted")
+    {
+        {
+            // a cache without space removes all entries
+            Rendercache clear(cache_dir, 0);
+            REQUIRE(clear.size() == 0);
+        }
+        params->aa_samples = 0;
+        samples.clear();
+        geomandel::render(buff, params);
+        unsigned long long entry_size = 0;
+        {
+            Rendercache cache(cache_dir, 1024 * 1024);
+            cache.store(*params, buff, samples);
+            entry_size = cache.size();
+            // replacing an entry does not change the size
+            cache.store(*params, buff, samples);
+            REQUIRE(cache.size() == entry_size);
+        }
+
+        Rendercache cache(cache_dir, entry_size + entry_size / 2);
+        REQUIRE(cache.size() == entry_size);
+        params->bailout = 50;
+        geomandel::render(buff, params);
+        cache.store(*params, buff, samples);
+        REQUIRE(cache.size() == entry_size);
+
+        constants::fracbuff loaded = geomandel::create_buffer(*params);
+        constants::samplebuff loaded_samples;
+        REQUIRE(cache.load(*params, loaded, loaded_samples));
+        params->bailout = 100;
+        REQUIRE(!cache.load(*params, loaded, loaded_samples));
+    }
+
+    {
+        Rendercache clear(cache_dir, 0);
+    }
+    rmdir(cache_dir.c_str());
 }
+#endif
@@ -0,0 +1,253 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tilecache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+#include "formula.h"
+#include "fractalcrunchsingle.h"
+#include "newton.h"
+
+namespace
+{
+/**
+ * @brief Round the mantissa of a value to the given number of bits
+ *
+ * @details
+ * Pixel sizes and offsets of two views that were panned against each other
+ * differ in their last bits. Rounding makes sure they end up on the same grid.
+ */
+double quantize(double value, int bits)
+{
+    int exp = 0;
+    double mantissa = std::frexp(value, &exp);
+    double scale = std::ldexp(1.0, bits);
+    return std::ldexp(std::round(mantissa * scale) / scale, exp);
+}
+
+long long floor_div(long long a, long long b)
+{
+    long long q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0)))
+        q--;
+    return q;
+}
+}
+
+Tilecache::Tilecache(unsigned int tile_size, size_t max_tiles)
+    : tile_size(tile_size), max_tiles(max_tiles)
+{
+}
+
+Tilecache::~Tilecache() {}
+unsigned long Tilecache::render(
+    constants::fracbuff &buff, const std::shared_ptr<FractalParameters> &params,
+    ctpl::thread_pool &tpl)
+{
+    const long long ts = this->tile_size;
+    double xdelta = quantize(params->xdelta, 36);
+    double ydelta = quantize(params->ydelta, 36);
+
+    // position of the view on the global pixel grid of this pixel size
+    double xpos = params->xl / xdelta;
+    double ypos = params->yl / ydelta;
+    double xfloor = std::floor(xpos);
+    double yfloor = std::floor(ypos);
+    // sub pixel offset of the grid, rounded to 2^-20 pixels
+    double xphase = std::ldexp(std::round(std::ldexp(xpos - xfloor, 20)), -20);
+    double yphase = std::ldexp(std::round(std::ldexp(ypos - yfloor, 20)), -20);
+    if (xphase >= 1.0) {
+        xphase = 0;
+        xfloor += 1;
+    }
+    if (yphase >= 1.0) {
+        yphase = 0;
+        yfloor += 1;
+    }
+    long long gx0 = static_cast<long long>(xfloor);
+    long long gy0 = static_cast<long long>(yfloor);
+
+    uint64_t grid = utility::fnv_offset;
+    utility::fnv1a(grid, static_cast<uint32_t>(params->set_type));
+    utility::fnv1a(grid, static_cast<uint32_t>(params->bailout));
+    if (params->set_type == constants::FRACTAL::JULIA) {
+        utility::fnv1a(grid, params->julia_real);
+        utility::fnv1a(grid, params->julia_ima);
+    }
+    if (params->set_type == constants::FRACTAL::FORMULA)
+        utility::fnv1a(grid, params->formula->source());
+    if (params->set_type == constants::FRACTAL::NEWTON)
+        utility::fnv1a(grid, params->newton->source());
+    // tiles of the distance coloring carry the estimate, the others do not
+    uint8_t extra = 0;
+    if (params->col_algo == constants::COL_ALGO::CONTINUOUS_SINE)
+        extra = 1;
+    else if (params->col_algo == constants::COL_ALGO::DISTANCE)
+        extra = 2;
+    utility::fnv1a(grid, extra);
+    utility::fnv1a(grid, xdelta);
+    utility::fnv1a(grid, ydelta);
+    utility::fnv1a(grid, xphase);
+    utility::fnv1a(grid, yphase);
+
+    long long txmin = floor_div(gx0, ts);
+    long long txmax = floor_div(gx0 + params->xrange - 1, ts);
+    long long tymin = floor_div(gy0, ts);
+    long long tymax = floor_div(gy0 + params->yrange - 1, ts);
+    size_t ntx = static_cast<size_t>(txmax - txmin + 1);
+
+    // tiles of this view, cached ones are taken right away
+    std::vector<std::shared_ptr<tile>> tiles(
+        ntx * static_cast<size_t>(tymax - tymin + 1));
+    // slots of the missing tiles and their predicted cost
+    std::vector<std::pair<size_t, double>> missing;
+    for (long long ty = tymin; ty <= tymax; ty++) {
+        for (long long tx = txmin; tx <= txmax; tx++) {
+            size_t slot = static_cast<size_t>(ty - tymin) * ntx +
+                          static_cast<size_t>(tx - txmin);
+            auto it = this->index.find({grid, tx, ty});
+            if (it != this->index.end()) {
+                this->lru.splice(this->lru.begin(), this->lru, it->second);
+                tiles[slot] = it->second->second;
+                continue;
+            }
+            missing.emplace_back(slot, 0.0);
+        }
+    }
+    // the most expensive tiles are queued first, so no thread is left with
+    // a long tile when all others are done
+    if (this->costmap.matches(*params)) {
+        for (auto &m : missing) {
+            long long tx = txmin + static_cast<long long>(m.first % ntx);
+            long long ty = tymin + static_cast<long long>(m.first / ntx);
+            m.second = this->predict_tile(xdelta, ydelta, xphase, yphase, tx,
+                                          ty);
+        }
+        std::stable_sort(missing.begin(), missing.end(),
+                         [](const std::pair<size_t, double> &a,
+                            const std::pair<size_t, double> &b) {
+                             return a.second > b.second;
+                         });
+    }
+
+    std::vector<std::pair<size_t, std::future<std::shared_ptr<tile>>>> jobs;
+    auto view_params = std::make_shared<FractalParameters>(*params);
+    view_params->xdelta = xdelta;
+    view_params->ydelta = ydelta;
+    this->queued.clear();
+    for (const auto &m : missing) {
+        size_t slot = m.first;
+        long long tx = txmin + static_cast<long long>(slot % ntx);
+        long long ty = tymin + static_cast<long long>(slot / ntx);
+        this->queued.emplace_back(tx, ty);
+        jobs.emplace_back(
+            slot,
+            tpl.push([this, view_params, xphase, yphase, tx, ty](int id) {
+                (void)id;
+                return this->compute_tile(*view_params, xphase, yphase, tx,
+                                          ty);
+            }));
+    }
+    for (auto &job : jobs) {
+        size_t slot = job.first;
+        tiles[slot] = job.second.get();
+        long long tx = txmin + static_cast<long long>(slot % ntx);
+        long long ty = tymin + static_cast<long long>(slot / ntx);
+        this->insert({grid, tx, ty}, tiles[slot]);
+    }
+
+    // compose the view
+    for (unsigned int iy = 0; iy < params->yrange; iy++) {
+        long long py = gy0 + iy;
+        long long ty = floor_div(py, ts);
+        size_t oy = static_cast<size_t>(py - ty * ts);
+        unsigned int ix = 0;
+        while (ix < params->xrange) {
+            long long px = gx0 + ix;
+            long long tx = floor_div(px, ts);
+            size_t ox = static_cast<size_t>(px - tx * ts);
+            const auto &row = (*tiles[static_cast<size_t>(ty - tymin) * ntx +
+                                      static_cast<size_t>(tx - txmin)])[oy];
+            size_t n = std::min(static_cast<size_t>(ts) - ox,
+                                static_cast<size_t>(params->xrange - ix));
+            std::copy(row.begin() + ox, row.begin() + ox + n,
+                      buff[iy].begin() + ix);
+            ix += static_cast<unsigned int>(n);
+        }
+    }
+    return jobs.size();
+}
+
+size_t Tilecache::size() const { return this->lru.size(); }
+void Tilecache::set_costmap(const Costmap &map) { this->costmap = map; }
+const std::vector<std::pair<long long, long long>> &Tilecache::last_jobs()
+    const
+{
+    return this->queued;
+}
+
+double Tilecache::predict_tile(double xdelta, double ydelta, double xphase,
+                               double yphase, long long tx, long long ty) const
+{
+    // a few points per tile are enough, the cells of the map are coarse
+    const unsigned int points = 4;
+    const double ts = this->tile_size;
+    double cost = 0;
+    for (unsigned int py = 0; py < points; py++) {
+        double im = (ty * ts + yphase + (py + 0.5) * ts / points) * ydelta;
+        for (unsigned int px = 0; px < points; px++) {
+            double re = (tx * ts + xphase + (px + 0.5) * ts / points) * xdelta;
+            cost += this->costmap.density(re, im);
+        }
+    }
+    return cost;
+}
+std::shared_ptr<Tilecache::tile> Tilecache::compute_tile(
+    const FractalParameters &params, double xphase, double yphase,
+    long long tx, long long ty) const
+{
+    const long long ts = this->tile_size;
+    double xl = (tx * ts + xphase) * params.xdelta;
+    double yl = (ty * ts + yphase) * params.ydelta;
+    auto tparams = std::make_shared<FractalParameters>(params);
+    tparams->set_complex_plane(this->tile_size, xl, xl + ts * params.xdelta,
+                               this->tile_size, yl, yl + ts * params.ydelta);
+    // the exact grid pixel size, the plane bounds might round differently
+    tparams->xdelta = params.xdelta;
+    tparams->ydelta = params.ydelta;
+
+    auto t = std::make_shared<tile>(
+        this->tile_size,
+        constants::fracrow(this->tile_size));
+    Fractalcrunchsingle crunchi(*t, tparams);
+    crunchi.fill_buffer();
+    return t;
+}
+
+void Tilecache::insert(const Tilekey &key, std::shared_ptr<tile> t)
+{
+    this->lru.emplace_front(key, std::move(t));
+    this->index[key] = this->lru.begin();
+    while (this->lru.size() > this->max_tiles) {
+        this->index.erase(this->lru.back().first);
+        this->lru.pop_back();
+    }
+}
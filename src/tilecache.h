@@ -0,0 +1,141 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "global.h"
+#include "costmap.h"
+#include "fractalparams.h"
+
+#include "ctpl_stl.h"
+
+/**
+ * @brief In-memory LRU cache of iteration tiles for interactive pan and zoom
+ *
+ * @details
+ * Every pixel size (zoom level) defines a fixed grid of square tiles on the
+ * complex plane. Views with the same pixel size and the same sub pixel offset
+ * share this grid, which is always the case when a view is panned by whole
+ * pixels. Rendering a view copies all cached tiles into the buffer and only
+ * computes the tiles that are not in the cache yet.
+ *
+ * Supersampling data is not cached, run the supersampling pass on the
+ * composed buffer if needed.
+ */
+class Tilecache
+{
+public:
+    /**
+     * @brief Create an empty tile cache
+     *
+     * @param tile_size Width and height of a tile in pixels
+     * @param max_tiles Maximum number of tiles kept in memory
+     */
+    Tilecache(unsigned int tile_size, size_t max_tiles);
+    virtual ~Tilecache();
+
+    /**
+     * @brief Fill a buffer from the cache, computing missing tiles
+     *
+     * @param buff Buffer with the size described by params
+     * @param params View that will be rendered
+     * @param tpl Thread pool used to compute missing tiles
+     *
+     * @return Number of tiles that had to be computed
+     */
+    unsigned long render(constants::fracbuff &buff,
+                         const std::shared_ptr<FractalParameters> &params,
+                         ctpl::thread_pool &tpl);
+
+    /**
+     * @brief Number of tiles in the cache
+     */
+    size_t size() const;
+
+    /**
+     * @brief Use the cost of a previous view to order the tile jobs
+     *
+     * @param map Cost map of the previous view
+     *
+     * @details
+     * Missing tiles are queued with the most expensive prediction first. The
+     * map is ignored for views of another fractal or bailout.
+     */
+    void set_costmap(const Costmap &map);
+
+    /**
+     * @brief Tiles computed by the last render in the order they were queued
+     */
+    const std::vector<std::pair<long long, long long>> &last_jobs() const;
+
+private:
+    struct Tilekey {
+        uint64_t grid;
+        long long tx;
+        long long ty;
+
+        bool operator==(const Tilekey &other) const
+        {
+            return grid == other.grid && tx == other.tx && ty == other.ty;
+        }
+    };
+    struct Tilekeyhash {
+        size_t operator()(const Tilekey &k) const
+        {
+            uint64_t hash = k.grid;
+            utility::fnv1a(hash, k.tx);
+            utility::fnv1a(hash, k.ty);
+            return static_cast<size_t>(hash);
+        }
+    };
+    typedef constants::fracbuff tile;
+    typedef std::list<std::pair<Tilekey, std::shared_ptr<tile>>> lrulist;
+
+    unsigned int tile_size;
+    size_t max_tiles;
+
+    // most recently used tiles are at the front
+    lrulist lru;
+    std::unordered_map<Tilekey, lrulist::iterator, Tilekeyhash> index;
+    Costmap costmap;
+    std::vector<std::pair<long long, long long>> queued;
+
+    /**
+     * @brief Predicted cost of a tile of the grid
+     */
+    double predict_tile(double xdelta, double ydelta, double xphase,
+                        double yphase, long long tx, long long ty) const;
+
+    /**
+     * @brief Compute one tile of the grid
+     */
+    std::shared_ptr<tile> compute_tile(const FractalParameters &params,
+                                       double xphase, double yphase,
+                                       long long tx, long long ty) const;
+    void insert(const Tilekey &key, std::shared_ptr<tile> t);
+};
+
+#endif /* ifndef TILECACHE_H */
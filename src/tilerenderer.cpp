@@ -0,0 +1,154 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tilerenderer.h"
+
+#include <algorithm>
+#include <deque>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "ctpl_stl.h"
+
+#include "fractalcrunchsingle.h"
+#include "imagewriter.h"
+
+namespace
+{
+void make_directory(const std::string &path)
+{
+    // existing directories are fine, errors show up when the tiles are written
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+}
+
+Tilerenderer::Tilerenderer(const std::shared_ptr<FractalParameters> &params,
+                           const std::shared_ptr<Printer> &prnt,
+                           writerfactory factory)
+    : params(params), prnt(prnt), factory(std::move(factory))
+{
+}
+
+Tilerenderer::~Tilerenderer() {}
+#ifdef HAVE_RENDERCACHE
+void Tilerenderer::set_cache(Rendercache *cache) { this->cache = cache; }
+#endif
+
+unsigned long Tilerenderer::render(unsigned int zmin, unsigned int zmax,
+                                   unsigned int tile_size,
+                                   const std::string &outdir)
+{
+    unsigned int threads =
+        this->params->cores > 0
+            ? this->params->cores
+            : std::max(std::thread::hardware_concurrency(), 1u);
+    ctpl::thread_pool tpl(static_cast<int>(threads));
+
+    // one buffer per worker, reused for every tile this worker renders
+    std::vector<constants::fracbuff> worker_buffs(threads);
+    for (auto &b : worker_buffs) {
+        b.assign(tile_size, constants::fracrow(tile_size));
+    }
+
+    // only a limited number of jobs is queued at once so a pyramid with
+    // millions of tiles does not need millions of futures
+    std::deque<std::future<void>> futures;
+    const size_t max_queued = threads * 4;
+    unsigned long tiles = 0;
+
+    make_directory(outdir);
+    for (unsigned int z = zmin; z <= zmax; z++) {
+        unsigned int ntiles = 1u << z;
+        this->prnt << "+ Level " << z << ": " << ntiles << "x" << ntiles
+                   << " tiles" << std::endl;
+        make_directory(outdir + "/" + std::to_string(z));
+        for (unsigned int x = 0; x < ntiles; x++) {
+            std::string coldir =
+                outdir + "/" + std::to_string(z) + "/" + std::to_string(x);
+            make_directory(coldir);
+            for (unsigned int y = 0; y < ntiles; y++) {
+                if (futures.size() >= max_queued) {
+                    futures.front().get();
+                    futures.pop_front();
+                }
+                futures.push_back(tpl.push([this, &tpl, &worker_buffs, z, x, y,
+                                            tile_size, coldir](int id) {
+                    constants::fracbuff &buff = worker_buffs[id];
+                    std::shared_ptr<FractalParameters> tparams =
+                        tile_parameters(*this->params, z, x, y, tile_size);
+                    tparams->image_base = coldir + "/" + std::to_string(y);
+
+                    constants::samplebuff samples;
+#ifdef HAVE_RENDERCACHE
+                    if (this->cache == nullptr ||
+                        !this->cache->load(*tparams, buff, samples)) {
+#endif
+                        Fractalcrunchsingle crunchi(buff, tparams);
+                        crunchi.fill_buffer();
+                        if (tparams->aa_samples > 0)
+                            crunchi.supersample_buffer(samples);
+#ifdef HAVE_RENDERCACHE
+                        if (this->cache != nullptr)
+                            this->cache->store(*tparams, buff, samples);
+                    }
+#endif
+
+                    for (auto &writer : this->factory(buff, tparams)) {
+                        writer->set_samples(samples);
+                        // colorize on this worker instead of a pool per tile
+                        Imagewriter *img =
+                            dynamic_cast<Imagewriter *>(writer.get());
+                        if (img != nullptr)
+                            img->set_pool(&tpl);
+                        writer->write_buffer();
+                    }
+                }));
+                tiles++;
+            }
+        }
+    }
+    for (auto &f : futures) {
+        f.get();
+    }
+    return tiles;
+}
+
+std::shared_ptr<FractalParameters> Tilerenderer::tile_parameters(
+    const FractalParameters &world, unsigned int z, unsigned int x,
+    unsigned int y, unsigned int tile_size)
+{
+    double ntiles = static_cast<double>(1u << z);
+    double twidth = (world.xh - world.xl) / ntiles;
+    double theight = (world.yh - world.yl) / ntiles;
+    double xl = world.xl + x * twidth;
+    double yl = world.yl + y * theight;
+
+    auto tparams = std::make_shared<FractalParameters>(world);
+    tparams->set_complex_plane(tile_size, xl, xl + twidth, tile_size, yl,
+                               yl + theight);
+    return tparams;
+}
@@ -0,0 +1,110 @@
+/*
+This file is part of geomandel. An artful fractal generator
+Copyright © 2015, 2016 Christian Rapp
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "global.h"
+#include "fractalparams.h"
+#include "buffwriter.h"
+#include "printer.h"
+#ifdef HAVE_RENDERCACHE
+#include "rendercache.h"
+#endif
+
+/**
+ * @brief Renders a slippy map tile pyramid (z/x/y)
+ *
+ * @details
+ * The complex plane of the fractal parameters is the world. On zoom level z
+ * the world is divided into 2^z x 2^z tiles of the same pixel size. Tile
+ * (0, 0) is the top left tile of the image geomandel would render for these
+ * parameters. Every tile is written to <outdir>/z/x/y.<ext> with the writers
+ * created by the writer factory.
+ *
+ * All tiles of all levels are scheduled on one thread pool. Every worker
+ * renders with its own buffer that is reused for all of its tiles.
+ */
+class Tilerenderer
+{
+public:
+    /**
+     * @brief Creates the writers for one tile
+     */
+    typedef std::function<std::vector<std::unique_ptr<Buffwriter>>(
+        const constants::fracbuff &buff,
+        const std::shared_ptr<FractalParameters> &params)>
+        writerfactory;
+
+    Tilerenderer(const std::shared_ptr<FractalParameters> &params,
+                 const std::shared_ptr<Printer> &prnt, writerfactory factory);
+    virtual ~Tilerenderer();
+
+#ifdef HAVE_RENDERCACHE
+    /**
+     * @brief Look up tiles in a render cache before computing them
+     *
+     * @param cache Render cache or nullptr to disable caching
+     */
+    void set_cache(Rendercache *cache);
+#endif
+
+    /**
+     * @brief Render all tiles of the levels zmin to zmax
+     *
+     * @param zmin First zoom level
+     * @param zmax Last zoom level
+     * @param tile_size Width and height of a tile in pixels
+     * @param outdir Output directory
+     *
+     * @return Number of tiles that were rendered
+     */
+    unsigned long render(unsigned int zmin, unsigned int zmax,
+                         unsigned int tile_size, const std::string &outdir);
+
+    /**
+     * @brief Fractal parameters of one tile
+     *
+     * @param world Parameters describing the whole pyramid
+     * @param z Zoom level
+     * @param x Tile column
+     * @param y Tile row
+     * @param tile_size Width and height of a tile in pixels
+     *
+     * @return Parameters with the complex plane of the tile
+     */
+    static std::shared_ptr<FractalParameters> tile_parameters(
+        const FractalParameters &world, unsigned int z, unsigned int x,
+        unsigned int y, unsigned int tile_size);
+
+private:
+    const std::shared_ptr<FractalParameters> &params;
+    const std::shared_ptr<Printer> &prnt;
+    writerfactory factory;
+#ifdef HAVE_RENDERCACHE
+    Rendercache *cache = nullptr;
+#endif
+};
+
+#endif /* ifndef TILERENDERER_H */